@@ -0,0 +1,301 @@
+/*
+ * AsyncFileReader.cpp
+ *
+ *	This is the cpp file for the AsyncFileReader object. An
+ *  AsyncFileReader reads a file from start to end in fixed size blocks,
+ *  keeping several block reads in flight with io_uring, or falls back to
+ *  plain pread calls when io_uring is not available.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "AsyncFileReader.h"
+#include <errno.h>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(CNV_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define CNV_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Constuctors
+// ==============================================
+AsyncFileReader::AsyncFileReader(int descriptor, size_t size, int depth) {
+	fileDescriptor = descriptor;
+	blockSize = size;
+	queueDepth = depth;
+	nextBlock = 0;
+	nextBlockUsed = 0;
+	readOffset = 0;
+	submitOffset = 0;
+	ringFileDescriptor = -1;
+
+	if (fileDescriptor < 0 || queueDepth < 1 || !setupRing())
+		return;
+
+	// Start reading the first blocks of the file
+	blocks.resize(queueDepth);
+	blockOffsets.resize(queueDepth, 0);
+	blockResults.resize(queueDepth, 0);
+	blockPending.resize(queueDepth, false);
+	try {
+		for (int i = 0; i < queueDepth; i++) {
+			blocks[i].resize(blockSize);
+			submitBlock(i);
+		}
+	}
+	catch (...) {
+		closeRing();
+		throw;
+	}
+}
+
+// Destructor
+// =============================================
+AsyncFileReader::~AsyncFileReader() {
+#ifdef CNV_HAVE_IO_URING
+	if (ringFileDescriptor < 0)
+		return;
+
+	// The kernel may still be writing into the blocks.  After a failed
+	// read closing the ring cancels what is left.
+	try {
+		for (int i = 0; i < queueDepth; i++)
+			waitForBlock(i);
+	}
+	catch (...) {
+	}
+	closeRing();
+#endif
+}
+
+// Public Methods
+// =============================================
+
+// size_t read(char* buffer, size_t size)
+//  Purpose:
+//		Reads the next size bytes of the file into buffer.  Returns the
+//		number of bytes read, less than size only at the end of the file.
+size_t AsyncFileReader::read(char* buffer, size_t size) {
+	if (ringFileDescriptor < 0) {
+		size_t bytesRead = preadFully(buffer, size, readOffset);
+		readOffset += bytesRead;
+		return bytesRead;
+	}
+
+	size_t total = 0;
+	while (total < size) {
+		waitForBlock(nextBlock);
+
+		// Copy what the caller still needs from the current block
+		size_t blockBytes = blockResults[nextBlock];
+		size_t bytes = blockBytes - nextBlockUsed;
+		if (bytes > size - total)
+			bytes = size - total;
+		memcpy(buffer + total, &blocks[nextBlock][nextBlockUsed], bytes);
+		total += bytes;
+		nextBlockUsed += bytes;
+
+		if (nextBlockUsed < blockBytes)
+			continue;
+
+		// A short block is the end of the file
+		if (blockBytes < blockSize)
+			break;
+
+		// Reuse the block for the next unread part of the file
+		submitBlock(nextBlock);
+		nextBlock = (nextBlock + 1) % queueDepth;
+		nextBlockUsed = 0;
+	}
+
+	readOffset += total;
+	return total;
+}
+
+// bool usingIoUring()
+//  Purpose:
+//		Returns true if reads are going through io_uring
+bool AsyncFileReader::usingIoUring() {
+	return ringFileDescriptor >= 0;
+}
+
+// Private Methods
+// =============================================
+
+// bool setupRing()
+//  Purpose:
+//		Creates and maps the io_uring.  Returns false if io_uring is
+//		not available.
+bool AsyncFileReader::setupRing() {
+#ifdef CNV_HAVE_IO_URING
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int ring = syscall(__NR_io_uring_setup, queueDepth, &params);
+	if (ring < 0)
+		return false;
+
+	// Map the submission and completion rings, which share one mapping on
+	// newer kernels
+	submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap && completionRingSize > submissionRingSize)
+		submissionRingSize = completionRingSize;
+
+	submissionRing = mmap(NULL, submissionRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if (submissionRing == MAP_FAILED) {
+		close(ring);
+		return false;
+	}
+
+	completionRing = submissionRing;
+	if (!singleMap) {
+		completionRing = mmap(NULL, completionRingSize, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+		if (completionRing == MAP_FAILED) {
+			munmap(submissionRing, submissionRingSize);
+			close(ring);
+			return false;
+		}
+	}
+
+	submissionEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	submissionEntries = mmap(NULL, submissionEntriesSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	if (submissionEntries == MAP_FAILED) {
+		if (!singleMap)
+			munmap(completionRing, completionRingSize);
+		munmap(submissionRing, submissionRingSize);
+		close(ring);
+		return false;
+	}
+
+	char* sq = (char*) submissionRing;
+	submissionHead = (unsigned*) (sq + params.sq_off.head);
+	submissionTail = (unsigned*) (sq + params.sq_off.tail);
+	submissionMask = (unsigned*) (sq + params.sq_off.ring_mask);
+	submissionArray = (unsigned*) (sq + params.sq_off.array);
+
+	char* cq = (char*) completionRing;
+	completionHead = (unsigned*) (cq + params.cq_off.head);
+	completionTail = (unsigned*) (cq + params.cq_off.tail);
+	completionMask = (unsigned*) (cq + params.cq_off.ring_mask);
+	completionEntries = cq + params.cq_off.cqes;
+
+	ringFileDescriptor = ring;
+	return true;
+#else
+	return false;
+#endif
+}
+
+// submitBlock(int block)
+//  Purpose:
+//		Queues a read of block at submitOffset and advances submitOffset.
+//		Throws runtime_error if the read could not be queued.
+void AsyncFileReader::submitBlock(int block) {
+#ifdef CNV_HAVE_IO_URING
+	unsigned tail = *submissionTail;
+	unsigned index = tail & *submissionMask;
+	struct io_uring_sqe* entry = (struct io_uring_sqe*) submissionEntries + index;
+	memset(entry, 0, sizeof(*entry));
+	entry->opcode = IORING_OP_READ;
+	entry->fd = fileDescriptor;
+	entry->addr = (unsigned long) blocks[block].data();
+	entry->len = blockSize;
+	entry->off = submitOffset;
+	entry->user_data = block;
+	submissionArray[index] = index;
+	__atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+
+	blockOffsets[block] = submitOffset;
+	blockPending[block] = true;
+	submitOffset += blockSize;
+
+	int submitted;
+	while ((submitted = syscall(__NR_io_uring_enter, ringFileDescriptor, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR)
+		;
+	if (submitted < 0) {
+		blockPending[block] = false;
+		throw runtime_error(string("could not queue a read: ") + strerror(errno));
+	}
+#endif
+}
+
+// waitForBlock(int block)
+//  Purpose:
+//		Waits until the read for block has completed, topping up a
+//		short read with pread.  Throws runtime_error if the read failed.
+void AsyncFileReader::waitForBlock(int block) {
+#ifdef CNV_HAVE_IO_URING
+	while (blockPending[block]) {
+		unsigned head = *completionHead;
+		if (head == __atomic_load_n(completionTail, __ATOMIC_ACQUIRE)) {
+			if (syscall(__NR_io_uring_enter, ringFileDescriptor, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+				&& errno != EINTR)
+				throw runtime_error(string("could not wait for a read: ") + strerror(errno));
+			continue;
+		}
+
+		struct io_uring_cqe* entry =
+			(struct io_uring_cqe*) completionEntries + (head & *completionMask);
+		int completed = (int) entry->user_data;
+		long long result = entry->res;
+		__atomic_store_n(completionHead, head + 1, __ATOMIC_RELEASE);
+
+		// Redo reads on kernels without IORING_OP_READ with pread, any
+		// other failure fails the read
+		blockPending[completed] = false;
+		if (result == -EINVAL)
+			result = 0;
+		else if (result < 0)
+			throw runtime_error(string("read failed: ") + strerror((int) -result));
+
+		// Finish short reads with pread so every block but the last is full
+		if ((size_t) result < blockSize)
+			result += preadFully(&blocks[completed][result], blockSize - result,
+				blockOffsets[completed] + result);
+		blockResults[completed] = result;
+	}
+#endif
+}
+
+// closeRing()
+//  Purpose:
+//		Unmaps and closes the io_uring
+void AsyncFileReader::closeRing() {
+#ifdef CNV_HAVE_IO_URING
+	munmap(submissionEntries, submissionEntriesSize);
+	if (completionRing != submissionRing)
+		munmap(completionRing, completionRingSize);
+	munmap(submissionRing, submissionRingSize);
+	close(ringFileDescriptor);
+	ringFileDescriptor = -1;
+#endif
+}
+
+// size_t preadFully(char* buffer, size_t size, long long offset)
+//  Purpose:
+//		Reads up to size bytes at offset with pread, retrying partial
+//		and interrupted reads.  Throws runtime_error if a read fails.
+size_t AsyncFileReader::preadFully(char* buffer, size_t size, long long offset) {
+	size_t total = 0;
+	while (total < size) {
+		ssize_t bytesRead = pread(fileDescriptor, buffer + total, size - total, offset + total);
+		if (bytesRead < 0 && errno == EINTR)
+			continue;
+		if (bytesRead < 0)
+			throw runtime_error(string("read failed: ") + strerror(errno));
+		if (bytesRead == 0)
+			break;
+		total += bytesRead;
+	}
+	return total;
+}
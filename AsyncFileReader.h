@@ -0,0 +1,111 @@
+/*
+ * AsyncFileReader.h
+ *
+ *	This is the header file for the AsyncFileReader object. An
+ *  AsyncFileReader reads a file from start to end in fixed size blocks,
+ *  keeping several block reads in flight with io_uring so the device
+ *  stays busy while earlier blocks are parsed.  When io_uring is not
+ *  available (old kernel, blocked by seccomp, or built with
+ *  -DCNV_NO_IO_URING) it falls back to plain pread calls.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef ASYNCFILEREADER_H
+#define ASYNCFILEREADER_H
+#include <vector>
+#include <stddef.h>
+using namespace std;
+
+class AsyncFileReader
+{
+public:
+	// Constuctors
+	// ==============================================
+	// A depth of 0 reads with pread only
+	AsyncFileReader(int descriptor, size_t size, int depth);
+
+	// Destructor
+	// =============================================
+	~AsyncFileReader();
+
+	// Public Methods
+	// =============================================
+
+	// size_t read(char* buffer, size_t size)
+	//  Purpose:
+	//		Reads the next size bytes of the file into buffer.  Returns the
+	//		number of bytes read, less than size only at the end of the file.
+	//		Throws runtime_error if a read fails.
+	size_t read(char* buffer, size_t size);
+
+	// bool usingIoUring()
+	//  Purpose:
+	//		Returns true if reads are going through io_uring
+	bool usingIoUring();
+
+private:
+	int fileDescriptor;
+	size_t blockSize;
+	int queueDepth;
+
+	// Blocks read ahead of the caller.  The block at nextBlock holds the
+	// bytes starting at readOffset once it completes.
+	vector<vector<char> > blocks;
+	vector<long long> blockOffsets;
+	vector<long long> blockResults;
+	vector<bool> blockPending;
+	int nextBlock;
+	size_t nextBlockUsed;
+	long long readOffset;
+	long long submitOffset;
+
+	// io_uring state, ringFileDescriptor is -1 when using pread
+	int ringFileDescriptor;
+	void* submissionRing;
+	size_t submissionRingSize;
+	void* completionRing;
+	size_t completionRingSize;
+	void* submissionEntries;
+	size_t submissionEntriesSize;
+	unsigned* submissionHead;
+	unsigned* submissionTail;
+	unsigned* submissionMask;
+	unsigned* submissionArray;
+	unsigned* completionHead;
+	unsigned* completionTail;
+	unsigned* completionMask;
+	void* completionEntries;
+
+	// bool setupRing()
+	//  Purpose:
+	//		Creates and maps the io_uring.  Returns false if io_uring is
+	//		not available.
+	bool setupRing();
+
+	// submitBlock(int block)
+	//  Purpose:
+	//		Queues a read of block at submitOffset and advances submitOffset.
+	//		Throws runtime_error if the read could not be queued.
+	void submitBlock(int block);
+
+	// waitForBlock(int block)
+	//  Purpose:
+	//		Waits until the read for block has completed, topping up a
+	//		short read with pread.  Throws runtime_error if the read failed.
+	void waitForBlock(int block);
+
+	// closeRing()
+	//  Purpose:
+	//		Unmaps and closes the io_uring
+	void closeRing();
+
+	// size_t preadFully(char* buffer, size_t size, long long offset)
+	//  Purpose:
+	//		Reads up to size bytes at offset with pread, retrying partial
+	//		and interrupted reads.  Throws runtime_error if a read fails.
+	size_t preadFully(char* buffer, size_t size, long long offset);
+};
+
+#endif //ASYNCFILEREADER_H
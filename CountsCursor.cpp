@@ -0,0 +1,65 @@
+/*
+ * CountsCursor.cpp
+ *
+ *	This is the cpp file for the CountsCursor object. A CountsCursor
+ *  walks the records of a CountsReader one at a time.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "CountsCursor.h"
+
+// Constuctors
+// ==============================================
+CountsCursor::CountsCursor(CountsReader* countsReader) {
+	reader = countsReader;
+	batch = NULL;
+	nextBatch();
+}
+
+// Destructor
+// =============================================
+CountsCursor::~CountsCursor() {
+	if (batch != NULL)
+		reader->releaseBatch(batch);
+}
+
+// Public Methods
+// =============================================
+
+// bool advance()
+//  Purpose:
+//		Moves to the next record.  Returns true if the record may be on
+//		a different chromosome than the last.
+bool CountsCursor::advance() {
+	record++;
+	if (record == batch->positions.size()) {
+		nextBatch();
+		return true;
+	}
+
+	// Move to the next chromosome run when the record starts it
+	if (run + 1 < batch->chromosomes.size() && (size_t) batch->chromosomes[run + 1].firstRecord == record) {
+		run++;
+		return true;
+	}
+	return false;
+}
+
+// Private Methods
+// =============================================
+
+// nextBatch()
+//  Purpose:
+//		Releases the current batch and moves to the first record of the
+//		next batch that has records
+void CountsCursor::nextBatch() {
+	do {
+		if (batch != NULL)
+			reader->releaseBatch(batch);
+		batch = reader->nextBatch();
+	} while (batch != NULL && batch->positions.empty());
+
+	record = 0;
+	run = 0;
+}
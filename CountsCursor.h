@@ -0,0 +1,86 @@
+/*
+ * CountsCursor.h
+ *
+ *	This is the header file for the CountsCursor object. A CountsCursor
+ *  walks the records of a CountsReader one at a time, for merging
+ *  counts files position by position.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef COUNTSCURSOR_H
+#define COUNTSCURSOR_H
+#include "CountsReader.h"
+#include <string>
+using namespace std;
+
+class CountsCursor
+{
+public:
+	// Constuctors
+	// ==============================================
+	CountsCursor(CountsReader* countsReader);
+
+	// Destructor
+	// =============================================
+	~CountsCursor();
+
+	// Public Methods
+	// =============================================
+
+	// bool valid()
+	//  Purpose:
+	//		Returns false once the cursor is past the last record
+	bool valid() {
+		return batch != NULL;
+	}
+
+	// const string& chromosome()
+	//  Purpose:
+	//		Returns the chromosome of the current record
+	const string& chromosome() {
+		return batch->chromosomes[run].name;
+	}
+
+	// long long position()
+	//  Purpose:
+	//		Returns the position of the current record
+	long long position() {
+		return batch->positions[record];
+	}
+
+	// int readStarts()
+	//  Purpose:
+	//		Returns the read starts (capped at 3) of the current record
+	int readStarts() {
+		return batch->readStarts[record];
+	}
+
+	// int rawReadStarts()
+	//  Purpose:
+	//		Returns the read starts of the current record
+	int rawReadStarts() {
+		return batch->rawReadStarts[record];
+	}
+
+	// bool advance()
+	//  Purpose:
+	//		Moves to the next record.  Returns true if the record may be on
+	//		a different chromosome than the last.
+	bool advance();
+
+private:
+	CountsReader* reader;
+	CountsBatch* batch;
+	size_t record;
+	size_t run;
+
+	// nextBatch()
+	//  Purpose:
+	//		Releases the current batch and moves to the first record of the
+	//		next batch that has records
+	void nextBatch();
+};
+
+#endif //COUNTSCURSOR_H
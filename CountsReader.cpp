@@ -0,0 +1,395 @@
+/*
+ * CountsReader.cpp
+ *
+ *	This is the cpp file for the CountsReader object. A CountsReader
+ *  reads a read start counts file through a pipeline of a reader thread,
+ *  parser threads and the caller connected by lock-free ring buffers.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "CountsReader.h"
+#include "ScanProgress.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// parse()
+//  Purpose:
+//		Parses the lines in text into positions, readStarts (capped at 3),
+//		rawReadStarts (capped at 65535) and chromosomes.  Lines with fewer
+//		than three fields are skipped.
+void CountsBatch::parse() {
+	positions.clear();
+	readStarts.clear();
+	rawReadStarts.clear();
+	chromosomes.clear();
+
+	const char* current = text.data();
+	const char* textEnd = current + text.size();
+	while (current < textEnd) {
+		const char* lineEnd = (const char*) memchr(current, '\n', textEnd - current);
+		if (lineEnd == NULL)
+			lineEnd = textEnd;
+
+		// Find the tabs ending the chromosome and position fields
+		const char* chromosomeEnd = (const char*) memchr(current, '\t', lineEnd - current);
+		const char* positionEnd = NULL;
+		if (chromosomeEnd != NULL)
+			positionEnd = (const char*) memchr(chromosomeEnd + 1, '\t', lineEnd - chromosomeEnd - 1);
+
+		if (positionEnd != NULL) {
+			// Start a new chromosome run if the chromosome changed
+			size_t nameLength = chromosomeEnd - current;
+			if (chromosomes.empty()
+				|| chromosomes.back().name.compare(0, string::npos, current, nameLength) != 0) {
+				ChromosomeRun run;
+				run.name.assign(current, nameLength);
+				run.firstRecord = positions.size();
+				chromosomes.push_back(run);
+			}
+
+			// Get the position
+			long long position = 0;
+			for (const char* c = chromosomeEnd + 1; c < positionEnd && *c >= '0' && *c <= '9'; c++)
+				position = position * 10 + (*c - '0');
+
+			// Get the read starts
+			int count = 0;
+			for (const char* c = positionEnd + 1; c < lineEnd && *c >= '0' && *c <= '9' && count < 65535; c++)
+				count = count * 10 + (*c - '0');
+			if (count > 65535)
+				count = 65535;
+
+			// Set read starts to 3 if greater than 3 for the code
+			positions.push_back(position);
+			rawReadStarts.push_back((unsigned short) count);
+			readStarts.push_back((unsigned char) (count > 3 ? 3 : count));
+		}
+
+		current = lineEnd + 1;
+	}
+}
+
+// Constuctors
+// ==============================================
+CountsReader::CountsReader(string fileName, int numParserThreads, bool asyncReads) {
+	countsFileName = fileName;
+	fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+		throw runtime_error("could not open counts file " + fileName + ": " + strerror(errno));
+	fileReader = new AsyncFileReader(fileDescriptor, ASYNC_BLOCK_SIZE,
+		asyncReads ? ASYNC_QUEUE_DEPTH : 0);
+	countsText = NULL;
+	countsTextOffset = 0;
+	progress = NULL;
+	startPipeline(numParserThreads);
+}
+
+CountsReader::CountsReader(const string& text, int numParserThreads) {
+	fileDescriptor = -1;
+	fileReader = NULL;
+	countsText = &text;
+	countsTextOffset = 0;
+	progress = NULL;
+	startPipeline(numParserThreads);
+}
+
+// Destructor
+// =============================================
+CountsReader::~CountsReader() {
+	stopping.store(true);
+	wakeWaiters();
+	readerThread.join();
+	for (size_t i = 0; i < parserThreads.size(); i++)
+		parserThreads[i].join();
+
+	if (fileReader != NULL)
+		delete fileReader;
+	if (fileDescriptor >= 0)
+		close(fileDescriptor);
+	for (size_t i = 0; i < batches.size(); i++)
+		delete batches[i];
+	delete freeBatches;
+	for (int i = 0; i < numParsers; i++) {
+		delete unparsedBatches[i];
+		delete parsedBatches[i];
+	}
+}
+
+// Public Methods
+// =============================================
+
+// CountsBatch* nextBatch()
+//  Purpose:
+//		Returns the next parsed batch in file order, or NULL at the end
+//		of the file.  Each batch must be handed back with releaseBatch.
+CountsBatch* CountsReader::nextBatch() {
+	if (nextParser < 0)
+		return NULL;
+
+	// A stopped scan ends here as if the file did
+	if (progress != NULL && progress->stopRequested()) {
+		nextParser = -1;
+		return NULL;
+	}
+
+	// Batches were handed out round robin so take them back the same way
+	CountsBatch* batch;
+	waitPop(*parsedBatches[nextParser % numParsers], batch);
+	if (batch == NULL) {
+		nextParser = -1;
+		if (!readError.empty())
+			throw runtime_error(readError);
+		return NULL;
+	}
+
+	if (progress != NULL)
+		progress->addBatch(batch->positions.size(), batch->text.size(), batch->chromosomes,
+			batch->positions.empty() ? 0 : batch->positions.back());
+
+	nextParser++;
+	return batch;
+}
+
+// releaseBatch(CountsBatch* batch)
+//  Purpose:
+//		Returns batch to the pool so the reader can refill it
+void CountsReader::releaseBatch(CountsBatch* batch) {
+	freeBatches->push(batch);
+	wakeWaiters();
+}
+
+// setProgress(ScanProgress* scanProgress)
+//  Purpose:
+//		Reports the batches handed out to scanProgress, adding the size of
+//		the input to its total, and ends the batches when it asks the scan
+//		to stop.  NULL turns this off.
+//	Postconditions:
+//		progress - set
+void CountsReader::setProgress(ScanProgress* scanProgress) {
+	progress = scanProgress;
+	if (progress == NULL)
+		return;
+
+	struct stat status;
+	if (countsText != NULL)
+		progress->addTotalBytes(countsText->size());
+	else if (fileDescriptor >= 0 && fstat(fileDescriptor, &status) == 0)
+		progress->addTotalBytes(status.st_size);
+}
+
+// Public Class Methods
+// =============================================
+
+// int defaultParserThreads()
+//  Purpose:
+//		Returns the number of parser threads to use when none is given
+int CountsReader::defaultParserThreads() {
+	// Leave a core each for the reader and the scan
+	int threads = (int) thread::hardware_concurrency() - 2;
+	if (threads < 1)
+		return 1;
+	if (threads > 8)
+		return 8;
+	return threads;
+}
+
+// Private Methods
+// =============================================
+
+// startPipeline(int numParserThreads)
+//  Purpose:
+//		Creates the batches and queues and starts the reader and parser
+//		threads
+void CountsReader::startPipeline(int numParserThreads) {
+	numParsers = numParserThreads < 1 ? 1 : numParserThreads;
+	nextParser = 0;
+	stopping.store(false);
+	batchMoves.store(0);
+	sleepingThreads.store(0);
+
+	// Create the pool of batches, two per parser so each parser can work
+	// on one while the next is read
+	int numBatches = 2 * numParsers + 2;
+	freeBatches = new RingBuffer<CountsBatch*>(numBatches);
+	for (int i = 0; i < numBatches; i++) {
+		CountsBatch* batch = new CountsBatch();
+		batches.push_back(batch);
+		freeBatches->push(batch);
+	}
+
+	// Create the queues between the stages.  Each queue has room for every
+	// batch plus the end of file marker so pushes only wait on stopping.
+	for (int i = 0; i < numParsers; i++) {
+		unparsedBatches.push_back(new RingBuffer<CountsBatch*>(numBatches + 1));
+		parsedBatches.push_back(new RingBuffer<CountsBatch*>(numBatches + 1));
+	}
+
+	// Start the pipeline
+	for (int i = 0; i < numParsers; i++)
+		parserThreads.push_back(thread(&CountsReader::parseBatches, this, i));
+	readerThread = thread(&CountsReader::readFile, this);
+}
+
+// readFile()
+//  Purpose:
+//		Reader thread body.  Fills free batches with chunks of the file
+//		and hands them to the parsers in round robin order.
+void CountsReader::readFile() {
+	vector<char> carry;
+	long long batchNumber = 0;
+	bool endOfFile = (fileDescriptor < 0 && countsText == NULL);
+
+	while (!endOfFile) {
+		CountsBatch* batch;
+		if (!waitPop(*freeBatches, batch))
+			return;
+
+		// Start the chunk with the partial line left from the last chunk
+		// and read until the chunk contains a line break
+		vector<char>& text = batch->text;
+		text.assign(carry.begin(), carry.end());
+		carry.clear();
+		while (true) {
+			size_t oldSize = text.size();
+			text.resize(oldSize + CHUNK_SIZE);
+			size_t bytesRead = 0;
+			try {
+				bytesRead = readSource(&text[oldSize], CHUNK_SIZE);
+			}
+			catch (exception& e) {
+				// End the batches here, nextBatch reports the error
+				readError = "could not read counts file " + countsFileName + ": " + e.what();
+			}
+			text.resize(oldSize + bytesRead);
+
+			if (bytesRead == 0) {
+				endOfFile = true;
+				break;
+			}
+
+			// Hold back the partial line at the end of the chunk
+			size_t lineEnd = text.size();
+			while (lineEnd > oldSize && text[lineEnd - 1] != '\n')
+				lineEnd--;
+			if (lineEnd > oldSize) {
+				carry.assign(text.begin() + lineEnd, text.end());
+				text.resize(lineEnd);
+				break;
+			}
+		}
+
+		// Nothing left to parse, the batch stays out of the pool
+		if (text.empty())
+			break;
+
+		if (!waitPush(*unparsedBatches[batchNumber % numParsers], batch))
+			return;
+		batchNumber++;
+	}
+
+	// Tell every parser the file is done
+	for (int i = 0; i < numParsers; i++)
+		waitPush(*unparsedBatches[(batchNumber + i) % numParsers], NULL);
+}
+
+// parseBatches(int parser)
+//  Purpose:
+//		Parser thread body.  Parses the batches handed to parser.
+void CountsReader::parseBatches(int parser) {
+	CountsBatch* batch;
+	while (waitPop(*unparsedBatches[parser], batch)) {
+		if (batch != NULL)
+			batch->parse();
+		if (!waitPush(*parsedBatches[parser], batch) || batch == NULL)
+			return;
+	}
+}
+
+// size_t readSource(char* buffer, size_t size)
+//  Purpose:
+//		Reads the next size bytes of the file or text into buffer.
+//		Returns the number of bytes read, 0 at the end.
+size_t CountsReader::readSource(char* buffer, size_t size) {
+	if (countsText == NULL)
+		return fileReader->read(buffer, size);
+
+	size_t bytes = countsText->size() - countsTextOffset;
+	if (bytes > size)
+		bytes = size;
+	memcpy(buffer, countsText->data() + countsTextOffset, bytes);
+	countsTextOffset += bytes;
+	return bytes;
+}
+
+// bool waitPush(RingBuffer<CountsBatch*>& buffer, CountsBatch* batch)
+//  Purpose:
+//		Pushes batch, waiting while the buffer is full.  Returns false if
+//		the reader is stopping.
+bool CountsReader::waitPush(RingBuffer<CountsBatch*>& buffer, CountsBatch* batch) {
+	for (int tries = 0; ; tries++) {
+		long long moves = batchMoves.load();
+		if (buffer.push(batch))
+			break;
+		if (stopping.load(memory_order_relaxed))
+			return false;
+		if (tries < WAIT_SPINS)
+			this_thread::yield();
+		else
+			sleepUntilMoved(moves);
+	}
+	wakeWaiters();
+	return true;
+}
+
+// bool waitPop(RingBuffer<CountsBatch*>& buffer, CountsBatch*& batch)
+//  Purpose:
+//		Pops into batch, waiting while the buffer is empty.  Returns false
+//		if the reader is stopping.
+bool CountsReader::waitPop(RingBuffer<CountsBatch*>& buffer, CountsBatch*& batch) {
+	for (int tries = 0; ; tries++) {
+		long long moves = batchMoves.load();
+		if (buffer.pop(batch))
+			break;
+		if (stopping.load(memory_order_relaxed)) {
+			batch = NULL;
+			return false;
+		}
+		if (tries < WAIT_SPINS)
+			this_thread::yield();
+		else
+			sleepUntilMoved(moves);
+	}
+	wakeWaiters();
+	return true;
+}
+
+// sleepUntilMoved(long long moves)
+//  Purpose:
+//		Blocks until a batch has moved between stages since batchMoves
+//		was moves, or the reader is stopping
+void CountsReader::sleepUntilMoved(long long moves) {
+	unique_lock<mutex> lock(waitMutex);
+	sleepingThreads.fetch_add(1);
+	while (batchMoves.load() == moves && !stopping.load())
+		waitCondition.wait(lock);
+	sleepingThreads.fetch_sub(1);
+}
+
+// wakeWaiters()
+//  Purpose:
+//		Counts a batch moved between stages and wakes the sleeping
+//		threads, if there are any, to look at their buffers again
+void CountsReader::wakeWaiters() {
+	batchMoves.fetch_add(1);
+	if (sleepingThreads.load() == 0)
+		return;
+	{
+		lock_guard<mutex> lock(waitMutex);
+	}
+	waitCondition.notify_all();
+}
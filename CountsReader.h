@@ -0,0 +1,193 @@
+/*
+ * CountsReader.h
+ *
+ *	This is the header file for the CountsReader object. A CountsReader
+ *  reads a read start counts file (chromosome, position and read starts
+ *  seperated by tabs, one position per line) through a pipeline of threads:
+ *
+ *		reader thread	- reads the file in large chunks ending on a line
+ *						  boundary
+ *		parser threads	- convert the lines of a chunk to positions and
+ *						  read start codes
+ *		caller			- takes the parsed batches in file order
+ *
+ *  The stages are connected by lock-free ring buffers and a fixed pool of
+ *  batches is recycled so memory use is bounded no matter the file size.
+ *  A stage waiting on a buffer yields a few times and then sleeps until
+ *  another stage moves a batch, so a slow scan does not keep the parser
+ *  threads spinning.
+ *  The reader thread can keep several reads in flight with io_uring.
+ *
+ *	A reader given a ScanProgress counts each batch it hands out and
+ *  stops handing them out, as if at the end of the file, once the
+ *  progress asks the scan to stop.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef COUNTSREADER_H
+#define COUNTSREADER_H
+#include "AsyncFileReader.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class ScanProgress;
+
+// A run of consecutive records in a batch on the same chromosome
+struct ChromosomeRun {
+	string name;
+	int firstRecord;
+};
+
+// A chunk of the counts file and the records parsed from it
+struct CountsBatch {
+	vector<char> text;
+	vector<long long> positions;
+	vector<unsigned char> readStarts;
+	vector<unsigned short> rawReadStarts;
+	vector<ChromosomeRun> chromosomes;
+
+	// parse()
+	//  Purpose:
+	//		Parses the lines in text into positions, readStarts (capped at 3),
+	//		rawReadStarts (capped at 65535) and chromosomes.  Lines with fewer
+	//		than three fields are skipped.
+	void parse();
+};
+
+class CountsReader
+{
+public:
+	// Constuctors
+	// ==============================================
+	CountsReader(string fileName, int numParserThreads, bool asyncReads);
+
+	// Reads the counts from text, which must outlive the reader
+	CountsReader(const string& text, int numParserThreads);
+
+	// Destructor
+	// =============================================
+	~CountsReader();
+
+	// Public Methods
+	// =============================================
+
+	// CountsBatch* nextBatch()
+	//  Purpose:
+	//		Returns the next parsed batch in file order, or NULL at the end
+	//		of the file.  Each batch must be handed back with releaseBatch.
+	//		Throws runtime_error at the end of the batches if reading the
+	//		file failed.
+	CountsBatch* nextBatch();
+
+	// releaseBatch(CountsBatch* batch)
+	//  Purpose:
+	//		Returns batch to the pool so the reader can refill it
+	void releaseBatch(CountsBatch* batch);
+
+	// setProgress(ScanProgress* scanProgress)
+	//  Purpose:
+	//		Reports the batches handed out to scanProgress, adding the size
+	//		of the input to its total, and ends the batches when it asks
+	//		the scan to stop.  NULL turns this off.
+	//	Postconditions:
+	//		progress - set
+	void setProgress(ScanProgress* scanProgress);
+
+	// Public Class Methods
+	// =============================================
+
+	// int defaultParserThreads()
+	//  Purpose:
+	//		Returns the number of parser threads to use when none is given
+	static int defaultParserThreads();
+
+private:
+	static const size_t CHUNK_SIZE = 4 << 20;
+	static const size_t ASYNC_BLOCK_SIZE = 1 << 20;
+	static const int ASYNC_QUEUE_DEPTH = 8;
+	static const int WAIT_SPINS = 64;
+
+	int fileDescriptor;
+	string countsFileName;
+	AsyncFileReader* fileReader;
+	const string* countsText;
+	size_t countsTextOffset;
+	int numParsers;
+	long long nextParser;
+	atomic<bool> stopping;
+	ScanProgress* progress;
+
+	// Set by the reader thread before it ends the batches early
+	string readError;
+
+	vector<CountsBatch*> batches;
+	RingBuffer<CountsBatch*>* freeBatches;
+	vector<RingBuffer<CountsBatch*>*> unparsedBatches;
+	vector<RingBuffer<CountsBatch*>*> parsedBatches;
+
+	thread readerThread;
+	vector<thread> parserThreads;
+
+	// Waiting stages sleep on waitCondition until batchMoves changes
+	atomic<long long> batchMoves;
+	atomic<int> sleepingThreads;
+	mutex waitMutex;
+	condition_variable waitCondition;
+
+	// startPipeline(int numParserThreads)
+	//  Purpose:
+	//		Creates the batches and queues and starts the reader and parser
+	//		threads
+	void startPipeline(int numParserThreads);
+
+	// readFile()
+	//  Purpose:
+	//		Reader thread body.  Fills free batches with chunks of the file
+	//		and hands them to the parsers in round robin order.
+	void readFile();
+
+	// parseBatches(int parser)
+	//  Purpose:
+	//		Parser thread body.  Parses the batches handed to parser.
+	void parseBatches(int parser);
+
+	// size_t readSource(char* buffer, size_t size)
+	//  Purpose:
+	//		Reads the next size bytes of the file or text into buffer.
+	//		Returns the number of bytes read, 0 at the end.
+	size_t readSource(char* buffer, size_t size);
+
+	// bool waitPush(RingBuffer<CountsBatch*>& buffer, CountsBatch* batch)
+	//  Purpose:
+	//		Pushes batch, waiting while the buffer is full.  Returns false if
+	//		the reader is stopping.
+	bool waitPush(RingBuffer<CountsBatch*>& buffer, CountsBatch* batch);
+
+	// bool waitPop(RingBuffer<CountsBatch*>& buffer, CountsBatch*& batch)
+	//  Purpose:
+	//		Pops into batch, waiting while the buffer is empty.  Returns false
+	//		if the reader is stopping.
+	bool waitPop(RingBuffer<CountsBatch*>& buffer, CountsBatch*& batch);
+
+	// sleepUntilMoved(long long moves)
+	//  Purpose:
+	//		Blocks until a batch has moved between stages since batchMoves
+	//		was moves, or the reader is stopping
+	void sleepUntilMoved(long long moves);
+
+	// wakeWaiters()
+	//  Purpose:
+	//		Counts a batch moved between stages and wakes the sleeping
+	//		threads, if there are any, to look at their buffers again
+	void wakeWaiters();
+};
+
+#endif //COUNTSREADER_H
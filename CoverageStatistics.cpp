@@ -0,0 +1,182 @@
+/*
+ * CoverageStatistics.cpp
+ *
+ *	This is the cpp file for the CoverageStatistics object. A
+ *  CoverageStatistics accumulates read start statistics per chromosome
+ *  and per fixed size window while the counts are scanned.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "CoverageStatistics.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// Constuctors
+// ==============================================
+CoverageStatistics::CoverageStatistics(int size) {
+	windowSize = size < 1 ? 1 : size;
+	current = NULL;
+}
+
+// Public Methods
+// =============================================
+
+// startChromosome(string name)
+//  Purpose:
+//		Makes name the chromosome the following positions are added to
+void CoverageStatistics::startChromosome(string name) {
+	if (current != NULL && current->name == name)
+		return;
+
+	// A chromosome may come back if the file is not grouped by chromosome
+	for (size_t i = 0; i < chromosomes.size(); i++) {
+		if (chromosomes[i].name == name) {
+			current = &chromosomes[i];
+			return;
+		}
+	}
+
+	ChromosomeStatistics chromosome;
+	chromosome.name = name;
+	clear(chromosome.total);
+	chromosomes.push_back(chromosome);
+	current = &chromosomes.back();
+}
+
+// addPositions(const long long* positions, const unsigned short* counts, size_t numPositions)
+//  Purpose:
+//		Adds the raw read start counts at positions to the current
+//		chromosome and its windows
+void CoverageStatistics::addPositions(const long long* positions, const unsigned short* counts, size_t numPositions) {
+	if (current == NULL)
+		startChromosome("");
+
+	Accumulator& total = current->total;
+	vector<Accumulator>& windows = current->windows;
+	for (size_t i = 0; i < numPositions; i++) {
+		long long count = counts[i];
+		int bin = count < HISTOGRAM_BINS ? (int) count : HISTOGRAM_BINS - 1;
+
+		// Positions are 1 based
+		size_t window = positions[i] > 0 ? (positions[i] - 1) / windowSize : 0;
+		if (window >= windows.size()) {
+			size_t oldSize = windows.size();
+			windows.resize(window + 1);
+			for (size_t j = oldSize; j < windows.size(); j++)
+				clear(windows[j]);
+		}
+
+		Accumulator& accumulator = windows[window];
+		accumulator.positions++;
+		accumulator.sum += count;
+		accumulator.sumSquares += count * count;
+		accumulator.histogram[bin]++;
+
+		total.positions++;
+		total.sum += count;
+		total.sumSquares += count * count;
+		total.histogram[bin]++;
+	}
+}
+
+// string resultsString()
+//  Purpose:
+//		Returns a string representing the statistics for each chromosome
+//
+//		format:
+//			<result type="coverage_statistics" window_size="<<windowSize>>">
+//				<chromosome name="<<name>>" positions="<<count>>" mean="<<mean>>" variance="<<variance>>">
+//					<<readStarts>>=<<positions>>,...
+//				</chromosome>
+//				...
+//			</result>
+string CoverageStatistics::resultsString() {
+	stringstream ss;
+
+	// Header
+	ss << "    <result type=\"coverage_statistics\" window_size=\"" << windowSize << "\">\n";
+
+	// Chromosomes
+	for (size_t i = 0; i < chromosomes.size(); i++) {
+		Accumulator& total = chromosomes[i].total;
+		double mean = total.positions == 0 ? 0 : (double) total.sum / total.positions;
+		double variance = total.positions == 0 ? 0 : (double) total.sumSquares / total.positions - mean * mean;
+
+		ss
+			<< "      <chromosome name=\"" << chromosomes[i].name
+			<< "\" positions=\"" << total.positions
+			<< "\" mean=\"" << mean
+			<< "\" variance=\"" << variance << "\">";
+		for (int j = 0; j < HISTOGRAM_BINS; j++) {
+			ss << j << "=" << total.histogram[j];
+			if (j < HISTOGRAM_BINS - 1)
+				ss << ",";
+		}
+		ss << "</chromosome>\n";
+	}
+
+	// Footer
+	ss << "    </result>\n";
+
+	return ss.str();
+}
+
+// writeWindows(string fileName)
+//  Purpose:
+//		Writes the statistics for every window that has positions to
+//		fileName, one tab seperated line per window:
+//			chromosome start end positions mean variance histogram...
+//		Throws runtime_error if the file can not be written.
+void CoverageStatistics::writeWindows(string fileName) {
+	ofstream windowFile(fileName);
+	if (!windowFile)
+		throw runtime_error("could not open window statistics file " + fileName + " for writing");
+	for (size_t i = 0; i < chromosomes.size(); i++) {
+		vector<Accumulator>& windows = chromosomes[i].windows;
+		for (size_t j = 0; j < windows.size(); j++) {
+			if (windows[j].positions == 0)
+				continue;
+			windowFile
+				<< chromosomes[i].name << "\t"
+				<< (long long) j * windowSize + 1 << "\t"
+				<< (long long) (j + 1) * windowSize << "\t"
+				<< accumulatorString(windows[j], '\t') << "\n";
+		}
+	}
+
+	windowFile.close();
+	if (!windowFile)
+		throw runtime_error("could not write window statistics file " + fileName);
+}
+
+// Private Methods
+// =============================================
+
+// clear(Accumulator& accumulator)
+//  Purpose:
+//		Sets all values in accumulator to zero
+void CoverageStatistics::clear(Accumulator& accumulator) {
+	accumulator.positions = 0;
+	accumulator.sum = 0;
+	accumulator.sumSquares = 0;
+	for (int i = 0; i < HISTOGRAM_BINS; i++)
+		accumulator.histogram[i] = 0;
+}
+
+// string accumulatorString(const Accumulator& accumulator, char seperator)
+//  Purpose:
+//		Returns positions, mean, variance and the histogram of accumulator
+//		seperated by seperator
+string CoverageStatistics::accumulatorString(const Accumulator& accumulator, char seperator) {
+	stringstream ss;
+	double mean = accumulator.positions == 0 ? 0 : (double) accumulator.sum / accumulator.positions;
+	double variance = accumulator.positions == 0 ? 0 : (double) accumulator.sumSquares / accumulator.positions - mean * mean;
+
+	ss << accumulator.positions << seperator << mean << seperator << variance;
+	for (int i = 0; i < HISTOGRAM_BINS; i++)
+		ss << seperator << accumulator.histogram[i];
+
+	return ss.str();
+}
@@ -0,0 +1,94 @@
+/*
+ * CoverageStatistics.h
+ *
+ *	This is the header file for the CoverageStatistics object. A
+ *  CoverageStatistics accumulates read start statistics (positions, mean,
+ *  variance and a histogram of the raw counts) per chromosome and per
+ *  fixed size window while the counts are scanned.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef COVERAGESTATISTICS_H
+#define COVERAGESTATISTICS_H
+#include <string>
+#include <vector>
+using namespace std;
+
+class CoverageStatistics
+{
+public:
+	// Raw counts of HISTOGRAM_BINS - 1 or more share the last bin
+	static const int HISTOGRAM_BINS = 16;
+
+	// Constuctors
+	// ==============================================
+	CoverageStatistics(int windowSize);
+
+	// Public Methods
+	// =============================================
+
+	// startChromosome(string name)
+	//  Purpose:
+	//		Makes name the chromosome the following positions are added to
+	void startChromosome(string name);
+
+	// addPositions(const long long* positions, const unsigned short* counts, size_t numPositions)
+	//  Purpose:
+	//		Adds the raw read start counts at positions to the current
+	//		chromosome and its windows
+	void addPositions(const long long* positions, const unsigned short* counts, size_t numPositions);
+
+	// string resultsString()
+	//  Purpose:
+	//		Returns a string representing the statistics for each chromosome
+	//
+	//		format:
+	//			<result type="coverage_statistics" window_size="<<windowSize>>">
+	//				<chromosome name="<<name>>" positions="<<count>>" mean="<<mean>>" variance="<<variance>>">
+	//					<<readStarts>>=<<positions>>,...
+	//				</chromosome>
+	//				...
+	//			</result>
+	string resultsString();
+
+	// writeWindows(string fileName)
+	//  Purpose:
+	//		Writes the statistics for every window that has positions to
+	//		fileName, one tab seperated line per window:
+	//			chromosome start end positions mean variance histogram...
+	//		Throws runtime_error if the file can not be written.
+	void writeWindows(string fileName);
+
+private:
+	struct Accumulator {
+		long long positions;
+		long long sum;
+		long long sumSquares;
+		long long histogram[HISTOGRAM_BINS];
+	};
+
+	struct ChromosomeStatistics {
+		string name;
+		Accumulator total;
+		vector<Accumulator> windows;
+	};
+
+	int windowSize;
+	vector<ChromosomeStatistics> chromosomes;
+	ChromosomeStatistics* current;
+
+	// clear(Accumulator& accumulator)
+	//  Purpose:
+	//		Sets all values in accumulator to zero
+	static void clear(Accumulator& accumulator);
+
+	// string accumulatorString(const Accumulator& accumulator, char seperator)
+	//  Purpose:
+	//		Returns positions, mean, variance and the histogram of accumulator
+	//		seperated by seperator
+	static string accumulatorString(const Accumulator& accumulator, char seperator);
+};
+
+#endif //COVERAGESTATISTICS_H
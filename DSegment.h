@@ -0,0 +1,37 @@
+/*
+ * DSegment.h
+ *
+ *	This is the header file for the DSegment struct. A DSegment is a
+ *  segment found by a D-Segment scan with its score and the statistics
+ *  of its positions.  Positions are 64-bit so segments of concatenated
+ *  genomes fit.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef DSEGMENT_H
+#define DSEGMENT_H
+
+struct DSegment {
+	long long start;
+	long long end;
+	long double score;
+
+	// Statistics of the positions from start to end
+	int readStartCounts[4];		// positions by read start code
+	long long readStartSum;		// read starts, not capped at 3
+
+	// Chromosome of the segment's end, as numbered by setChromosome, or
+	// -1 if the scan did not number them
+	int chromosome;
+
+	// int positions()
+	//  Purpose:
+	//		Returns the number of positions (records) in the segment
+	int positions() const {
+		return readStartCounts[0] + readStartCounts[1] + readStartCounts[2] + readStartCounts[3];
+	}
+};
+
+#endif //DSEGMENT_H
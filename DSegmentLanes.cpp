@@ -0,0 +1,129 @@
+/*
+ * DSegmentLanes.cpp
+ *
+ *	This is the cpp file for the DSegmentLanes object. A DSegmentLanes
+ *  runs the maximal D-Segment scan for many samples at once, one lane
+ *  per sample, with the lane state stored lane by lane.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "DSegmentLanes.h"
+
+// Constuctors
+// ==============================================
+DSegmentLanes::DSegmentLanes(int numLanes, const long double scoreTable[4], double scoreThreshold) {
+	lanes = numLanes;
+	for (int i = 0; i < 4; i++)
+		scores[i] = (double) scoreTable[i];
+	threshold = scoreThreshold;
+
+	segments.resize(lanes);
+	cum.assign(lanes, 0);
+	max.assign(lanes, 0);
+	start.assign(lanes, 0);
+	end.assign(lanes, 0);
+	startPending.assign(lanes, 1);
+	segmentScore.assign(lanes, -1);
+}
+
+// Lane Steps
+// =============================================
+
+// stepLanes(int lanes, long long position, const unsigned char* codes, const double scores[4], double threshold, ...)
+//  Purpose:
+//		Adds position to every lane, choosing rather than branching or
+//		looking up the score so the loop vectorizes.  The lane arrays do
+//		not overlap, which the compiler has to be told.  A lane that
+//		reaches a segment is reset with its start and end left in place
+//		and the segment's score in segmentScore, the other lanes get a
+//		segmentScore of -1.
+static void stepLanes(int lanes, long long position, const unsigned char* __restrict codes,
+	const double scores[4], double threshold,
+	double* __restrict cum, double* __restrict max, long long* __restrict start, long long* __restrict end,
+	int* __restrict startPending, double* __restrict segmentScore) {
+	double score0 = scores[0];
+	double score1 = scores[1];
+	double score2 = scores[2];
+	double score3 = scores[3];
+
+	for (int i = 0; i < lanes; i++) {
+		int code = codes[i];
+		int present = code < 4;
+		double score = code == 3 ? score3 : 0;
+		score = code == 2 ? score2 : score;
+		score = code == 1 ? score1 : score;
+		score = code == 0 ? score0 : score;
+
+		// A position without a record does not start a segment
+		int pending = startPending[i];
+		start[i] = pending & present ? position : start[i];
+
+		// Keep track of maximum score to this point
+		double cumulative = cum[i] + score;
+		int newMax = present & (cumulative >= max[i]);
+		double maximum = newMax ? cumulative : max[i];
+		end[i] = newMax ? position : end[i];
+
+		// Check if over threshold
+		int reset = present & ((cumulative <= 0) | (cumulative <= maximum - threshold));
+		int segment = reset & (maximum >= threshold);
+		segmentScore[i] = segment ? maximum : -1;
+		cum[i] = reset ? 0 : cumulative;
+		max[i] = reset ? 0 : maximum;
+		startPending[i] = (pending & !present) | reset;
+	}
+}
+
+// Public Methods
+// =============================================
+
+// addPosition(long long position, const unsigned char* codes)
+//  Purpose:
+//		Adds position to every lane, lane i reading codes[i] (0 to 3, or
+//		4 for no record)
+void DSegmentLanes::addPosition(long long position, const unsigned char* codes) {
+	stepLanes(lanes, position, codes, scores, threshold,
+		cum.data(), max.data(), start.data(), end.data(), startPending.data(), segmentScore.data());
+
+	// Segments are rare, add them lane by lane.  Checking for them in a
+	// separate loop keeps the step free of a reduction across lanes,
+	// which stops it vectorizing.
+	for (int i = 0; i < lanes; i++)
+		if (segmentScore[i] >= 0)
+			addSegment(i);
+}
+
+// finish()
+//  Purpose:
+//		Checks if the last segment of each lane is a D-Segment and
+//		starts every lane over
+void DSegmentLanes::finish() {
+	for (int i = 0; i < lanes; i++) {
+		if (max[i] >= threshold) {
+			segmentScore[i] = max[i];
+			addSegment(i);
+		}
+		cum[i] = 0;
+		max[i] = 0;
+		startPending[i] = 1;
+	}
+}
+
+// Private Methods
+// =============================================
+
+// addSegment(int lane)
+//  Purpose:
+//		Creates a segment for the current maximum of lane
+void DSegmentLanes::addSegment(int lane) {
+	DSegment segment;
+	segment.start = start[lane];
+	segment.end = end[lane];
+	segment.score = segmentScore[lane];
+	for (int c = 0; c < 4; c++)
+		segment.readStartCounts[c] = 0;
+	segment.readStartSum = 0;
+	segment.chromosome = -1;
+	segments[lane].push_back(segment);
+}
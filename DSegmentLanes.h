@@ -0,0 +1,74 @@
+/*
+ * DSegmentLanes.h
+ *
+ *	This is the header file for the DSegmentLanes object. A DSegmentLanes
+ *  runs the maximal D-Segment scan for many samples at once, one lane
+ *  per sample.  The codes of all samples at a position are added
+ *  together and the running state of the lanes is stored lane by lane
+ *  (an array per field) so the compiler can step all lanes with vector
+ *  instructions.  Segments are only written out, lane by lane, at the
+ *  positions where some lane reaches one.
+ *
+ *	Each lane finds the same segments as a DSegmentScanner<double, double>
+ *  over that sample alone, without the read start statistics.  Code 4
+ *  marks a position the sample has no record for, it scores 0.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef DSEGMENTLANES_H
+#define DSEGMENTLANES_H
+#include "DSegmentScanner.h"
+#include <vector>
+using namespace std;
+
+class DSegmentLanes
+{
+public:
+	// Constuctors
+	// ==============================================
+	DSegmentLanes(int numLanes, const long double scoreTable[4], double scoreThreshold);
+
+	// Public Attributes
+	// =============================================
+	vector<vector<DSegment> > segments;
+
+	// Public Methods
+	// =============================================
+
+	// addPosition(long long position, const unsigned char* codes)
+	//  Purpose:
+	//		Adds position to every lane, lane i reading codes[i] (0 to 3, or
+	//		4 for no record)
+	void addPosition(long long position, const unsigned char* codes);
+
+	// finish()
+	//  Purpose:
+	//		Checks if the last segment of each lane is a D-Segment and
+	//		starts every lane over
+	void finish();
+
+private:
+	int lanes;
+	double scores[4];
+	double threshold;
+
+	// Lane state, one entry per lane
+	vector<double> cum;
+	vector<double> max;
+	vector<long long> start;
+	vector<long long> end;
+	vector<int> startPending;
+
+	// Score of the segment each lane reached at the last position, -1
+	// for none
+	vector<double> segmentScore;
+
+	// addSegment(int lane)
+	//  Purpose:
+	//		Creates a segment for the current maximum of lane
+	void addSegment(int lane);
+};
+
+#endif //DSEGMENTLANES_H
@@ -0,0 +1,266 @@
+/*
+ * DSegmentScanner.h
+ *
+ *	This is the header file for the DSegmentScanner object. A DSegmentScanner
+ *  holds the running state of the maximal D-Segment scan for one score
+ *  track.  Positions are added one at a time and the scanner collects the
+ *  D-Segments that score over the threshold.
+ *
+ *	Each segment carries the read start histogram and read start total of
+ *  its positions, accumulated as the scan goes.  Positions after the
+ *  current maximum are held apart until the maximum moves past them, so
+ *  the statistics cover exactly start to end.
+ *
+ *	The scanner is a template on the per-position Score type and the Sum
+ *  type used to accumulate scores so the same scan can be run in float,
+ *  double, long double or fixed-point integer precision.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef DSEGMENTSCANNER_H
+#define DSEGMENTSCANNER_H
+#include "DSegment.h"
+#include "SegmentStore.h"
+#include <vector>
+using namespace std;
+
+// Running state of a scan, enough to carry a scan on from where another
+// left off.  The sums are held in long double, which holds every Sum type
+// exactly.  The counts are for the positions from start to end and for
+// the positions after end.
+struct DSegmentScanState {
+	long double cum;
+	long double max;
+	long long start;
+	long long end;
+	bool startPending;
+	int readStartCounts[4];
+	long long readStartSum;
+	int pendingReadStartCounts[4];
+	long long pendingReadStartSum;
+};
+
+template <typename Score, typename Sum>
+class DSegmentScanner
+{
+public:
+	// Constuctors
+	// ==============================================
+	DSegmentScanner(const Score scoreTable[4], Sum scoreThreshold, long double scoreScale) {
+		for (int i = 0; i < 4; i++) {
+			scores[i] = scoreTable[i];
+			dSegmentReadStartCounts[i] = 0;
+		}
+		threshold = scoreThreshold;
+		scale = scoreScale;
+		chromosome = -1;
+		endChromosome = -1;
+		store = NULL;
+		reset();
+	}
+
+	// Public Attributes
+	// =============================================
+	vector<DSegment> segments;
+	int dSegmentReadStartCounts[4];
+
+	// Public Methods
+	// =============================================
+
+	// setSegmentStore(SegmentStore* segmentStore)
+	//  Purpose:
+	//		Adds the segments found from here on to segmentStore in place
+	//		of segments.  NULL goes back to segments.
+	void setSegmentStore(SegmentStore* segmentStore) {
+		store = segmentStore;
+	}
+
+	// setChromosome(int chromosomeNumber)
+	//  Purpose:
+	//		Numbers the chromosome of the positions added from here on
+	void setChromosome(int chromosomeNumber) {
+		chromosome = chromosomeNumber;
+	}
+
+	// addPosition(long long position, int readStarts, int rawReadStarts)
+	//  Purpose:
+	//		Adds the score for readStarts at position to the scan
+	//	Preconditions:
+	//		readStarts - rawReadStarts capped at 3
+	void addPosition(long long position, int readStarts, int rawReadStarts) {
+		addScore(position, readStarts, rawReadStarts, scores[readStarts]);
+	}
+
+	// addScore(long long position, int readStarts, int rawReadStarts, Score score)
+	//  Purpose:
+	//		Adds score for readStarts at position to the scan, for scores
+	//		that depend on more than the read starts
+	//	Preconditions:
+	//		readStarts - rawReadStarts capped at 3
+	void addScore(long long position, int readStarts, int rawReadStarts, Score score) {
+		pendingReadStartCounts[readStarts]++;
+		addCountedScore(position, rawReadStarts, score);
+	}
+
+	// addRecordsScore(long long position, const int readStartCounts[4], int rawReadStarts, Score score)
+	//  Purpose:
+	//		Adds score for several records at position to the scan, as for
+	//		the sum of several samples' scores
+	//	Preconditions:
+	//		readStartCounts - the records by read start code
+	//		rawReadStarts - the records' total read starts
+	void addRecordsScore(long long position, const int readStartCounts[4], int rawReadStarts, Score score) {
+		for (int i = 0; i < 4; i++)
+			pendingReadStartCounts[i] += readStartCounts[i];
+		addCountedScore(position, rawReadStarts, score);
+	}
+
+	// finish()
+	//  Purpose:
+	//		Checks if the last segment is a D-Segment
+	void finish() {
+		if (max >= threshold)
+			addSegment();
+	}
+
+	// bool segmentOpen()
+	//  Purpose:
+	//		Returns true if a segment has started since the last reset
+	bool segmentOpen() {
+		return !startPending;
+	}
+
+	// DSegmentScanState state()
+	//  Purpose:
+	//		Returns the running state of the scan
+	DSegmentScanState state() {
+		DSegmentScanState scanState;
+		scanState.cum = cum;
+		scanState.max = max;
+		scanState.start = start;
+		scanState.end = end;
+		scanState.startPending = startPending;
+		for (int i = 0; i < 4; i++) {
+			scanState.readStartCounts[i] = currentSegmentReadStartCounts[i];
+			scanState.pendingReadStartCounts[i] = pendingReadStartCounts[i];
+		}
+		scanState.readStartSum = currentSegmentReadStartSum;
+		scanState.pendingReadStartSum = pendingReadStartSum;
+		return scanState;
+	}
+
+	// setState(const DSegmentScanState& scanState)
+	//  Purpose:
+	//		Continues the scan from scanState
+	void setState(const DSegmentScanState& scanState) {
+		cum = (Sum) scanState.cum;
+		max = (Sum) scanState.max;
+		start = scanState.start;
+		end = scanState.end;
+		startPending = scanState.startPending;
+		for (int i = 0; i < 4; i++) {
+			currentSegmentReadStartCounts[i] = scanState.readStartCounts[i];
+			pendingReadStartCounts[i] = scanState.pendingReadStartCounts[i];
+		}
+		currentSegmentReadStartSum = scanState.readStartSum;
+		pendingReadStartSum = scanState.pendingReadStartSum;
+	}
+
+private:
+	Score scores[4];
+	Sum threshold;
+	long double scale;
+	Sum cum;
+	Sum max;
+	long long start;
+	long long end;
+	int chromosome;
+	int endChromosome;
+	SegmentStore* store;
+	bool startPending;
+	int currentSegmentReadStartCounts[4];
+	long long currentSegmentReadStartSum;
+	int pendingReadStartCounts[4];
+	long long pendingReadStartSum;
+
+	// addCountedScore(long long position, int rawReadStarts, Score score)
+	//  Purpose:
+	//		Adds score at position to the scan once its records are
+	//		counted in pendingReadStartCounts
+	void addCountedScore(long long position, int rawReadStarts, Score score) {
+
+		// The first position after a reset starts the next segment
+		if (startPending) {
+			start = position;
+			startPending = false;
+		}
+		pendingReadStartSum += rawReadStarts;
+
+		// Add the score to the cumulative score
+		cum += score;
+
+		// Keep track of maximum score to this point, the positions up to
+		// it are now part of the segment
+		if (cum >= max) {
+			max = cum;
+			end = position;
+			endChromosome = chromosome;
+			for (int i = 0; i < 4; i++) {
+				currentSegmentReadStartCounts[i] += pendingReadStartCounts[i];
+				pendingReadStartCounts[i] = 0;
+			}
+			currentSegmentReadStartSum += pendingReadStartSum;
+			pendingReadStartSum = 0;
+		}
+
+		// Check if over threshold
+		if (cum <= 0 || cum <= max - threshold) {
+			if (max >= threshold)
+				addSegment();
+			reset();
+		}
+	}
+
+	// reset()
+	//  Purpose:
+	//		Starts a new segment at the next position
+	void reset() {
+		cum = 0;
+		max = 0;
+		start = 0;
+		end = 0;
+		startPending = true;
+		for (int i = 0; i < 4; i++) {
+			currentSegmentReadStartCounts[i] = 0;
+			pendingReadStartCounts[i] = 0;
+		}
+		currentSegmentReadStartSum = 0;
+		pendingReadStartSum = 0;
+	}
+
+	// addSegment()
+	//  Purpose:
+	//		Creates a segment for the current maximum and adds the current
+	//		segment counts to the d-segment counts
+	void addSegment() {
+		DSegment segment;
+		segment.start = start;
+		segment.end = end;
+		segment.score = max / scale;
+		segment.chromosome = endChromosome;
+		for (int i = 0; i < 4; i++)
+			segment.readStartCounts[i] = currentSegmentReadStartCounts[i];
+		segment.readStartSum = currentSegmentReadStartSum;
+		if (store != NULL)
+			store->push_back(segment);
+		else
+			segments.push_back(segment);
+
+		for (int i = 0; i < 4; i++)
+			dSegmentReadStartCounts[i] += currentSegmentReadStartCounts[i];
+	}
+};
+
+#endif //DSEGMENTSCANNER_H
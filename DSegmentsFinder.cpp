@@ -9,10 +9,16 @@
  */
 #include "DSegmentsFinder.h"
 #include "StringUtilities.h"
+#include "ThresholdCalibrator.h"
+#include "ResultCache.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <math.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <limits>
+#include <algorithm>
 
 DSegmentsFinder::DSegmentsFinder() {
 }
@@ -24,6 +30,54 @@ DSegmentsFinder::DSegmentsFinder(HMMProbabilities* probs) {
 		dSegmentReadStartCounts[i] = 0;
 	}
 
+	// Score in the build precision unless fixed-point scoring is requested
+	fixedPointBits = 0;
+	scorePrecision = CNV_SCORE_PRECISION;
+	validatePrecision = false;
+	maxScoreDivergence = 0;
+	parserThreads = CountsReader::defaultParserThreads();
+	asyncReads = false;
+	significanceSimulations = 0;
+	nullModel = PERMUTED_NULL;
+	significanceSeed = 0;
+	nullMaxScore95 = 0;
+	calibrationRate = 0;
+	calibrationMegabases = 0;
+	calibrationSeed = 0;
+	calibrationCached = false;
+	coverageWindowSize = 0;
+	coverageStatistics = NULL;
+	pairedNormalMean = 0;
+	weightTrack = NULL;
+	weightedPositions = 0;
+	unweightedPositions = 0;
+	pairedMatchedRecords = 0;
+	pairedTumorOnlyRecords = 0;
+	pairedNormalOnlyRecords = 0;
+	shardStart = 0;
+	shardEnd = 0;
+	shardLeadIn = 0;
+	shard = NULL;
+	binSize = 0;
+	binThreshold = 0;
+	binPadding = 0;
+	verifyBins = false;
+	binCandidates = 0;
+	binScannedPositions = 0;
+	jointPositions = 0;
+	jointThreshold = 0;
+	resultCacheHits = 0;
+	resultCacheMisses = 0;
+	resultCacheFullScan = false;
+	scoreIndex = NULL;
+	scoreIndexInput = false;
+	segmentEngine = RESET_SCAN_ENGINE;
+	compareEngines = false;
+	sharedEngineSegments = 0;
+	progress = NULL;
+	compactSegments = false;
+	segmentMemoryLimit = 0;
+
 	// Initialize the probabailities and threshold
 	probabilities = probs;
 /*	threshold =
@@ -34,98 +88,1614 @@ DSegmentsFinder::DSegmentsFinder(HMMProbabilities* probs) {
 		)
 		/ log(2);
 */
-		long double  sameSegProb =
-			probs->logTransitionProbability(1,1) + probs->logTransitionProbability(2,2);
-		long double  switchSegProb =
-			probs->logTransitionProbability(1,2) + probs->logTransitionProbability(2,1);
-		threshold = (sameSegProb - switchSegProb) / log(2);
+	threshold = probs->dSegmentThreshold(2);
+
+	// Threshold for losses when the model has a reduced state
+	lossThreshold = 0;
+	for (int i = 0; i < 4; i++)
+		lossReadStartCounts[i] = 0;
+	if (probs->hasReducedState())
+		lossThreshold = probs->dSegmentThreshold(3);
 }
 
 DSegmentsFinder::~DSegmentsFinder() {
+	delete coverageStatistics;
+	delete weightTrack;
+	delete shard;
+	delete scoreIndex;
+	for (size_t i = 0; i < annotationIndexes.size(); i++)
+		delete annotationIndexes[i];
 }
 
 // findDSegments(string cnvFileName)
 //  Purpose: 
 //		Finds the DSegments for the sequence
 void DSegmentsFinder::findDSegments(string cnvFileName) {
+	if (!scoreIndexFileName.empty()
+		&& (!resultCacheDirectory.empty() || !jointSampleFileNames.empty() || !pairedNormalFileName.empty()))
+		throw invalid_argument("score indexes are built from single sample scans, without the result cache");
+	if ((segmentEngine != RESET_SCAN_ENGINE || compareEngines)
+		&& (!resultCacheDirectory.empty() || !jointSampleFileNames.empty() || !pairedNormalFileName.empty()
+			|| !scoreIndexFileName.empty()))
+		throw invalid_argument("the maximal subsequence engine does not run on joint, paired or cached scans or score indexes");
+	if (!annotationFileNames.empty()
+		&& (!resultCacheDirectory.empty() || !jointSampleFileNames.empty() || !pairedNormalFileName.empty()))
+		throw invalid_argument("annotation runs on single sample scans, without the result cache");
+	if (compactSegments
+		&& (!resultCacheDirectory.empty() || !jointSampleFileNames.empty() || !pairedNormalFileName.empty()))
+		throw invalid_argument("compact segments are kept for single sample scans, without the result cache");
+	if (!resultCacheDirectory.empty()) {
+		findCachedDSegments(cnvFileName);
+		return;
+	}
+
+	CountsReader reader(cnvFileName, parserThreads, asyncReads);
+	reader.setProgress(progress);
+	if (!jointSampleFileNames.empty()) {
+		if (probabilities->hasReducedState() || validatePrecision || !pairedNormalFileName.empty()
+			|| !weightTrackFileName.empty() || !shardChromosome.empty() || binSize > 0)
+			throw invalid_argument("joint scans find gains only, without a normal, weights, shards, bins or precision validation");
+
+		// Read the other samples alongside the first
+		jointCountsFileName = cnvFileName;
+		vector<CountsReader*> readers(1, &reader);
+		for (size_t i = 0; i < jointSampleFileNames.size(); i++) {
+			readers.push_back(new CountsReader(jointSampleFileNames[i], parserThreads, asyncReads));
+			readers.back()->setProgress(progress);
+		}
+		scanJointDSegments(readers);
+		for (size_t i = 1; i < readers.size(); i++)
+			delete readers[i];
+		return;
+	}
+	if (pairedNormalFileName.empty()) {
+		findDSegments(reader);
+		return;
+	}
+
+	// Read the normal alongside the tumor, and again once the tumor's
+	// chromosomes are known if the normal has some the tumor lacks
+	vector<string> tumorChromosomes;
+	{
+		CountsReader normalReader(pairedNormalFileName, parserThreads, asyncReads);
+		normalReader.setProgress(progress);
+		if (scanPairedDSegments(reader, normalReader, tumorChromosomes, false))
+			return;
+	}
+	CountsReader tumorReader(cnvFileName, parserThreads, asyncReads);
+	CountsReader normalReader(pairedNormalFileName, parserThreads, asyncReads);
+	tumorReader.setProgress(progress);
+	normalReader.setProgress(progress);
+	scanPairedDSegments(tumorReader, normalReader, tumorChromosomes, true);
+}
+
+// findDSegmentsInCounts(const string& counts)
+//  Purpose: 
+//		Finds the DSegments for a sequence given as the text of a
+//		counts file
+void DSegmentsFinder::findDSegmentsInCounts(const string& counts) {
+	CountsReader reader(counts, parserThreads);
+	reader.setProgress(progress);
+	findDSegments(reader);
+}
+
+// findDSegments(CountsReader& reader)
+//  Purpose:
+//		Finds the DSegments for the sequence read by reader
+void DSegmentsFinder::findDSegments(CountsReader& reader) {
+	calibrateThreshold();
+
+	delete coverageStatistics;
+	coverageStatistics = NULL;
+	if (coverageWindowSize > 0)
+		coverageStatistics = new CoverageStatistics(coverageWindowSize);
+
+	delete weightTrack;
+	weightTrack = NULL;
+	if (!weightTrackFileName.empty())
+		weightTrack = new WeightTrack(weightTrackFileName);
+
+	// The null sequences are scored with the unweighted gain scores
+	if (significanceSimulations > 0 && (weightTrack != NULL || probabilities->hasReducedState()))
+		throw invalid_argument("significance is tested for unweighted gains only, without weights or losses");
+
+	delete shard;
+	shard = NULL;
+	if (!shardChromosome.empty()) {
+		if (probabilities->hasReducedState() || validatePrecision)
+			throw invalid_argument("shards scan for gains only, without precision validation");
+		shard = new ShardFile();
+		shard->chromosome = shardChromosome;
+		shard->start = shardStart;
+		shard->end = shardEnd;
+	}
+
+	if ((segmentEngine != RESET_SCAN_ENGINE || compareEngines)
+		&& (probabilities->hasReducedState() || validatePrecision || shard != NULL || binSize > 0))
+		throw invalid_argument("the maximal subsequence engine finds gains only, without shards, bins or precision validation");
+
+	if (!annotationFileNames.empty()) {
+		if (shard != NULL || binSize > 0)
+			throw invalid_argument("annotation runs on whole scans without bins");
+		for (size_t i = annotationIndexes.size(); i < annotationFileNames.size(); i++)
+			annotationIndexes.push_back(new IntervalIndex(annotationFileNames[i]));
+	}
+
+	delete scoreIndex;
+	scoreIndex = NULL;
+	if (!scoreIndexFileName.empty()) {
+		if (weightTrack != NULL || shard != NULL || binSize > 0)
+			throw invalid_argument("score indexes are built from whole, unweighted scans without bins");
+		scoreIndex = new ScoreIndex();
+	}
+
+	if (compactSegments
+		&& (validatePrecision || shard != NULL || binSize > 0 || significanceSimulations > 0
+			|| !annotationFileNames.empty() || segmentEngine != RESET_SCAN_ENGINE || compareEngines))
+		throw invalid_argument("compact segments are kept for whole reset scans, without bins, significance, annotation or precision validation");
+
+	long double scores[4];
+	probabilities->dSegmentScoreTable(scores);
+
+	// Binned scans score in long double, fixed-point scores are
+	// multiples of 2^-fixedPointBits
+	if (binSize > 0) {
+		if (probabilities->hasReducedState() || validatePrecision || shard != NULL || weightTrack != NULL)
+			throw invalid_argument("binned scans find gains only, without weights, shards or precision validation");
+		scanBinnedDSegments(reader, scores);
+	}
+	else if (fixedPointBits > 0)
+		scanDSegments<int32_t, int64_t>(reader, ldexp((long double) 1, fixedPointBits), scores);
+	else switch (scorePrecision) {
+	case FLOAT_SCORES:
+		scanDSegments<float, float>(reader, 1, scores);
+		break;
+	case DOUBLE_SCORES:
+		scanDSegments<double, double>(reader, 1, scores);
+		break;
+	default:
+		scanDSegments<long double, long double>(reader, 1, scores);
+		break;
+	}
+
+	// A stopped scan reports the segments found so far without the work
+	// that follows the scan
+	segmentPValues.clear();
+	annotationOffsets.clear();
+	annotationIntervals.clear();
+	if (scanStopped()) {
+		delete scoreIndex;
+		scoreIndex = NULL;
+		return;
+	}
+
+	if (significanceSimulations > 0 && shard == NULL)
+		testSignificance(scores);
+
+	if (!annotationFileNames.empty())
+		annotateSegments();
+
+	if (scoreIndex != NULL)
+		writeScoreIndex(scores);
+
+	if (coverageStatistics != NULL && !coverageWindowFileName.empty())
+		coverageStatistics->writeWindows(coverageWindowFileName);
+}
+
+// bool scanStopped()
+//  Purpose:
+//		Returns true if the progress stopped the last scan before the
+//		end of its input
+bool DSegmentsFinder::scanStopped() {
+	return progress != NULL && progress->status() != SCAN_COMPLETE;
+}
 
-	ifstream inputFile(cnvFileName);
-	string line;
+// calibrateThreshold()
+//  Purpose:
+//		Calibrates the threshold on simulated normal sequence when
+//		calibration is on
+//	Postconditions:
+//		threshold, calibrationMegabases, calibrationCached - set
+void DSegmentsFinder::calibrateThreshold() {
+	if (calibrationRate > 0) {
+		ThresholdCalibrator calibrator(probabilities);
+		threshold = calibrator.calibrate(calibrationRate, calibrationMegabases, calibrationSeed, calibrationCacheFileName);
+		calibrationMegabases = calibrator.simulatedMegabases;
+		calibrationCached = calibrator.cached;
+	}
+}
+
+// setFixedPointScoring(int fractionalBits)
+//  Purpose: 
+//		Switches the scan to fixed-point integer scoring.  Passing 0 switches
+//		back to floating point scoring.
+//	Postconditions:
+//		fixedPointBits - set to fractionalBits
+void DSegmentsFinder::setFixedPointScoring(int fractionalBits) {
+	if (fractionalBits < 0 || fractionalBits > 30)
+		throw invalid_argument("fixed-point fractional bits must be between 0 and 30");
+	fixedPointBits = fractionalBits;
+}
+
+// setScorePrecision(ScorePrecision precision)
+//  Purpose: 
+//		Sets the floating point precision used to score and accumulate
+//		the scan when fixed-point scoring is not in use
+//	Postconditions:
+//		scorePrecision - set to precision
+void DSegmentsFinder::setScorePrecision(ScorePrecision precision) {
+	scorePrecision = precision;
+}
+
+// setPrecisionValidation(bool validate)
+//  Purpose: 
+//		When validate is true a long double reference scan is run
+//		alongside the selected precision and any segment calls that
+//		differ between the two are reported with the results
+//	Postconditions:
+//		validatePrecision - set to validate
+void DSegmentsFinder::setPrecisionValidation(bool validate) {
+	validatePrecision = validate;
+}
+
+// setSegmentEngine(SegmentEngine engine, bool compare)
+//  Purpose: 
+//		Finds the segments with engine, and runs the other engine
+//		alongside to report the differences when compare is true
+//	Postconditions:
+//		segmentEngine, compareEngines - set
+void DSegmentsFinder::setSegmentEngine(SegmentEngine engine, bool compare) {
+	segmentEngine = engine;
+	compareEngines = compare;
+}
+
+// setParserThreads(int threads)
+//  Purpose: 
+//		Sets the number of threads used to parse the counts file
+//	Postconditions:
+//		parserThreads - set to threads
+void DSegmentsFinder::setParserThreads(int threads) {
+	parserThreads = threads;
+}
+
+// setAsyncReads(bool async)
+//  Purpose: 
+//		When async is true the counts file is read with several io_uring
+//		reads in flight (pread is used if io_uring is unavailable)
+//	Postconditions:
+//		asyncReads - set to async
+void DSegmentsFinder::setAsyncReads(bool async) {
+	asyncReads = async;
+}
+
+// setSignificanceTesting(int simulations, NullModel model, uint64_t seed)
+//  Purpose: 
+//		Assigns each D-Segment an empirical p-value from the maximum
+//		segment scores of simulations null sequences as long as the
+//		scanned sequence.  Passing 0 simulations turns testing off.
+//	Postconditions:
+//		significanceSimulations, nullModel, significanceSeed - set
+void DSegmentsFinder::setSignificanceTesting(int simulations, NullModel model, uint64_t seed) {
+	significanceSimulations = simulations;
+	nullModel = model;
+	significanceSeed = seed;
+}
+
+// setThresholdCalibration(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName)
+//  Purpose: 
+//		Replaces the transition probability threshold with one calibrated
+//		on at least megabases of simulated normal state sequence to give
+//		falseSegmentsPerMegabase.  Calibrations are cached in
+//		cacheFileName (no cache if empty).  A rate of 0 turns
+//		calibration off.
+//	Postconditions:
+//		calibrationRate, calibrationMegabases, calibrationSeed,
+//		calibrationCacheFileName - set
+void DSegmentsFinder::setThresholdCalibration(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName) {
+	calibrationRate = falseSegmentsPerMegabase;
+	calibrationMegabases = megabases;
+	calibrationSeed = seed;
+	calibrationCacheFileName = cacheFileName;
+}
+
+// setCoverageStatistics(int windowSize, string windowFileName)
+//  Purpose: 
+//		Accumulates per chromosome and per window read start statistics
+//		during the scan.  The window statistics are written to
+//		windowFileName (not written if empty).  A windowSize of 0 turns
+//		the statistics off.
+//	Postconditions:
+//		coverageWindowSize, coverageWindowFileName - set
+void DSegmentsFinder::setCoverageStatistics(int windowSize, string windowFileName) {
+	coverageWindowSize = windowSize;
+	coverageWindowFileName = windowFileName;
+}
+
+// setPairedNormal(string normalFileName, double normalSampleMean)
+//  Purpose: 
+//		Scores the sequence as a tumor against the matched normal counts
+//		in normalFileName, read in the same pass.  An empty file name
+//		turns paired mode off.
+//	Postconditions:
+//		pairedNormalFileName, pairedNormalMean - set
+void DSegmentsFinder::setPairedNormal(string normalFileName, double normalSampleMean) {
+	pairedNormalFileName = normalFileName;
+	pairedNormalMean = normalSampleMean;
+}
+
+// setWeightTrack(string weightTrackFileName)
+//  Purpose: 
+//		Corrects the scores for read start bias with the binary weight
+//		track in weightTrackFileName, joined to the counts as they are
+//		scanned.  An empty file name turns the correction off.
+//	Postconditions:
+//		weightTrackFileName - set
+void DSegmentsFinder::setWeightTrack(string weightTrackFileName) {
+	this->weightTrackFileName = weightTrackFileName;
+}
+
+// setShardRange(string chromosome, long long start, long long end, int leadInPositions)
+//  Purpose: 
+//		Scans only the positions start to end of chromosome as one shard
+//		of a sequence split across runs.  An empty chromosome turns
+//		sharding off.
+//	Postconditions:
+//		shardChromosome, shardStart, shardEnd, shardLeadIn - set
+void DSegmentsFinder::setShardRange(string chromosome, long long start, long long end, int leadInPositions) {
+	shardChromosome = chromosome;
+	shardStart = start;
+	shardEnd = end;
+	shardLeadIn = leadInPositions;
+}
+
+// writeShard(string shardFileName)
+//  Purpose: 
+//		Writes the shard found by the last findDSegments to
+//		shardFileName
+void DSegmentsFinder::writeShard(string shardFileName) {
+	if (shard == NULL)
+		throw logic_error("no shard has been scanned");
+	shard->write(shardFileName);
+}
 
-	// Current segment read start counts vector
-	int currentSegmentReadStartCounts[4];
+// mergeShards(const vector<string>& shardFileNames)
+//  Purpose: 
+//		Merges the shards in shardFileNames, in sequence order, into the
+//		segments and read start counts a serial scan of the whole
+//		sequence finds
+//	Postconditions:
+//		segments, threshold, read start counts - set
+void DSegmentsFinder::mergeShards(const vector<string>& shardFileNames) {
+	if (!annotationFileNames.empty())
+		throw invalid_argument("annotation runs on whole scans, not merged shards");
+	if (compactSegments)
+		throw invalid_argument("compact segments are kept for whole scans, not merged shards");
+	vector<ShardFile> shards(shardFileNames.size());
+	for (size_t i = 0; i < shards.size(); i++) {
+		shards[i].read(shardFileNames[i]);
+		if (shards[i].scorePrecision != shards[0].scorePrecision
+			|| shards[i].fixedPointBits != shards[0].fixedPointBits
+			|| shards[i].threshold != shards[0].threshold
+			|| shards[i].scores != shards[0].scores
+			|| shards[i].scores.size() < 4)
+			throw runtime_error(shardFileNames[i] + " was scanned with a different model than " + shardFileNames[0]);
+	}
+	if (shards.empty())
+		return;
+
+	// Merge in the precision the shards were scanned in
+	fixedPointBits = shards[0].fixedPointBits;
+	scorePrecision = (ScorePrecision) shards[0].scorePrecision;
+	threshold = shards[0].threshold;
+	if (significanceSimulations > 0 && shards[0].scores.size() != 4)
+		throw invalid_argument("significance is tested for unweighted gains only, without weights or losses");
+	if (fixedPointBits > 0)
+		mergeShardFiles<int32_t, int64_t>(shards);
+	else switch (scorePrecision) {
+	case FLOAT_SCORES:
+		mergeShardFiles<float, float>(shards);
+		break;
+	case DOUBLE_SCORES:
+		mergeShardFiles<double, double>(shards);
+		break;
+	default:
+		mergeShardFiles<long double, long double>(shards);
+		break;
+	}
+
+	if (significanceSimulations > 0) {
+		long double scores[4];
+		probabilities->dSegmentScoreTable(scores);
+		testSignificance(scores);
+	}
+}
+
+// setBinnedScan(int binSize, double binThreshold, int paddingBins, bool verify)
+//  Purpose: 
+//		Finds the D-Segments coarse to fine, scanning position by position
+//		only inside padded candidate regions found by a scan of bins of
+//		binSize positions.  A negative binThreshold is half the threshold.
+//		A binSize of 0 turns binning off.
+//	Postconditions:
+//		binSize, binThreshold, binPadding, verifyBins - set
+void DSegmentsFinder::setBinnedScan(int binSize, double binThreshold, int paddingBins, bool verify) {
+	if (binSize < 0 || paddingBins < 0)
+		throw invalid_argument("bin size and padding must not be negative");
+	this->binSize = binSize;
+	this->binThreshold = binThreshold;
+	binPadding = paddingBins;
+	verifyBins = verify;
+}
+
+// setJointSamples(const vector<string>& sampleFileNames)
+//  Purpose: 
+//		Segments the sequence jointly with the samples in
+//		sampleFileNames, read in lockstep in the same pass.  An empty list
+//		turns joint mode off.
+//	Postconditions:
+//		jointSampleFileNames - set
+void DSegmentsFinder::setJointSamples(const vector<string>& sampleFileNames) {
+	jointSampleFileNames = sampleFileNames;
+}
+
+// setResultCache(string cacheDirectory)
+//  Purpose: 
+//		Keeps the scan of each chromosome in cacheDirectory (see
+//		ResultCache.h) and reuses the scans of unchanged chromosomes.  An
+//		empty directory turns the cache off.
+//	Postconditions:
+//		resultCacheDirectory - set
+void DSegmentsFinder::setResultCache(string cacheDirectory) {
+	resultCacheDirectory = cacheDirectory;
+}
+
+// setScoreIndex(string indexFileName)
+//  Purpose: 
+//		Writes the score track of the scan to indexFileName as a score
+//		index.  An empty file name turns the index off.
+//	Postconditions:
+//		scoreIndexFileName - set
+void DSegmentsFinder::setScoreIndex(string indexFileName) {
+	scoreIndexFileName = indexFileName;
+	scoreIndexInput = false;
+}
+
+// setAnnotations(const vector<string>& bedFileNames)
+//  Purpose: 
+//		Annotates each segment with the intervals of the BED files in
+//		bedFileNames that overlap it.  An empty list turns annotation off.
+//	Postconditions:
+//		annotationFileNames - set
+void DSegmentsFinder::setAnnotations(const vector<string>& bedFileNames) {
+	annotationFileNames = bedFileNames;
+}
+
+// setProgress(ScanProgress* scanProgress)
+//  Purpose: 
+//		Follows the scans with scanProgress (see ScanProgress.h), which
+//		can stop them early.  A stopped scan keeps the segments found so
+//		far; a cached scan keeps the chromosomes read whole.  NULL turns
+//		this off.
+//	Postconditions:
+//		progress - set
+void DSegmentsFinder::setProgress(ScanProgress* scanProgress) {
+	progress = scanProgress;
+}
+
+// setSegmentStore(bool compact, string spillDirectory, long long memoryLimit)
+//  Purpose: 
+//		Keeps the segments of single sample scans and score indexes in
+//		SegmentStores in place of vectors.  With a spill directory the
+//		stores move their blocks beyond memoryLimit bytes to temporary
+//		files there.
+//	Postconditions:
+//		compactSegments, segmentSpillDirectory, segmentMemoryLimit - set
+void DSegmentsFinder::setSegmentStore(bool compact, string spillDirectory, long long memoryLimit) {
+	compactSegments = compact;
+	segmentSpillDirectory = spillDirectory;
+	segmentMemoryLimit = memoryLimit;
+}
+
+// Number scaleScore(long double score, long double scale)
+//  Purpose:
+//		Returns score in the Number type.  Integer types hold score * scale
+//		rounded to the nearest integer.
+template <typename Number>
+static Number scaleScore(long double score, long double scale) {
+	if (!numeric_limits<Number>::is_integer)
+		return (Number) score;
+
+	long double scaled = roundl(score * scale);
+	if (scaled > numeric_limits<Number>::max() || scaled < numeric_limits<Number>::min())
+		throw overflow_error("D-Segment score does not fit in fixed-point format");
+	return (Number) scaled;
+}
+
+// scanDSegments(CountsReader& reader, long double scale, const long double referenceScores[4])
+//  Purpose:
+//		Scans the counts from reader for D-Segments, scoring in the Score
+//		type and accumulating in the Sum type.  Integer scores are the
+//		scores times scale.  When scanning for losses a second scanner
+//		runs over the same positions with the reduced state scores.  When
+//		precision validation is on a long double scanner using
+//		referenceScores is run alongside and the segments are compared.
+//		With a weight track the scores are looked up by weight class
+//		and read starts.
+template <typename Score, typename Sum>
+void DSegmentsFinder::scanDSegments(CountsReader& reader, long double scale, const long double referenceScores[4]) {
+
+	Score scores[4];
 	for (int i = 0; i < 4; i++)
-		currentSegmentReadStartCounts[i] = 0;
-
-	long double cum = 0;
-	long double max = 0;
-	int start = 1;
-	int end = 1;
-	int position, readStarts;
-	while(getline(inputFile, line)) {
-
-		//  Split the line into tokens to get the positon and readStarts
-		vector<string> tokens;
-		StringUtilities::split(line, '\t', tokens);
-		position = atoi(tokens[1].c_str());
-		readStarts = atoi(tokens[2].c_str());
-
-		// Set read starts to 3 if greater than 3
-		if (readStarts > 3)
-			readStarts = 3;
-	
-		// Increment read start counts and temp counts;
-		readStartCounts[readStarts]++;
-		currentSegmentReadStartCounts[readStarts]++;
-
-		// Add the score to the cumulative score
-		cum += probabilities->dSegmentScore(readStarts);
-
-		// Keep track of maximum score to this point
-		if (cum >= max) {
-			max = cum;
-			end = position;
-		}
-
-		// Check if over threshold
-		if (cum <= 0 || cum <= max - threshold) {
-			if (max >= threshold) {
-				// Create segment and add to segments collection
-				Segment segment;
-				segment.start = start;
-				segment.end = end;
-				segment.score = max;
-				segments.push_back(segment); 
-
-				// Add current segment counts to d-segment counts
-				for (int i = 0; i < 4; i++)
-					dSegmentReadStartCounts[i]+=currentSegmentReadStartCounts[i];
+		scores[i] = scaleScore<Score>(referenceScores[i], scale);
+	DSegmentScanner<Score, Sum> scanner(scores, scaleScore<Sum>(threshold, scale), scale);
+
+	DSegmentScanner<Score, Sum>* lossScanner = NULL;
+	if (probabilities->hasReducedState()) {
+		Score lossScores[4];
+		for (int i = 0; i < 4; i++)
+			lossScores[i] = scaleScore<Score>(probabilities->dSegmentScore(3, i), scale);
+		lossScanner = new DSegmentScanner<Score, Sum>(lossScores, scaleScore<Sum>(lossThreshold, scale), scale);
+	}
+
+	// Compact segments go straight to the stores
+	if (compactSegments) {
+		segmentStore.clear();
+		segmentStore.setSpill(segmentSpillDirectory, segmentMemoryLimit);
+		scanner.setSegmentStore(&segmentStore);
+		lossSegmentStore.clear();
+		lossSegmentStore.setSpill(segmentSpillDirectory, segmentMemoryLimit);
+		if (lossScanner != NULL)
+			lossScanner->setSegmentStore(&lossSegmentStore);
+	}
+
+	DSegmentScanner<long double, long double>* reference = NULL;
+	if (validatePrecision)
+		reference = new DSegmentScanner<long double, long double>(referenceScores, threshold, 1);
+
+	// The maximal subsequence engine runs in place of the reset scan, or
+	// alongside it when comparing the two
+	bool resetScan = segmentEngine == RESET_SCAN_ENGINE || compareEngines;
+	MaximalSubsequenceScanner<Score, Sum>* maximal = NULL;
+	if (segmentEngine == MAXIMAL_SUBSEQUENCE_ENGINE || compareEngines)
+		maximal = new MaximalSubsequenceScanner<Score, Sum>(scores, scaleScore<Sum>(threshold, scale), scale);
+
+	// Scores by weight class and read starts.  The track's bytes are not
+	// checked, so there is a row for every byte: the classes from
+	// numClasses - 1 on are positions without a weight
+	int numClasses = weightTrack != NULL ? weightTrack->numClasses() + 1 : 0;
+	int tableClasses = weightTrack != NULL ? 256 : 0;
+	vector<Score> weightedScores(tableClasses * 4);
+	vector<Score> weightedLossScores(tableClasses * 4);
+	vector<long double> weightedReferenceScores(tableClasses * 4);
+	for (int c = 0; c < tableClasses; c++) {
+		double weight = weightTrack->classWeight(c);
+		for (int i = 0; i < 4; i++) {
+			weightedReferenceScores[c * 4 + i] = probabilities->weightedDSegmentScore(2, weight, i);
+			weightedScores[c * 4 + i] = scaleScore<Score>(weightedReferenceScores[c * 4 + i], scale);
+			if (lossScanner != NULL)
+				weightedLossScores[c * 4 + i] =
+					scaleScore<Score>(probabilities->weightedDSegmentScore(3, weight, i), scale);
+		}
+	}
+	weightedPositions = 0;
+	unweightedPositions = 0;
+
+	CountsBatch* batch;
+	while ((batch = reader.nextBatch()) != NULL) {
+		const long long* positions = batch->positions.data();
+		const unsigned char* codes = batch->readStarts.data();
+		const unsigned short* rawCodes = batch->rawReadStarts.data();
+		size_t numRecords = batch->positions.size();
+
+		// Scan a chromosome run at a time
+		for (size_t r = 0; r < batch->chromosomes.size(); r++) {
+			size_t first = batch->chromosomes[r].firstRecord;
+			size_t last = r + 1 < batch->chromosomes.size() ? batch->chromosomes[r + 1].firstRecord : numRecords;
+
+			// Keep only the shard's positions
+			if (shard != NULL) {
+				if (batch->chromosomes[r].name != shardChromosome)
+					continue;
+				first = lower_bound(positions + first, positions + last, shardStart) - positions;
+				last = upper_bound(positions + first, positions + last, shardEnd) - positions;
+				shard->records += last - first;
 			}
 
-			// Reset values
-			cum = 0;
-			max = 0;
-			start = position + 1;
-			end = position + 1;
+			// Number the run's chromosome for the segments
+			const string& chromosome = batch->chromosomes[r].name;
+			if (scannedChromosomes.empty() || scannedChromosomes.back() != chromosome) {
+				scannedChromosomes.push_back(chromosome);
+				scanner.setChromosome(scannedChromosomes.size() - 1);
+				if (maximal != NULL)
+					maximal->setChromosome(scannedChromosomes.size() - 1);
+			}
+
+			// Join the weight classes of the run's chromosome
+			long long trackStart = 0;
+			long long trackLength = 0;
+			const unsigned char* classes = NULL;
+			if (weightTrack != NULL)
+				classes = weightTrack->chromosomeClasses(batch->chromosomes[r].name, trackStart, trackLength);
+
+			// Keep the shard's lead-in
+			if (shard != NULL) {
+				for (size_t i = first; i < last && (int) shard->leadInIndices.size() < shardLeadIn; i++) {
+					int index = codes[i];
+					if (weightTrack != NULL) {
+						unsigned long long offset = (unsigned long long) (positions[i] - trackStart);
+						int weightClass = offset < (unsigned long long) trackLength ? classes[offset] : numClasses - 1;
+						index += min(weightClass, numClasses - 1) * 4;
+					}
+					shard->leadInPositions.push_back(positions[i]);
+					shard->leadInIndices.push_back(index);
+					shard->leadInReadStarts.push_back(rawCodes[i]);
+				}
+			}
+
+			if (scoreIndex != NULL)
+				scoreIndex->addRecords(positions + first, rawCodes + first, last - first);
+
+			if (weightTrack == NULL) {
+				for (size_t i = first; i < last; i++) {
+					// Increment read start counts and scan the position
+					readStartCounts[codes[i]]++;
+					if (resetScan)
+						scanner.addPosition(positions[i], codes[i], rawCodes[i]);
+					if (maximal != NULL)
+						maximal->addPosition(positions[i], codes[i], rawCodes[i]);
+					if (lossScanner != NULL)
+						lossScanner->addPosition(positions[i], codes[i], rawCodes[i]);
+					if (reference != NULL)
+						reference->addPosition(positions[i], codes[i], rawCodes[i]);
+				}
+			}
+			else {
+				for (size_t i = first; i < last; i++) {
+					unsigned long long offset = (unsigned long long) (positions[i] - trackStart);
+					int weightClass = numClasses - 1;
+					if (offset < (unsigned long long) trackLength)
+						weightClass = classes[offset];
+					if (weightClass >= numClasses - 1)
+						unweightedPositions++;
+					else
+						weightedPositions++;
+
+					int index = weightClass * 4 + codes[i];
+					readStartCounts[codes[i]]++;
+					if (resetScan)
+						scanner.addScore(positions[i], codes[i], rawCodes[i], weightedScores[index]);
+					if (maximal != NULL)
+						maximal->addScore(positions[i], codes[i], rawCodes[i], weightedScores[index]);
+					if (lossScanner != NULL)
+						lossScanner->addScore(positions[i], codes[i], rawCodes[i], weightedLossScores[index]);
+					if (reference != NULL)
+						reference->addScore(positions[i], codes[i], rawCodes[i], weightedReferenceScores[index]);
+				}
+			}
+
+			// Accumulate the coverage statistics
+			if (coverageStatistics != NULL) {
+				coverageStatistics->startChromosome(batch->chromosomes[r].name);
+				coverageStatistics->addPositions(positions + first, batch->rawReadStarts.data() + first, last - first);
+			}
+		}
+
+		reader.releaseBatch(batch);
+	}
+
+	// Check if last segment is a D-Segment, a shard leaves it open for
+	// the merge
+	if (shard == NULL)
+		scanner.finish();
+	segments = scanner.segments;
+	for (int i = 0; i < 4; i++)
+		dSegmentReadStartCounts[i] = scanner.dSegmentReadStartCounts[i];
+
+	if (maximal != NULL) {
+		maximal->finish();
+		if (compareEngines)
+			compareEngineSegments(scanner.segments, maximal->segments);
+		if (segmentEngine == MAXIMAL_SUBSEQUENCE_ENGINE) {
+			segments = maximal->segments;
 			for (int i = 0; i < 4; i++)
-				currentSegmentReadStartCounts[i] = 0;
+				dSegmentReadStartCounts[i] = maximal->dSegmentReadStartCounts[i];
+		}
+		delete maximal;
+	}
+
+	if (shard != NULL) {
+		shard->scorePrecision = scorePrecision;
+		shard->fixedPointBits = fixedPointBits;
+		shard->threshold = threshold;
+		shard->scale = scale;
+		if (weightTrack == NULL)
+			shard->scores.assign(scores, scores + 4);
+		else
+			shard->scores.assign(weightedScores.begin(), weightedScores.begin() + numClasses * 4);
+		for (int i = 0; i < 4; i++) {
+			shard->readStartCounts[i] = readStartCounts[i];
+			shard->segmentReadStartCounts[i] = dSegmentReadStartCounts[i];
 		}
+		shard->segments = segments;
+		shard->endState = scanner.state();
+	}
+
+	if (lossScanner != NULL) {
+		lossScanner->finish();
+		lossSegments = lossScanner->segments;
+		for (int i = 0; i < 4; i++)
+			lossReadStartCounts[i] = lossScanner->dSegmentReadStartCounts[i];
+		delete lossScanner;
+	}
+
+	// Compare to the reference scan
+	if (reference != NULL) {
+		reference->finish();
+		compareToReference(reference->segments);
+		delete reference;
+	}
+}
+
+// scanBinnedDSegments(CountsReader& reader, const long double scores[4])
+//  Purpose:
+//		Scans the counts from reader coarse to fine.  Positions since
+//		the bin scan last reset are buffered so a candidate can be
+//		scanned position by position as soon as the bin scan finds it.
+//		One fine scan runs through all the candidates in order, taking
+//		each record at most once.
+//	Postconditions:
+//		segments, read start counts, binCandidates,
+//		binScannedPositions - set
+void DSegmentsFinder::scanBinnedDSegments(CountsReader& reader, const long double scores[4]) {
+
+	// Bins are scanned as positions numbered by bin, bin b holding
+	// records b * binSize to (b + 1) * binSize - 1
+	if (binThreshold < 0)
+		binThreshold = threshold / 2;
+	DSegmentScanner<long double, long double> binScanner(scores, binThreshold, 1);
+	DSegmentScanner<long double, long double>* full = NULL;
+	if (verifyBins)
+		full = new DSegmentScanner<long double, long double>(scores, threshold, 1);
+
+	// Records from record bufferFirst on, those before bufferFirst +
+	// bufferStart are no longer needed
+	vector<long long> bufferPositions;
+	vector<unsigned char> bufferCodes;
+	vector<unsigned short> bufferReadStarts;
+	long long bufferFirst = 0;
+	size_t bufferStart = 0;
+
+	// Padded candidate regions, as first and last bins, from the one
+	// being scanned on
+	vector<pair<long long, long long> > windows;
+	size_t windowsStart = 0;
+
+	// The fine scan runs on from window to window, so a segment spanning
+	// windows is found whole, and past a window's end until its open
+	// segment resets.  scanRecord is the next record it takes.
+	DSegmentScanner<long double, long double> scanner(scores, threshold, 1);
+	long long scanRecord = 0;
+
+	long long records = 0;
+	long long bin = 0;
+	int binRecords = 0;
+	long double binScore = 0;
+	size_t candidatesSeen = 0;
+	segments.clear();
+	binCandidates = 0;
+	binScannedPositions = 0;
+
+	CountsBatch* batch;
+	bool last = false;
+	while (!last) {
+		batch = reader.nextBatch();
+		last = batch == NULL;
+		size_t numRecords = last ? 0 : batch->positions.size();
+
+		// At the end of the counts one pass closes the last bin
+		for (size_t i = 0; i < numRecords || last; i++) {
+			if (!last) {
+				int code = batch->readStarts[i];
+				readStartCounts[code]++;
+				bufferPositions.push_back(batch->positions[i]);
+				bufferCodes.push_back(code);
+				bufferReadStarts.push_back(batch->rawReadStarts[i]);
+				if (full != NULL)
+					full->addPosition(batch->positions[i], code, batch->rawReadStarts[i]);
+				records++;
+				binScore += scores[code];
+				if (++binRecords < binSize)
+					continue;
+			}
+
+			// Scan the bin and pad any new candidates, joining those that
+			// touch the window not yet scanned past
+			if (binRecords > 0) {
+				binScanner.addScore(bin, 0, 0, binScore);
+				bin++;
+				binRecords = 0;
+				binScore = 0;
+			}
+			if (last)
+				binScanner.finish();
+			for (; candidatesSeen < binScanner.segments.size(); candidatesSeen++) {
+				long long first = binScanner.segments[candidatesSeen].start - binPadding;
+				long long end = binScanner.segments[candidatesSeen].end + binPadding;
+				if (first < 0)
+					first = 0;
+				if (windowsStart < windows.size() && first <= windows.back().second + 1)
+					windows.back().second = end > windows.back().second ? end : windows.back().second;
+				else {
+					windows.push_back(make_pair(first, end));
+					binCandidates++;
+				}
+			}
+
+			// Scan the records read in the windows and after a window
+			// while the fine scan's segment is open
+			while (scanRecord < records) {
+				bool open = scanner.segmentOpen();
+				if (windowsStart < windows.size()) {
+					long long firstRecord = windows[windowsStart].first * binSize;
+					long long endRecord = (windows[windowsStart].second + 1) * binSize;
+					if (!open && scanRecord >= endRecord) {
+						windowsStart++;
+						continue;
+					}
+					if (!open && scanRecord < firstRecord) {
+						scanRecord = firstRecord;
+						continue;
+					}
+				}
+				else if (!open)
+					break;
+
+				size_t j = scanRecord - bufferFirst;
+				scanner.addPosition(bufferPositions[j], bufferCodes[j], bufferReadStarts[j]);
+				binScannedPositions++;
+				scanRecord++;
+			}
+
+			// Keep the records a future candidate could need, from the
+			// padding before the open bin segment, and those the fine
+			// scan has still to take
+			DSegmentScanState binState = binScanner.state();
+			long long keepBin = binState.startPending ? bin : binState.start;
+			long long keepRecord = (keepBin - binPadding) * binSize;
+			if ((windowsStart < windows.size() || scanner.segmentOpen()) && scanRecord < keepRecord)
+				keepRecord = scanRecord;
+			if (keepRecord > bufferFirst + (long long) bufferStart)
+				bufferStart = keepRecord < records ? keepRecord - bufferFirst : records - bufferFirst;
+
+			// Drop the records no longer needed
+			if (bufferStart > 65536 && bufferStart * 2 > bufferPositions.size()) {
+				bufferPositions.erase(bufferPositions.begin(), bufferPositions.begin() + bufferStart);
+				bufferCodes.erase(bufferCodes.begin(), bufferCodes.begin() + bufferStart);
+				bufferReadStarts.erase(bufferReadStarts.begin(), bufferReadStarts.begin() + bufferStart);
+				bufferFirst += bufferStart;
+				bufferStart = 0;
+			}
+
+			if (last)
+				break;
+		}
+
+		if (!last)
+			reader.releaseBatch(batch);
+	}
+
+	scanner.finish();
+	segments = scanner.segments;
+	for (int i = 0; i < 4; i++)
+		dSegmentReadStartCounts[i] = scanner.dSegmentReadStartCounts[i];
+
+	// Compare to the full scan
+	if (full != NULL) {
+		full->finish();
+		compareToReference(full->segments);
+		delete full;
+	}
+}
+
+// bool scanPairedDSegments(CountsReader& tumorReader, CountsReader& normalReader, vector<string>& tumorChromosomes, bool tumorChromosomesKnown)
+//  Purpose:
+//		Scans the tumor counts for D-Segments, joining each tumor
+//		position to the normal's record for the same chromosome and
+//		position.  Positions missing from the normal score the
+//		transitions only.  Both files must list the chromosomes they
+//		share in the same order; either may have chromosomes the other
+//		lacks.
+//
+//		The tumor's chromosomes are set in tumorChromosomes.  Until
+//		they are known the join can not tell a normal chromosome the
+//		tumor lacks from one it has later, so it waits for the tumor.
+//		If the normal then goes on to a chromosome the tumor has
+//		finished, the join returns false to be run again with
+//		tumorChromosomesKnown, which skips the normal chromosomes the
+//		tumor lacks.  Throws runtime_error if the chromosomes are still
+//		out of order.
+//	Postconditions:
+//		segments, read start counts and paired record counts - set
+bool DSegmentsFinder::scanPairedDSegments(CountsReader& tumorReader, CountsReader& normalReader,
+	vector<string>& tumorChromosomes, bool tumorChromosomesKnown) {
+
+	// Scores by normal read starts (4 for a missing normal record) and
+	// tumor read starts
+	long double pairedScores[5][4];
+	for (int n = 0; n < 5; n++)
+		for (int t = 0; t < 4; t++)
+			pairedScores[n][t] = probabilities->pairedDSegmentScore(n, t, pairedNormalMean);
+	DSegmentScanner<long double, long double> scanner(pairedScores[4], threshold, 1);
+
+	for (int i = 0; i < 4; i++)
+		readStartCounts[i] = 0;
+	pairedMatchedRecords = 0;
+	pairedTumorOnlyRecords = 0;
+	pairedNormalOnlyRecords = 0;
+
+	// Both files list positions in increasing order within a chromosome.
+	// The tumor's chromosome order drives the join, normal records on a
+	// chromosome the tumor has finished with (or never has) are skipped.
+	CountsCursor tumor(&tumorReader);
+	CountsCursor normal(&normalReader);
+	vector<string> finishedChromosomes;
+	string chromosome;
+	string normalChromosome;
+	if (!tumorChromosomesKnown)
+		tumorChromosomes.clear();
+	while (true) {
+		bool tumorValid = tumor.valid();
+		if (tumorValid && tumor.chromosome() != chromosome) {
+			if (!chromosome.empty())
+				finishedChromosomes.push_back(chromosome);
+			chromosome = tumor.chromosome();
+			if (!tumorChromosomesKnown)
+				tumorChromosomes.push_back(chromosome);
+		}
+		long long position = tumorValid ? tumor.position() : 0;
+
+		// Skip normal records behind the tumor, whatever is left of the
+		// normal once the tumor ends
+		while (normal.valid()) {
+			if (normal.chromosome() != normalChromosome) {
+				normalChromosome = normal.chromosome();
+
+				// The normal coming back to a chromosome the tumor has
+				// finished was waiting on one the tumor lacks, or lists
+				// the chromosomes in another order
+				if (find(finishedChromosomes.begin(), finishedChromosomes.end(), normalChromosome)
+					!= finishedChromosomes.end()) {
+					if (!tumorChromosomesKnown)
+						return false;
+					throw runtime_error("the tumor and normal counts files list chromosome "
+						+ normalChromosome + " in a different order");
+				}
+			}
+			if (tumorValid) {
+				if (normal.chromosome() == chromosome) {
+					if (normal.position() >= position)
+						break;
+				}
+				else if (find(finishedChromosomes.begin(), finishedChromosomes.end(), normal.chromosome())
+						== finishedChromosomes.end()
+					&& (!tumorChromosomesKnown
+						|| find(tumorChromosomes.begin(), tumorChromosomes.end(), normal.chromosome())
+							!= tumorChromosomes.end()))
+					break;
+			}
+			pairedNormalOnlyRecords++;
+			normal.advance();
+		}
+		if (!tumorValid)
+			break;
+
+		int normalReadStarts = 4;
+		if (normal.valid() && normal.chromosome() == chromosome && normal.position() == position) {
+			normalReadStarts = normal.readStarts();
+			pairedMatchedRecords++;
+			normal.advance();
+		}
+		else
+			pairedTumorOnlyRecords++;
+
+		int readStarts = tumor.readStarts();
+		readStartCounts[readStarts]++;
+		scanner.addScore(position, readStarts, tumor.rawReadStarts(), pairedScores[normalReadStarts][readStarts]);
+		tumor.advance();
+	}
+
+	// Check if last segment is a D-Segment
+	scanner.finish();
+	segments = scanner.segments;
+	for (int i = 0; i < 4; i++)
+		dSegmentReadStartCounts[i] = scanner.dSegmentReadStartCounts[i];
+	return true;
+}
+
+// Number of positions kept at the start of a cached chromosome so it
+// can be merged exactly
+static const int CACHE_LEAD_IN = 100000;
+
+// findCachedDSegments(string cnvFileName)
+//  Purpose:
+//		Finds the DSegments for the sequence in cnvFileName, scanning only
+//		the chromosomes missing from the result cache and merging the
+//		cached scans of the others.  The whole file is scanned if its
+//		chromosomes are split up or the cached scans can not be merged
+//		exactly.
+//	Postconditions:
+//		segments, read start counts, resultCacheHits, resultCacheMisses,
+//		resultCacheFullScan - set
+void DSegmentsFinder::findCachedDSegments(string cnvFileName) {
+	if (probabilities->hasReducedState() || validatePrecision || !pairedNormalFileName.empty()
+		|| !weightTrackFileName.empty() || !shardChromosome.empty() || binSize > 0
+		|| !jointSampleFileNames.empty() || coverageWindowSize > 0)
+		throw invalid_argument("cached scans find gains only, without a normal, weights, shards, bins, joint samples, coverage or precision validation");
+
+	calibrateThreshold();
+	long double scores[4];
+	probabilities->dSegmentScoreTable(scores);
+
+	// Everything the scan of a chromosome depends on
+	stringstream key;
+	key << hexfloat << "cnv_shard 1";
+	for (int i = 0; i < 4; i++)
+		key << "," << scores[i];
+	key << "," << threshold << "," << scorePrecision << "," << fixedPointBits;
+	ResultCache cache(resultCacheDirectory, key.str());
+
+	resultCacheHits = 0;
+	resultCacheMisses = 0;
+	resultCacheFullScan = false;
+	vector<CountsChromosome> chromosomes;
+	bool together = ResultCache::hashChromosomes(cnvFileName, chromosomes);
+
+	// Scan the chromosomes missing from the cache in one pass
+	vector<ShardFile> missing;
+	vector<size_t> missingChromosomes;
+	for (size_t i = 0; i < chromosomes.size() && together; i++) {
+		if (cache.contains(chromosomes[i])) {
+			resultCacheHits++;
+			continue;
+		}
+		ShardFile shard;
+		shard.chromosome = chromosomes[i].name;
+		shard.end = numeric_limits<long long>::max();
+		missing.push_back(shard);
+		missingChromosomes.push_back(i);
+	}
+	resultCacheMisses = missing.size();
+	if (!missing.empty()) {
+		CountsReader reader(cnvFileName, parserThreads, asyncReads);
+		reader.setProgress(progress);
+		if (fixedPointBits > 0)
+			scanChromosomeShards<int32_t, int64_t>(reader, ldexp((long double) 1, fixedPointBits), scores, missing);
+		else switch (scorePrecision) {
+		case FLOAT_SCORES:
+			scanChromosomeShards<float, float>(reader, 1, scores, missing);
+			break;
+		case DOUBLE_SCORES:
+			scanChromosomeShards<double, double>(reader, 1, scores, missing);
+			break;
+		default:
+			scanChromosomeShards<long double, long double>(reader, 1, scores, missing);
+			break;
+		}
+		for (size_t i = 0; i < missing.size(); i++)
+			if (progress == NULL || progress->chromosomeComplete(missing[i].chromosome))
+				cache.store(chromosomes[missingChromosomes[i]], missing[i]);
+	}
+
+	// A stopped scan keeps the chromosomes before the first it did not
+	// read whole
+	bool stopped = progress != NULL && progress->status() != SCAN_COMPLETE;
+	if (together) {
+		vector<string> entryFileNames;
+		for (size_t i = 0; i < chromosomes.size(); i++) {
+			if (stopped && !cache.contains(chromosomes[i]))
+				break;
+			entryFileNames.push_back(cache.entryFileName(chromosomes[i]));
+		}
+		try {
+			if (!stopped || !entryFileNames.empty())
+				mergeShards(entryFileNames);
+			return;
+		}
+		catch (runtime_error&) {
+			// Fall through to the full scan
+		}
+	}
+	if (stopped)
+		return;
+
+	resultCacheFullScan = true;
+	for (int i = 0; i < 4; i++)
+		readStartCounts[i] = 0;
+	CountsReader reader(cnvFileName, parserThreads, asyncReads);
+	reader.setProgress(progress);
+	findDSegments(reader);
+}
+
+// scanChromosomeShards(CountsReader& reader, long double scale, const long double referenceScores[4], vector<ShardFile>& shards)
+//  Purpose:
+//		Scans each chromosome named by shards as a shard of the whole
+//		chromosome, scoring in the Score type and accumulating in the Sum
+//		type.  Chromosomes not in shards are skipped.
+//	Postconditions:
+//		shards - filled in
+template <typename Score, typename Sum>
+void DSegmentsFinder::scanChromosomeShards(CountsReader& reader, long double scale, const long double referenceScores[4], vector<ShardFile>& shards) {
+	Score scores[4];
+	for (int i = 0; i < 4; i++)
+		scores[i] = scaleScore<Score>(referenceScores[i], scale);
+	Sum scanThreshold = scaleScore<Sum>(threshold, scale);
+	vector<DSegmentScanner<Score, Sum>*> scanners(shards.size(), NULL);
+
+	size_t current = 0;
+	CountsBatch* batch;
+	while ((batch = reader.nextBatch()) != NULL) {
+		const long long* positions = batch->positions.data();
+		const unsigned char* codes = batch->readStarts.data();
+		const unsigned short* rawCodes = batch->rawReadStarts.data();
+		size_t numRecords = batch->positions.size();
+
+		for (size_t r = 0; r < batch->chromosomes.size(); r++) {
+			size_t first = batch->chromosomes[r].firstRecord;
+			size_t last = r + 1 < batch->chromosomes.size() ? batch->chromosomes[r + 1].firstRecord : numRecords;
+
+			// Find the run's shard
+			const string& name = batch->chromosomes[r].name;
+			if (current == shards.size() || shards[current].chromosome != name) {
+				current = 0;
+				while (current < shards.size() && shards[current].chromosome != name)
+					current++;
+				if (current == shards.size())
+					continue;
+			}
+			ShardFile& shard = shards[current];
+			if (scanners[current] == NULL)
+				scanners[current] = new DSegmentScanner<Score, Sum>(scores, scanThreshold, scale);
+			DSegmentScanner<Score, Sum>* scanner = scanners[current];
+
+			shard.records += last - first;
+			for (size_t i = first; i < last && shard.leadInIndices.size() < (size_t) CACHE_LEAD_IN; i++) {
+				shard.leadInPositions.push_back(positions[i]);
+				shard.leadInIndices.push_back(codes[i]);
+				shard.leadInReadStarts.push_back(rawCodes[i]);
+			}
+			for (size_t i = first; i < last; i++) {
+				shard.readStartCounts[codes[i]]++;
+				scanner->addPosition(positions[i], codes[i], rawCodes[i]);
+			}
+		}
+
+		reader.releaseBatch(batch);
+	}
+
+	// The open segment at the end of each chromosome is left for the
+	// merge
+	for (size_t k = 0; k < shards.size(); k++) {
+		ShardFile& shard = shards[k];
+		shard.scorePrecision = scorePrecision;
+		shard.fixedPointBits = fixedPointBits;
+		shard.threshold = threshold;
+		shard.scale = scale;
+		shard.scores.assign(scores, scores + 4);
+		if (scanners[k] == NULL)
+			continue;
+		for (int i = 0; i < 4; i++)
+			shard.segmentReadStartCounts[i] = scanners[k]->dSegmentReadStartCounts[i];
+		shard.segments = scanners[k]->segments;
+		shard.endState = scanners[k]->state();
+		delete scanners[k];
+	}
+}
+
+// Number of joined positions gathered before the lanes step through them
+static const int JOINT_BLOCK = 4096;
+
+// scanJointDSegments(vector<CountsReader*>& readers)
+//  Purpose:
+//		Scans the samples read by readers jointly, joining their records
+//		on chromosome and position.  Blocks of positions are gathered
+//		with the samples' codes interleaved, then the summed track and
+//		the sample lanes step through the block.  A sample without a
+//		record at a position scores 0 there.  Joint segments do not span
+//		chromosomes so their support can be counted a chromosome at a
+//		time.  The summed track's threshold is the threshold times the
+//		number of samples, and its segments count the records of every
+//		sample.
+//	Postconditions:
+//		segments, jointSampleSegments, jointSupport, jointPositions,
+//		jointThreshold and read start counts (over all samples) - set
+void DSegmentsFinder::scanJointDSegments(vector<CountsReader*>& readers) {
+	int numSamples = readers.size();
+
+	// Scores by code, code 4 for no record
+	long double scores[4];
+	probabilities->dSegmentScoreTable(scores);
+	double sampleScores[5];
+	for (int i = 0; i < 4; i++)
+		sampleScores[i] = (double) scores[i];
+	sampleScores[4] = 0;
+
+	// Each sample's scores carry the transitions, so the summed track is
+	// the log odds of every sample changing state together and its
+	// threshold is the cost of that, the single sample threshold per
+	// sample
+	jointThreshold = threshold * numSamples;
+
+	DSegmentLanes lanes(numSamples, scores, threshold);
+	segments.clear();
+	jointSupport.clear();
+	jointPositions = 0;
+	for (int i = 0; i < 4; i++)
+		dSegmentReadStartCounts[i] = 0;
+
+	vector<CountsCursor*> cursors;
+	for (int s = 0; s < numSamples; s++)
+		cursors.push_back(new CountsCursor(readers[s]));
+
+	// Position of each sample's next record on the current chromosome,
+	// INT_MAX once the sample has none left there
+	vector<long long> nextPositions(numSamples);
+
+	vector<long long> blockPositions(JOINT_BLOCK);
+	vector<unsigned char> blockCodes(JOINT_BLOCK * numSamples);
+	vector<unsigned short> blockReadStarts(JOINT_BLOCK * numSamples);
+
+	// The samples list positions in increasing order within a chromosome.
+	// Chromosomes are taken in the order the first sample with records
+	// left lists them, records on a finished chromosome are skipped.
+	vector<string> finishedChromosomes;
+	while (true) {
+		string chromosome;
+		for (int s = 0; s < numSamples; s++) {
+			CountsCursor* cursor = cursors[s];
+			while (cursor->valid() && find(finishedChromosomes.begin(), finishedChromosomes.end(),
+				cursor->chromosome()) != finishedChromosomes.end())
+				cursor->advance();
+			if (chromosome.empty() && cursor->valid())
+				chromosome = cursor->chromosome();
+		}
+		if (chromosome.empty())
+			break;
+		for (int s = 0; s < numSamples; s++)
+			nextPositions[s] = cursors[s]->valid() && cursors[s]->chromosome() == chromosome
+				? cursors[s]->position() : numeric_limits<long long>::max();
+
+		// The summed track counts the records of every sample present
+		DSegmentScanner<double, double> summed(sampleScores, jointThreshold, 1);
+		vector<size_t> firstSampleSegments(numSamples);
+		for (int s = 0; s < numSamples; s++)
+			firstSampleSegments[s] = lanes.segments[s].size();
+
+		bool chromosomeDone = false;
+		while (!chromosomeDone) {
+
+			// Gather a block
+			int block = 0;
+			for (; block < JOINT_BLOCK; block++) {
+				long long position = *min_element(nextPositions.begin(), nextPositions.end());
+				if (position == numeric_limits<long long>::max()) {
+					chromosomeDone = true;
+					break;
+				}
+
+				blockPositions[block] = position;
+				unsigned char* codes = &blockCodes[block * numSamples];
+				unsigned short* readStarts = &blockReadStarts[block * numSamples];
+				for (int s = 0; s < numSamples; s++) {
+					if (nextPositions[s] != position) {
+						codes[s] = 4;
+						readStarts[s] = 0;
+						continue;
+					}
+
+					CountsCursor* cursor = cursors[s];
+					codes[s] = cursor->readStarts();
+					readStarts[s] = min(cursor->rawReadStarts(), (int) numeric_limits<unsigned short>::max());
+					readStartCounts[codes[s]]++;
+					if (!cursor->advance())
+						nextPositions[s] = cursor->position();
+					else
+						nextPositions[s] = cursor->valid() && cursor->chromosome() == chromosome
+							? cursor->position() : numeric_limits<long long>::max();
+				}
+			}
+
+			// Step the lanes and the summed track through the block
+			for (int b = 0; b < block; b++) {
+				const unsigned char* codes = &blockCodes[b * numSamples];
+				const unsigned short* readStarts = &blockReadStarts[b * numSamples];
+				lanes.addPosition(blockPositions[b], codes);
+
+				double score = 0;
+				int codeCounts[5] = {0, 0, 0, 0, 0};
+				int readStartSum = 0;
+				for (int s = 0; s < numSamples; s++) {
+					score += sampleScores[codes[s]];
+					codeCounts[codes[s]]++;
+					readStartSum += readStarts[s];
+				}
+				summed.addRecordsScore(blockPositions[b], codeCounts, readStartSum, score);
+			}
+			jointPositions += block;
+		}
+
+		// Check if last segments are D-Segments
+		summed.finish();
+		lanes.finish();
+		finishedChromosomes.push_back(chromosome);
+
+		// Count the samples with a segment overlapping each joint segment,
+		// both lists are in position order
+		size_t firstSegment = segments.size();
+		segments.insert(segments.end(), summed.segments.begin(), summed.segments.end());
+		jointSupport.resize(segments.size(), 0);
+		for (int i = 0; i < 4; i++)
+			dSegmentReadStartCounts[i] += summed.dSegmentReadStartCounts[i];
+		for (int s = 0; s < numSamples; s++) {
+			const vector<Segment>& sampleSegments = lanes.segments[s];
+			size_t j = firstSampleSegments[s];
+			for (size_t i = firstSegment; i < segments.size(); i++) {
+				while (j < sampleSegments.size() && sampleSegments[j].end < segments[i].start)
+					j++;
+				if (j < sampleSegments.size() && sampleSegments[j].start <= segments[i].end)
+					jointSupport[i]++;
+			}
+		}
+	}
+
+	for (int s = 0; s < numSamples; s++)
+		delete cursors[s];
+	jointSampleSegments = lanes.segments;
+}
+
+// bool sameScanState(const DSegmentScanState& a, const DSegmentScanState& b)
+//  Purpose:
+//		Returns true if two scans in states a and b go on identically
+static bool sameScanState(const DSegmentScanState& a, const DSegmentScanState& b) {
+	if (a.cum != b.cum || a.max != b.max || a.start != b.start || a.end != b.end
+		|| a.startPending != b.startPending
+		|| a.readStartSum != b.readStartSum || a.pendingReadStartSum != b.pendingReadStartSum)
+		return false;
+	for (int i = 0; i < 4; i++)
+		if (a.readStartCounts[i] != b.readStartCounts[i]
+			|| a.pendingReadStartCounts[i] != b.pendingReadStartCounts[i])
+			return false;
+	return true;
+}
+
+// mergeShardFiles(vector<ShardFile>& shards)
+//  Purpose:
+//		Merges shards, scoring in the Score type and accumulating in the
+//		Sum type they were scanned with
+template <typename Score, typename Sum>
+void DSegmentsFinder::mergeShardFiles(vector<ShardFile>& shards) {
+	vector<Score> scores(shards[0].scores.size());
+	for (size_t i = 0; i < scores.size(); i++)
+		scores[i] = (Score) shards[0].scores[i];
+	long double scale = shards[0].scale;
+	Sum shardThreshold = scaleScore<Sum>(shards[0].threshold, scale);
+
+	// The serial scan, carried from shard to shard
+	DSegmentScanner<Score, Sum> serial(scores.data(), shardThreshold, scale);
+	for (int i = 0; i < 4; i++)
+		readStartCounts[i] = 0;
+
+	for (size_t k = 0; k < shards.size(); k++) {
+		ShardFile& shard = shards[k];
+		for (int i = 0; i < 4; i++)
+			readStartCounts[i] += shard.readStartCounts[i];
+
+		// Replay the lead-in from the serial state and from the shard's
+		// empty state until the two scans meet
+		DSegmentScanner<Score, Sum> alone(scores.data(), shardThreshold, scale);
+		size_t replayed = 0;
+		bool met = sameScanState(serial.state(), alone.state());
+		while (!met && replayed < shard.leadInIndices.size()) {
+			int index = shard.leadInIndices[replayed];
+			long long position = shard.leadInPositions[replayed];
+			int rawReadStarts = shard.leadInReadStarts[replayed];
+			if (index < 0 || index >= (int) scores.size())
+				throw runtime_error("bad score index in shard lead-in");
+			serial.addScore(position, index % 4, rawReadStarts, scores[index]);
+			alone.addScore(position, index % 4, rawReadStarts, scores[index]);
+			replayed++;
+			met = sameScanState(serial.state(), alone.state());
+		}
+
+		// A shard the lead-in covers is fully replayed
+		if (!met) {
+			if ((long long) replayed < shard.records) {
+				stringstream message;
+				message << "shard " << shard.chromosome << ":" << shard.start << "-" << shard.end
+					<< " needs a lead-in longer than " << replayed << " positions to merge exactly";
+				throw runtime_error(message.str());
+			}
+			continue;
+		}
+
+		// From here the shard's own scan is the serial scan
+		for (size_t i = alone.segments.size(); i < shard.segments.size(); i++)
+			serial.segments.push_back(shard.segments[i]);
+		for (int i = 0; i < 4; i++)
+			serial.dSegmentReadStartCounts[i] +=
+				shard.segmentReadStartCounts[i] - alone.dSegmentReadStartCounts[i];
+		serial.setState(shard.endState);
 	}
 
 	// Check if last segment is a D-Segment
-	if (max >= threshold) {
-		// Create segment and add to segments collection
-		Segment segment;
-		segment.start = start;
-		segment.end = end;
-		segment.score = max;
-		segments.push_back(segment); 
-
-		// Add current segment counts to d-segment counts
+	serial.finish();
+	segments = serial.segments;
+	for (int i = 0; i < 4; i++)
+		dSegmentReadStartCounts[i] = serial.dSegmentReadStartCounts[i];
+}
+
+// Fractional bits of a score index built from a floating point scan
+static const int SCORE_INDEX_BITS = 24;
+
+// writeScoreIndex(const long double scores[4])
+//  Purpose:
+//		Summarizes the score track kept by the scan in the scan's
+//		fixed-point scores, or with SCORE_INDEX_BITS fractional bits, and
+//		writes the index
+void DSegmentsFinder::writeScoreIndex(const long double scores[4]) {
+	int bits = fixedPointBits > 0 ? fixedPointBits : SCORE_INDEX_BITS;
+	int32_t indexScores[4];
+	for (int i = 0; i < 4; i++)
+		indexScores[i] = scaleScore<int32_t>(scores[i], ldexp((long double) 1, bits));
+	scoreIndex->build(indexScores, bits);
+	scoreIndex->write(scoreIndexFileName);
+}
+
+// findDSegmentsFromScoreIndex(string indexFileName, double indexThreshold)
+//  Purpose: 
+//		Finds the DSegments from the score index in indexFileName at
+//		indexThreshold or, if it is not positive, at the threshold of the
+//		model
+//	Postconditions:
+//		segments, threshold, fixedPointBits, read start counts - set
+void DSegmentsFinder::findDSegmentsFromScoreIndex(string indexFileName, double indexThreshold) {
+	if (!annotationFileNames.empty())
+		throw invalid_argument("annotation runs on whole scans, not score indexes");
+	delete scoreIndex;
+	scoreIndex = new ScoreIndex();
+	scoreIndex->read(indexFileName);
+	scoreIndexFileName = indexFileName;
+	scoreIndexInput = true;
+
+	// The model's threshold only applies to the scores it was built for
+	long double scores[4];
+	probabilities->dSegmentScoreTable(scores);
+	long double scale = ldexp((long double) 1, scoreIndex->fractionalBits);
+	if (indexThreshold > 0)
+		threshold = indexThreshold;
+	else {
 		for (int i = 0; i < 4; i++)
-			dSegmentReadStartCounts[i]+=currentSegmentReadStartCounts[i];
+			if (scaleScore<int32_t>(scores[i], scale) != scoreIndex->scores[i])
+				throw runtime_error(indexFileName + " was built with a different model");
+		calibrateThreshold();
+	}
+
+	fixedPointBits = scoreIndex->fractionalBits;
+	for (int i = 0; i < 4; i++) {
+		readStartCounts[i] = scoreIndex->readStartCounts[i];
+		dSegmentReadStartCounts[i] = 0;
+	}
+	if (compactSegments) {
+		if (significanceSimulations > 0)
+			throw invalid_argument("compact segments are kept without significance");
+		segmentStore.clear();
+		segmentStore.setSpill(segmentSpillDirectory, segmentMemoryLimit);
+		scoreIndex->findSegments(scaleScore<int64_t>(threshold, scale), segmentStore);
+		for (size_t k = 0; k < segmentStore.size(); k++) {
+			Segment segment = segmentStore[k];
+			for (int i = 0; i < 4; i++)
+				dSegmentReadStartCounts[i] += segment.readStartCounts[i];
+		}
+		return;
+	}
+	scoreIndex->findSegments(scaleScore<int64_t>(threshold, scale), segments);
+	for (size_t k = 0; k < segments.size(); k++)
+		for (int i = 0; i < 4; i++)
+			dSegmentReadStartCounts[i] += segments[k].readStartCounts[i];
+
+	if (significanceSimulations > 0)
+		testSignificance(scores);
+}
+
+// compareToReference(const vector<Segment>& referenceSegments)
+//  Purpose:
+//		Records the segments that differ between the scan and the
+//		long double reference scan
+//	Postconditions:
+//		referenceOnlySegments, scanOnlySegments, maxScoreDivergence - set
+void DSegmentsFinder::compareToReference(const vector<Segment>& referenceSegments) {
+	referenceOnlySegments.clear();
+	scanOnlySegments.clear();
+	maxScoreDivergence = 0;
+
+	// Both lists are in position order so walk them together
+	size_t i = 0;
+	size_t j = 0;
+	while (i < segments.size() || j < referenceSegments.size()) {
+		if (j == referenceSegments.size()
+			|| (i < segments.size() && segments[i].start < referenceSegments[j].start)) {
+			scanOnlySegments.push_back(segments[i++]);
+		}
+		else if (i == segments.size() || referenceSegments[j].start < segments[i].start) {
+			referenceOnlySegments.push_back(referenceSegments[j++]);
+		}
+		else if (segments[i].end != referenceSegments[j].end) {
+			scanOnlySegments.push_back(segments[i++]);
+			referenceOnlySegments.push_back(referenceSegments[j++]);
+		}
+		else {
+			long double difference = fabsl(segments[i++].score - referenceSegments[j++].score);
+			if (difference > maxScoreDivergence)
+				maxScoreDivergence = difference;
+		}
+	}
+}
+
+// annotateSegments()
+//  Purpose:
+//		Finds the intervals of each annotation file overlapping each
+//		segment, on the chromosome of the segment's end
+//	Postconditions:
+//		annotationOffsets, annotationIntervals - set
+void DSegmentsFinder::annotateSegments() {
+	annotationOffsets.assign(annotationIndexes.size(), vector<int>());
+	annotationIntervals.assign(annotationIndexes.size(), vector<int>());
+	for (size_t f = 0; f < annotationIndexes.size(); f++) {
+		vector<int>& offsets = annotationOffsets[f];
+		vector<int>& intervals = annotationIntervals[f];
+		offsets.reserve(segments.size() + 1);
+		offsets.push_back(0);
+		for (size_t k = 0; k < segments.size(); k++) {
+			if (segments[k].chromosome >= 0)
+				annotationIndexes[f]->overlaps(scannedChromosomes[segments[k].chromosome],
+					segments[k].start, segments[k].end, intervals);
+			offsets.push_back(intervals.size());
+		}
 	}
+}
+
+// compareEngineSegments(const vector<Segment>& resetSegments, const vector<Segment>& maximalSegments)
+//  Purpose:
+//		Records the segments that differ between the reset scan and the
+//		maximal subsequence engine, a segment is shared if both found it
+//		with the same start and end
+//	Postconditions:
+//		maximalOnlySegments, resetOnlySegments, sharedEngineSegments - set
+void DSegmentsFinder::compareEngineSegments(const vector<Segment>& resetSegments, const vector<Segment>& maximalSegments) {
+	maximalOnlySegments.clear();
+	resetOnlySegments.clear();
+	sharedEngineSegments = 0;
 
+	// Both lists are in position order so walk them together
+	size_t i = 0;
+	size_t j = 0;
+	while (i < resetSegments.size() || j < maximalSegments.size()) {
+		if (j == maximalSegments.size()
+			|| (i < resetSegments.size() && resetSegments[i].start < maximalSegments[j].start)) {
+			resetOnlySegments.push_back(resetSegments[i++]);
+		}
+		else if (i == resetSegments.size() || maximalSegments[j].start < resetSegments[i].start) {
+			maximalOnlySegments.push_back(maximalSegments[j++]);
+		}
+		else if (resetSegments[i].end != maximalSegments[j].end) {
+			resetOnlySegments.push_back(resetSegments[i++]);
+			maximalOnlySegments.push_back(maximalSegments[j++]);
+		}
+		else {
+			sharedEngineSegments++;
+			i++;
+			j++;
+		}
+	}
 }
 
 // string results()
@@ -136,9 +1706,22 @@ void DSegmentsFinder::findDSegments(string cnvFileName) {
 //			<result type="viterbi_iteration" iteration="<< iteration >>">
 //				<<probabilitiesResultsString>>
 //				<<thresholdResultsString>>
+//				<<scoreQuantizationResultsString>>
+//				<<pairedNormalResultsString>>
+//				<<weightTrackResultsString>>
+//				<<binnedScanResultsString>>
+//				<<jointResultsString>>
+//				<<resultCacheResultsString>>
 //				<<segmentsResultsString>>
+//				<<segmentStatisticsResultsString>>
+//				<<annotationResultsString>>
+//				<<lossSegmentsResultsString>>
+//				<<precisionValidationResultsString>>
+//				<<significanceResultsString>>
+//				<<coverageStatisticsResultsString>>
 //				<<readStartCountsAllResultsString>>
 //				<<readStartCountsDSegmentsResultsString>>
+//				<<readStartCountsLossSegmentsResultsString>>
 //			</result>
 string DSegmentsFinder::results() {
 	stringstream ss;
@@ -150,9 +1733,28 @@ string DSegmentsFinder::results() {
 	ss 
 		<< probabilitiesResultsString()
 		<< thresholdResultsString()
+		<< scoreQuantizationResultsString()
+		<< pairedNormalResultsString()
+		<< weightTrackResultsString()
+		<< binnedScanResultsString()
+		<< jointResultsString()
+		<< resultCacheResultsString()
+		<< scoreIndexResultsString()
+		<< segmentEngineResultsString()
+		<< scanProgressResultsString()
+		<< segmentStoreResultsString()
 		<< segmentsResultsString()
+		<< (compactSegments
+			? segmentStatisticsResultsString(segmentStore, "segment_statistics")
+			: segmentStatisticsResultsString(segments, "segment_statistics"))
+		<< annotationResultsString()
+		<< lossSegmentsResultsString()
+		<< precisionValidationResultsString()
+		<< significanceResultsString()
+		<< coverageStatisticsResultsString()
 		<< readStartCountsAllResultsString()
-		<< readStartCountsDSegmentsResultsString();
+		<< readStartCountsDSegmentsResultsString()
+		<< readStartCountsLossSegmentsResultsString();
 
 	// Footer
 	ss << "  </results>\n";
@@ -160,6 +1762,302 @@ string DSegmentsFinder::results() {
 	return ss.str();
 }
 
+// string pairedNormalResultsString()
+//  Purpose:
+//		Returns a string representing how the tumor and normal records
+//		were joined (empty when not in paired mode)
+//
+//		format:
+//			<paired_normal file="<<file>>" normal_mean="<<mean>>" matched="<<count>>" tumor_only="<<count>>" normal_only="<<count>>"/>
+string DSegmentsFinder::pairedNormalResultsString() {
+	if (pairedNormalFileName.empty())
+		return "";
+
+	stringstream ss;
+	ss << "    <paired_normal file=\"" << pairedNormalFileName
+		<< "\" normal_mean=\"" << pairedNormalMean
+		<< "\" matched=\"" << pairedMatchedRecords
+		<< "\" tumor_only=\"" << pairedTumorOnlyRecords
+		<< "\" normal_only=\"" << pairedNormalOnlyRecords
+		<< "\"/>\n";
+	return ss.str();
+}
+
+// string weightTrackResultsString()
+//  Purpose:
+//		Returns a string representing the weight track used to correct
+//		the scores (empty when not correcting)
+//
+//		format:
+//			<weight_track file="<<file>>" classes="<<count>>" weighted="<<count>>" unweighted="<<count>>"/>
+string DSegmentsFinder::weightTrackResultsString() {
+	if (weightTrack == NULL)
+		return "";
+
+	stringstream ss;
+	ss << "    <weight_track file=\"" << weightTrackFileName
+		<< "\" classes=\"" << weightTrack->numClasses()
+		<< "\" weighted=\"" << weightedPositions
+		<< "\" unweighted=\"" << unweightedPositions
+		<< "\"/>\n";
+	return ss.str();
+}
+
+// string jointResultsString()
+//  Purpose:
+//		Returns a string representing the joint segments with their
+//		support and each sample's own segments (empty when not in joint
+//		mode)
+//
+//		format:
+//			<joint samples="<<count>>" positions="<<count>>" threshold="<<threshold>>"/>
+//			<result type="joint_segment_list">
+//				(<<start>>,<<end>>,<<score>>,<<support>>),...
+//			</result>
+//			<result type="sample_segment_list" file="<<file>>">
+//				(<<start>>,<<end>>,<<score>>),...
+//			</result>
+//			...
+string DSegmentsFinder::jointResultsString() {
+	if (jointSampleFileNames.empty())
+		return "";
+
+	stringstream ss;
+	ss << "    <joint samples=\"" << jointSampleSegments.size()
+		<< "\" positions=\"" << jointPositions
+		<< "\" threshold=\"" << jointThreshold
+		<< "\"/>\n";
+
+	stringstream joint;
+	for (size_t i = 0; i < segments.size(); i++) {
+		if (i > 0)
+			joint << ",";
+		joint << "(" << segments[i].start << "," << segments[i].end << ","
+			<< floor(segments[i].score * 10 + .05) / 10 << "," << jointSupport[i] << ")";
+		if ((i + 1) % 5 == 0)
+			joint << "\n";
+	}
+	ss << StringUtilities::xmlResult("joint_segment_list", joint.str());
+
+	for (size_t s = 0; s < jointSampleSegments.size(); s++) {
+		const vector<Segment>& sampleSegments = jointSampleSegments[s];
+		ss << "    <result type=\"sample_segment_list\" file=\""
+			<< (s == 0 ? jointCountsFileName : jointSampleFileNames[s - 1]) << "\">";
+		for (size_t i = 0; i < sampleSegments.size(); i++) {
+			if (i > 0)
+				ss << ",";
+			ss << "(" << sampleSegments[i].start << "," << sampleSegments[i].end << ","
+				<< floor(sampleSegments[i].score * 10 + .05) / 10 << ")";
+			if ((i + 1) % 5 == 0)
+				ss << "\n";
+		}
+		ss << "</result>\n";
+	}
+	return ss.str();
+}
+
+// string resultCacheResultsString()
+//  Purpose:
+//		Returns a string representing how the result cache was used
+//		(empty when not caching)
+//
+//		format:
+//			<result_cache directory="<<directory>>" hits="<<count>>" misses="<<count>>" full_scan="<<true|false>>"/>
+string DSegmentsFinder::resultCacheResultsString() {
+	if (resultCacheDirectory.empty())
+		return "";
+
+	stringstream ss;
+	ss << "    <result_cache directory=\"" << resultCacheDirectory
+		<< "\" hits=\"" << resultCacheHits
+		<< "\" misses=\"" << resultCacheMisses
+		<< "\" full_scan=\"" << (resultCacheFullScan ? "true" : "false")
+		<< "\"/>\n";
+	return ss.str();
+}
+
+// string annotationResultsString()
+//  Purpose:
+//		Returns a string representing the intervals of each annotation
+//		file overlapping each segment (empty when not annotating)
+//
+//		format:
+//			<result type="segment_annotation" file="<<file>>" intervals="<<count>>">
+//				(<<chromosome>>,<<start>>,<<end>>,<<overlaps>>,<<name>>;<<name>>;...),...
+//			</result>
+//			...
+string DSegmentsFinder::annotationResultsString() {
+	stringstream ss;
+	for (size_t f = 0; f < annotationOffsets.size(); f++) {
+		const vector<int>& offsets = annotationOffsets[f];
+		const vector<int>& intervals = annotationIntervals[f];
+
+		// Header
+		ss
+			<< "    <result type=\"segment_annotation\" file=\"" << annotationIndexes[f]->fileName
+			<< "\" intervals=\"" << annotationIndexes[f]->numIntervals() << "\">";
+
+		// Results
+		for (size_t k = 0; k + 1 < offsets.size(); k++) {
+			if (k > 0)
+				ss << ",";
+			ss
+				<< "(" << (segments[k].chromosome >= 0 ? scannedChromosomes[segments[k].chromosome] : "")
+				<< "," << segments[k].start
+				<< "," << segments[k].end
+				<< "," << offsets[k + 1] - offsets[k]
+				<< ",";
+			for (int i = offsets[k]; i < offsets[k + 1]; i++) {
+				if (i > offsets[k])
+					ss << ";";
+				ss << annotationIndexes[f]->intervalName(intervals[i]);
+			}
+			ss << ")";
+		}
+
+		// Footer
+		ss << "</result>\n";
+	}
+	return ss.str();
+}
+
+// string segmentEngineResultsString()
+//  Purpose:
+//		Returns a string representing the segment engine and the
+//		segments only one engine found when comparing (empty for the
+//		reset scan alone)
+//
+//		format:
+//			<segment_engine engine="<<reset|maximal>>" [shared="<<count>>" maximal_only="<<count>>" reset_only="<<count>>"]>
+//				(start,end,score,maximal|reset),...
+//			</segment_engine>
+string DSegmentsFinder::segmentEngineResultsString() {
+	if (segmentEngine == RESET_SCAN_ENGINE && !compareEngines)
+		return "";
+
+	stringstream ss;
+
+	// Header
+	ss << "    <segment_engine engine=\"" << (segmentEngine == RESET_SCAN_ENGINE ? "reset" : "maximal") << "\"";
+	if (compareEngines)
+		ss
+			<< " shared=\"" << sharedEngineSegments
+			<< "\" maximal_only=\"" << maximalOnlySegments.size()
+			<< "\" reset_only=\"" << resetOnlySegments.size() << "\"";
+	ss << ">";
+
+	// Results
+	for (size_t i = 0; i < maximalOnlySegments.size(); i++)
+		ss
+			<< "(" << maximalOnlySegments[i].start
+			<< "," << maximalOnlySegments[i].end
+			<< "," << (double) maximalOnlySegments[i].score
+			<< ",maximal)";
+	for (size_t i = 0; i < resetOnlySegments.size(); i++)
+		ss
+			<< "(" << resetOnlySegments[i].start
+			<< "," << resetOnlySegments[i].end
+			<< "," << (double) resetOnlySegments[i].score
+			<< ",reset)";
+
+	// Footer
+	ss << "</segment_engine>\n";
+
+	return ss.str();
+}
+
+// string scanProgressResultsString()
+//  Purpose:
+//		Returns a string representing how far the scan got (empty without
+//		progress or when it completed unwatched)
+//
+//		format:
+//			<<ScanProgress::resultsString>>
+string DSegmentsFinder::scanProgressResultsString() {
+	if (progress == NULL)
+		return "";
+
+	return progress->resultsString();
+}
+
+// string segmentStoreResultsString()
+//  Purpose:
+//		Returns a string representing the segment stores (empty when the
+//		segments are not compact)
+//
+//		format:
+//			<segment_store segments="<<count>>" loss_segments="<<count>>" memory_bytes="<<bytes>>" spilled_bytes="<<bytes>>"/>
+string DSegmentsFinder::segmentStoreResultsString() {
+	if (!compactSegments)
+		return "";
+
+	stringstream ss;
+	ss
+		<< "    <segment_store segments=\"" << segmentStore.size()
+		<< "\" loss_segments=\"" << lossSegmentStore.size()
+		<< "\" memory_bytes=\"" << segmentStore.memoryBytes() + lossSegmentStore.memoryBytes()
+		<< "\" spilled_bytes=\"" << segmentStore.spilledBytes() + lossSegmentStore.spilledBytes()
+		<< "\"/>\n";
+
+	return ss.str();
+}
+
+// string scoreIndexResultsString()
+//  Purpose:
+//		Returns a string representing the score index written by the
+//		scan or the segments were found from (empty when there is no
+//		index)
+//
+//		format:
+//			<score_index file="<<file>>" records="<<count>>" blocks="<<count>>" fractional_bits="<<bits>>" [skipped_blocks="<<count>>" scanned_blocks="<<count>>"]/>
+string DSegmentsFinder::scoreIndexResultsString() {
+	if (scoreIndex == NULL)
+		return "";
+
+	stringstream ss;
+	ss << "    <score_index file=\"" << scoreIndexFileName
+		<< "\" records=\"" << scoreIndex->positions.size()
+		<< "\" blocks=\"" << scoreIndex->blocks.size()
+		<< "\" fractional_bits=\"" << scoreIndex->fractionalBits;
+	if (scoreIndexInput)
+		ss
+			<< "\" skipped_blocks=\"" << scoreIndex->skippedBlocks
+			<< "\" scanned_blocks=\"" << scoreIndex->scannedBlocks;
+	ss << "\"/>\n";
+	return ss.str();
+}
+
+// string binnedScanResultsString()
+//  Purpose:
+//		Returns a string representing the coarse to fine scan, and how
+//		it compared to the full scan when verifying (empty when not
+//		binning)
+//
+//		format:
+//			<binned_scan bin_size="<<size>>" bin_threshold="<<threshold>>" padding_bins="<<bins>>" candidates="<<count>>" scanned_positions="<<count>>" positions="<<count>>" [verified="<<true|false>>" full_only="<<count>>" binned_only="<<count>>"]/>
+string DSegmentsFinder::binnedScanResultsString() {
+	if (binSize == 0)
+		return "";
+
+	long long positions = 0;
+	for (int i = 0; i < 4; i++)
+		positions += readStartCounts[i];
+
+	stringstream ss;
+	ss << "    <binned_scan bin_size=\"" << binSize
+		<< "\" bin_threshold=\"" << binThreshold
+		<< "\" padding_bins=\"" << binPadding
+		<< "\" candidates=\"" << binCandidates
+		<< "\" scanned_positions=\"" << binScannedPositions
+		<< "\" positions=\"" << positions << "\"";
+	if (verifyBins)
+		ss << " verified=\"" << (referenceOnlySegments.empty() && scanOnlySegments.empty() ? "true" : "false")
+			<< "\" full_only=\"" << referenceOnlySegments.size()
+			<< "\" binned_only=\"" << scanOnlySegments.size() << "\"";
+	ss << "/>\n";
+	return ss.str();
+}
+
 // string probabilitiesResultsString()
 //  Purpose:
 //		Returns a string representing the probabilites
@@ -177,12 +2075,14 @@ string DSegmentsFinder::probabilitiesResultsString() {
 
 // string thresholdResultsString()
 //  Purpose:
-//		Returns a string representing the threshold (S=-D)
+//		Returns a string representing the threshold (S=-D), and how it
+//		was calibrated if it was
 //
 //		format:
 //			<score_threshold>
 //				<<threshold>>,
 //			</score_threshold>
+//			<threshold_calibration false_segments_per_mb="<<rate>>" simulated_mb="<<megabases>>" cached="<<true|false>>"/>
 string DSegmentsFinder::thresholdResultsString() {
 	stringstream ss;
 	ss.scientific;
@@ -197,9 +2097,35 @@ string DSegmentsFinder::thresholdResultsString() {
 	// Footer
 	ss << "      </score_threshold>\n";
 
+	// Calibration
+	if (calibrationRate > 0)
+		ss
+			<< "      <threshold_calibration false_segments_per_mb=\"" << calibrationRate
+			<< "\" simulated_mb=\"" << calibrationMegabases
+			<< "\" cached=\"" << (calibrationCached ? "true" : "false") << "\"/>\n";
+
 	return ss.str();
 }
 
+// string scoreQuantizationResultsString()
+//  Purpose:
+//		Returns a string representing the fixed-point quantization used
+//		for the scores (empty when scoring in long double)
+//
+//		format:
+//			<score_quantization fractional_bits="<<bits>>" max_error_per_position="<<error>>"/>
+string DSegmentsFinder::scoreQuantizationResultsString() {
+	if (fixedPointBits == 0)
+		return "";
+
+	stringstream ss;
+	ss
+		<< "      <score_quantization fractional_bits=\"" << fixedPointBits
+		<< "\" max_error_per_position=\"" << ldexp(1.0, -(fixedPointBits + 1))
+		<< "\"/>\n";
+
+	return ss.str();
+}
 
 // string segmentsResultsString()
 //  Purpose:
@@ -210,11 +2136,22 @@ string DSegmentsFinder::thresholdResultsString() {
 //				(segment1start, segment1end, segement1Score),(segment2start, segment2end, segment2Score),...
 //			</result>
 string DSegmentsFinder::segmentsResultsString() {
+	if (compactSegments)
+		return segmentListResultsString(segmentStore);
+	return segmentListResultsString(segments);
+}
+
+// string segmentListResultsString(const Segments& segmentList)
+//  Purpose:
+//		Returns segmentsResultsString for segmentList, a vector of
+//		Segments or a SegmentStore
+template <typename Segments>
+string DSegmentsFinder::segmentListResultsString(const Segments& segmentList) {
 	stringstream ss;
 	
 	int counter = 0;
-	for (int i = 0; i < segments.size();  i++) {
-		Segment segment = segments[i];
+	for (size_t i = 0; i < segmentList.size(); i++) {
+		Segment segment = segmentList[i];
 
 		// Round score to one decimal place
 		double score = segment.score;
@@ -241,6 +2178,248 @@ string DSegmentsFinder::segmentsResultsString() {
 	return StringUtilities::xmlResult("segment_list", ss.str());
 }
 
+// testSignificance(const long double scores[4])
+//  Purpose:
+//		Simulates the null maximum score distribution and assigns each
+//		segment its p-value
+//	Postconditions:
+//		segmentPValues, nullMaxScore95 - set
+void DSegmentsFinder::testSignificance(const long double scores[4]) {
+	// Draw null codes from the observed frequencies or the normal state
+	long double codeProbabilities[4];
+	long long length = 0;
+	for (int i = 0; i < 4; i++) {
+		length += readStartCounts[i];
+		if (nullModel == HMM_NULL)
+			codeProbabilities[i] = probabilities->emissionProbability(1, to_string(i));
+		else
+			codeProbabilities[i] = readStartCounts[i];
+	}
+
+	segmentPValues.clear();
+	if (length == 0)
+		return;
+
+	NullSimulator simulator(scores, codeProbabilities);
+	simulator.simulateMaxScores(length, significanceSimulations, significanceSeed);
+	nullMaxScore95 = simulator.maxScoreQuantile(0.95);
+	for (size_t i = 0; i < segments.size(); i++)
+		segmentPValues.push_back(simulator.pValue(segments[i].score));
+}
+
+// string lossSegmentsResultsString()
+//  Purpose:
+//		Returns a string representing the loss threshold and segments
+//		(empty when not scanning for losses)
+//
+//		format:
+//			<loss_score_threshold><<lossThreshold>></loss_score_threshold>
+//			<result type="loss_segment_list">
+//				(segment1start, segment1end, segement1Score),(segment2start, segment2end, segment2Score),...
+//			</result>
+string DSegmentsFinder::lossSegmentsResultsString() {
+	if (!probabilities->hasReducedState())
+		return "";
+
+	stringstream thresholdString;
+	thresholdString << "      <loss_score_threshold>" << lossThreshold << "</loss_score_threshold>\n";
+
+	if (compactSegments)
+		return thresholdString.str() + lossSegmentListResultsString(lossSegmentStore);
+	return thresholdString.str() + lossSegmentListResultsString(lossSegments);
+}
+
+// string lossSegmentListResultsString(const Segments& segmentList)
+//  Purpose:
+//		Returns the loss segment list and statistics of
+//		lossSegmentsResultsString for segmentList, a vector of Segments or
+//		a SegmentStore
+template <typename Segments>
+string DSegmentsFinder::lossSegmentListResultsString(const Segments& segmentList) {
+	stringstream ss;
+	for (size_t i = 0; i < segmentList.size(); i++) {
+		Segment segment = segmentList[i];
+		if (i > 0)
+			ss << ",";
+		ss
+			<< "("
+			<< segment.start
+			<< ","
+			<< segment.end
+			<< ","
+			<< floor(segment.score * 10 + .05) / 10
+			<< ")";
+		if ((i + 1) % 5 == 0)
+			ss << "\n";
+	}
+
+	return StringUtilities::xmlResult("loss_segment_list", ss.str())
+		+ segmentStatisticsResultsString(segmentList, "loss_segment_statistics");
+}
+
+// string segmentStatisticsResultsString(const vector<Segment>& segmentList, string type)
+//  Purpose:
+//		Returns a string representing the statistics of each segment in
+//		segmentList, accumulated during the scan
+//
+//		format:
+//			<result type="<<type>>">
+//				(start,end,positions,meanReadStarts,scorePerPosition,count0/count1/count2/count3),...
+//			</result>
+string DSegmentsFinder::segmentStatisticsResultsString(const vector<Segment>& segmentList, string type) {
+	return segmentListStatisticsString(segmentList, type);
+}
+
+string DSegmentsFinder::segmentStatisticsResultsString(const SegmentStore& segmentList, string type) {
+	return segmentListStatisticsString(segmentList, type);
+}
+
+// string segmentListStatisticsString(const Segments& segmentList, string type)
+//  Purpose:
+//		Returns segmentStatisticsResultsString for segmentList, a vector of
+//		Segments or a SegmentStore
+template <typename Segments>
+string DSegmentsFinder::segmentListStatisticsString(const Segments& segmentList, string type) {
+	stringstream ss;
+	for (size_t i = 0; i < segmentList.size(); i++) {
+		const Segment segment = segmentList[i];
+		int positions = segment.positions();
+		if (i > 0)
+			ss << ",";
+		ss
+			<< "("
+			<< segment.start
+			<< ","
+			<< segment.end
+			<< ","
+			<< positions
+			<< ","
+			<< (positions > 0 ? (double) segment.readStartSum / positions : 0)
+			<< ","
+			<< (positions > 0 ? (double) segment.score / positions : 0)
+			<< ","
+			<< segment.readStartCounts[0] << "/" << segment.readStartCounts[1] << "/"
+			<< segment.readStartCounts[2] << "/" << segment.readStartCounts[3]
+			<< ")";
+		if ((i + 1) % 5 == 0)
+			ss << "\n";
+	}
+
+	return StringUtilities::xmlResult(type, ss.str());
+}
+
+// string scorePrecisionName()
+//  Purpose:
+//		Returns the name of the precision used for the scan
+string DSegmentsFinder::scorePrecisionName() {
+	if (fixedPointBits > 0)
+		return "fixed";
+
+	switch (scorePrecision) {
+	case FLOAT_SCORES:
+		return "float";
+	case DOUBLE_SCORES:
+		return "double";
+	default:
+		return "long double";
+	}
+}
+
+// string precisionValidationResultsString()
+//  Purpose:
+//		Returns a string representing the segment calls that differ
+//		from the long double reference (empty when not validating)
+//
+//		format:
+//			<precision_validation precision="<<precision>>" reference="long double" divergent_segments="<<count>>" max_score_difference="<<difference>>">
+//				(start,end,score,reference|scan),...
+//			</precision_validation>
+string DSegmentsFinder::precisionValidationResultsString() {
+	if (!validatePrecision)
+		return "";
+
+	stringstream ss;
+
+	// Header
+	ss
+		<< "    <precision_validation precision=\"" << scorePrecisionName()
+		<< "\" reference=\"long double\" divergent_segments=\""
+		<< referenceOnlySegments.size() + scanOnlySegments.size()
+		<< "\" max_score_difference=\"" << (double) maxScoreDivergence << "\">";
+
+	// Results
+	for (size_t i = 0; i < referenceOnlySegments.size(); i++)
+		ss
+			<< "(" << referenceOnlySegments[i].start
+			<< "," << referenceOnlySegments[i].end
+			<< "," << (double) referenceOnlySegments[i].score
+			<< ",reference)";
+	for (size_t i = 0; i < scanOnlySegments.size(); i++)
+		ss
+			<< "(" << scanOnlySegments[i].start
+			<< "," << scanOnlySegments[i].end
+			<< "," << (double) scanOnlySegments[i].score
+			<< ",scan)";
+
+	// Footer
+	ss << "</precision_validation>\n";
+
+	return ss.str();
+}
+
+// string significanceResultsString()
+//  Purpose:
+//		Returns a string representing the empirical p-value of each
+//		segment (empty when not testing significance)
+//
+//		format:
+//			<result type="segment_significance" null="<<model>>" simulations="<<count>>" null_max_95="<<score>>">
+//				(segment1start,segment1end,segment1PValue),...
+//			</result>
+string DSegmentsFinder::significanceResultsString() {
+	if (significanceSimulations == 0 || scanStopped())
+		return "";
+
+	stringstream ss;
+
+	// Header
+	ss
+		<< "    <result type=\"segment_significance\" null=\""
+		<< (nullModel == HMM_NULL ? "hmm" : "permuted")
+		<< "\" simulations=\"" << significanceSimulations
+		<< "\" null_max_95=\"" << nullMaxScore95 << "\">";
+
+	// Results
+	for (size_t i = 0; i < segmentPValues.size(); i++) {
+		ss
+			<< "("
+			<< segments[i].start
+			<< ","
+			<< segments[i].end
+			<< ","
+			<< segmentPValues[i]
+			<< ")";
+		if (i < segmentPValues.size() - 1)
+			ss << ",";
+	}
+
+	// Footer
+	ss << "</result>\n";
+
+	return ss.str();
+}
+
+// string coverageStatisticsResultsString()
+//  Purpose:
+//		Returns a string representing the per chromosome coverage
+//		statistics (empty when not accumulated)
+string DSegmentsFinder::coverageStatisticsResultsString() {
+	if (coverageStatistics == NULL)
+		return "";
+
+	return coverageStatistics->resultsString();
+}
+
 // string readStartCountsAllResultsString()
 //  Purpose:
 //		Returns a string representing the read start counts
@@ -309,3 +2488,41 @@ string DSegmentsFinder::readStartCountsDSegmentsResultsString() {
 	return ss.str();
 
 }
+
+// string readStartCountsLossSegmentsResultsString()
+//  Purpose:
+//		Returns a string representing the read start counts
+//		for all positions in the loss segments (empty when not scanning
+//		for losses)
+//
+//		format:
+//			<result type="read_start_counts_histogram" positions="state3">
+//				<<#readStarts>>=<<readStartCount>>,...
+//			</result>
+string DSegmentsFinder::readStartCountsLossSegmentsResultsString() {
+	if (!probabilities->hasReducedState())
+		return "";
+
+	stringstream ss;
+
+	// Header
+	ss << "    <result type=\"read_start_counts_histogram\" positions=\"state3\">\n";
+
+	// Results
+	ss	<< "      ";
+	for (int i = 0; i < 4; i++) {
+		ss 
+			<< i
+			<< "="
+			<< lossReadStartCounts[i];
+
+		if (i < 3)
+			ss << ", ";
+	}
+	ss	<< "\n";
+
+	// Footer
+	ss << "    </result>\n";
+
+	return ss.str();
+}
@@ -11,10 +11,42 @@
 #ifndef DSEGMENTFINDER_H
 #define DSEGMENTFINDER_H
 #include "HMMProbabilities.h"
+#include "DSegmentScanner.h"
+#include "CountsReader.h"
+#include "NullSimulator.h"
+#include "CoverageStatistics.h"
+#include "CountsCursor.h"
+#include "WeightTrack.h"
+#include "ShardFile.h"
+#include "DSegmentLanes.h"
+#include "ScoreIndex.h"
+#include "MaximalSubsequenceScanner.h"
+#include "IntervalIndex.h"
+#include "ScanProgress.h"
 #include <string>
 #include <vector>
 using namespace std;
 
+// Floating point precision used to score and accumulate the scan.  The
+// default can be chosen at build time with -DCNV_SCORE_PRECISION=<precision>.
+enum ScorePrecision {
+	FLOAT_SCORES,
+	DOUBLE_SCORES,
+	LONG_DOUBLE_SCORES
+};
+
+// Algorithm used to find the segments in the score track: the reset
+// scan of DSegmentScanner or the maximal scoring subsequences of
+// MaximalSubsequenceScanner
+enum SegmentEngine {
+	RESET_SCAN_ENGINE,
+	MAXIMAL_SUBSEQUENCE_ENGINE
+};
+
+#ifndef CNV_SCORE_PRECISION
+#define CNV_SCORE_PRECISION LONG_DOUBLE_SCORES
+#endif
+
 class DSegmentsFinder
 {
 public:
@@ -39,6 +71,250 @@ public:
 	//		Finds the DSegments for the sequence
 	void findDSegments(string cnvFileName);
 
+	// findDSegmentsInCounts(const string& counts)
+	//  Purpose: 
+	//		Finds the DSegments for a sequence given as the text of a
+	//		counts file
+	void findDSegmentsInCounts(const string& counts);
+
+	// setFixedPointScoring(int fractionalBits)
+	//  Purpose: 
+	//		Switches the scan to fixed-point integer scoring.  The D-Segment
+	//		scores and the threshold are rounded to multiples of
+	//		2^-fractionalBits and accumulated exactly in 64-bit integers, so
+	//		the result does not depend on the order of accumulation.
+	//		Passing 0 switches back to long double scoring.
+	//
+	//		Error bound:
+	//			each per-position score and the threshold are off by at most
+	//			2^-(fractionalBits+1), so a segment of length L differs from its
+	//			long double score by at most L * 2^-(fractionalBits+1)
+	//	Postconditions:
+	//		fixedPointBits - set to fractionalBits
+	void setFixedPointScoring(int fractionalBits);
+
+	// setScorePrecision(ScorePrecision precision)
+	//  Purpose: 
+	//		Sets the floating point precision used to score and accumulate
+	//		the scan when fixed-point scoring is not in use
+	//	Postconditions:
+	//		scorePrecision - set to precision
+	void setScorePrecision(ScorePrecision precision);
+
+	// setPrecisionValidation(bool validate)
+	//  Purpose: 
+	//		When validate is true a long double reference scan is run
+	//		alongside the selected precision and any segment calls that
+	//		differ between the two are reported with the results
+	//	Postconditions:
+	//		validatePrecision - set to validate
+	void setPrecisionValidation(bool validate);
+
+	// setSegmentEngine(SegmentEngine engine, bool compare)
+	//  Purpose: 
+	//		Finds the segments with engine.  When compare is true the other
+	//		engine is run alongside in the same pass and the segments that
+	//		differ between the two are reported with the results.  The
+	//		maximal subsequence engine finds gains only and does not run
+	//		on shards, bins, joint, paired or cached scans, score indexes
+	//		or with precision validation.
+	//	Postconditions:
+	//		segmentEngine, compareEngines - set
+	void setSegmentEngine(SegmentEngine engine, bool compare);
+
+	// setParserThreads(int threads)
+	//  Purpose: 
+	//		Sets the number of threads used to parse the counts file
+	//	Postconditions:
+	//		parserThreads - set to threads
+	void setParserThreads(int threads);
+
+	// setAsyncReads(bool async)
+	//  Purpose: 
+	//		When async is true the counts file is read with several io_uring
+	//		reads in flight (pread is used if io_uring is unavailable)
+	//	Postconditions:
+	//		asyncReads - set to async
+	void setAsyncReads(bool async);
+
+	// setSignificanceTesting(int simulations, NullModel model, uint64_t seed)
+	//  Purpose: 
+	//		Assigns each D-Segment an empirical p-value from the maximum
+	//		segment scores of simulations null sequences as long as the
+	//		scanned sequence.  Passing 0 simulations turns testing off.
+	//	Postconditions:
+	//		significanceSimulations, nullModel, significanceSeed - set
+	void setSignificanceTesting(int simulations, NullModel model, uint64_t seed);
+
+	// setThresholdCalibration(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName)
+	//  Purpose: 
+	//		Replaces the transition probability threshold with one calibrated
+	//		on at least megabases of simulated normal state sequence to give
+	//		falseSegmentsPerMegabase.  Calibrations are cached in
+	//		cacheFileName (no cache if empty).  A rate of 0 turns
+	//		calibration off.
+	//	Postconditions:
+	//		calibrationRate, calibrationMegabases, calibrationSeed,
+	//		calibrationCacheFileName - set
+	void setThresholdCalibration(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName);
+
+	// setCoverageStatistics(int windowSize, string windowFileName)
+	//  Purpose: 
+	//		Accumulates per chromosome and per window read start statistics
+	//		during the scan.  The window statistics are written to
+	//		windowFileName (not written if empty).  A windowSize of 0 turns
+	//		the statistics off.
+	//	Postconditions:
+	//		coverageWindowSize, coverageWindowFileName - set
+	void setCoverageStatistics(int windowSize, string windowFileName);
+
+	// setPairedNormal(string normalFileName, double normalSampleMean)
+	//  Purpose: 
+	//		Scores the sequence as a tumor against the matched normal counts
+	//		in normalFileName, read in the same pass.  Each position is
+	//		scored on the tumor's share of the pair's read starts, with
+	//		normalSampleMean the normal's mean read starts, so only somatic
+	//		changes score.  An empty file name turns paired mode off.
+	//	Postconditions:
+	//		pairedNormalFileName, pairedNormalMean - set
+	void setPairedNormal(string normalFileName, double normalSampleMean);
+
+	// setWeightTrack(string weightTrackFileName)
+	//  Purpose: 
+	//		Corrects the scores for read start bias with the binary weight
+	//		track in weightTrackFileName (see WeightTrack.h), joined to the
+	//		counts as they are scanned.  An empty file name turns the
+	//		correction off.
+	//	Postconditions:
+	//		weightTrackFileName - set
+	void setWeightTrack(string weightTrackFileName);
+
+	// setShardRange(string chromosome, long long start, long long end, int leadInPositions)
+	//  Purpose: 
+	//		Scans only the positions start to end of chromosome as one shard
+	//		of a sequence split across runs, keeping the first
+	//		leadInPositions score indices and the end state of the scan for
+	//		mergeShards (see ShardFile.h).  The open segment at the end of
+	//		the shard is left out of the segments.  An empty chromosome
+	//		turns sharding off.
+	//	Postconditions:
+	//		shardChromosome, shardStart, shardEnd, shardLeadIn - set
+	void setShardRange(string chromosome, long long start, long long end, int leadInPositions);
+
+	// writeShard(string shardFileName)
+	//  Purpose: 
+	//		Writes the shard found by the last findDSegments to
+	//		shardFileName
+	void writeShard(string shardFileName);
+
+	// mergeShards(const vector<string>& shardFileNames)
+	//  Purpose: 
+	//		Merges the shards in shardFileNames, in sequence order, into the
+	//		segments and read start counts a serial scan of the whole
+	//		sequence finds.  Throws runtime_error if a shard's lead-in is
+	//		too short to carry the scan into it exactly.
+	//	Postconditions:
+	//		segments, threshold, read start counts - set
+	void mergeShards(const vector<string>& shardFileNames);
+
+	// setBinnedScan(int binSize, double binThreshold, int paddingBins, bool verify)
+	//  Purpose: 
+	//		Finds the D-Segments coarse to fine.  The read start scores are
+	//		summed over bins of binSize consecutive positions and the bins
+	//		scanned with binThreshold to find candidate regions.  Only the
+	//		candidates, padded by paddingBins bins on each side, are scanned
+	//		position by position.  Both scans run in the single pass over
+	//		the counts.  When verify is true the full scan is run as well
+	//		and the differences reported.  A negative binThreshold is half
+	//		the threshold.  A binSize of 0 turns binning off.
+	//	Postconditions:
+	//		binSize, binThreshold, binPadding, verifyBins - set
+	void setBinnedScan(int binSize, double binThreshold, int paddingBins, bool verify);
+
+	// setJointSamples(const vector<string>& sampleFileNames)
+	//  Purpose: 
+	//		Segments the sequence jointly with the samples in
+	//		sampleFileNames, read in lockstep in the same pass.  Each
+	//		position is scored for every sample, the segments are found on
+	//		the sum of the samples' scores and each sample is also segmented
+	//		on its own.  The summed scores are held to the threshold times
+	//		the number of samples, the cost of every sample changing state
+	//		together, and a joint segment's statistics count the records of
+	//		all the samples.  A joint segment's support is the number of
+	//		samples with a segment overlapping it.  An empty list turns
+	//		joint mode off.
+	//	Postconditions:
+	//		jointSampleFileNames - set
+	void setJointSamples(const vector<string>& sampleFileNames);
+
+	// setResultCache(string cacheDirectory)
+	//  Purpose: 
+	//		Keeps the scan of each chromosome in cacheDirectory, keyed by a
+	//		hash of the chromosome's lines and of the model and threshold
+	//		(see ResultCache.h).  A rerun only scans the chromosomes that
+	//		are not in the cache and merges the cached scans of the others
+	//		into the result of a full scan.  An empty directory turns the
+	//		cache off.
+	//	Postconditions:
+	//		resultCacheDirectory - set
+	void setResultCache(string cacheDirectory);
+
+	// setScoreIndex(string indexFileName)
+	//  Purpose: 
+	//		Keeps the score track of the scan and writes it to
+	//		indexFileName as a score index (see ScoreIndex.h), in the
+	//		fixed-point scores of the scan or with 24 fractional bits
+	//		otherwise.  An empty file name turns the index off.
+	//	Postconditions:
+	//		scoreIndexFileName - set
+	void setScoreIndex(string indexFileName);
+
+	// findDSegmentsFromScoreIndex(string indexFileName, double indexThreshold)
+	//  Purpose: 
+	//		Finds the DSegments from the score index in indexFileName
+	//		instead of the counts, at indexThreshold or, if it is not
+	//		positive, at the (calibrated) threshold of the model.  The
+	//		model's scores must then be those the index was built with.
+	//		The segments are those of a fixed-point scan with the index's
+	//		fractional bits.
+	//	Postconditions:
+	//		segments, threshold, fixedPointBits, read start counts - set
+	void findDSegmentsFromScoreIndex(string indexFileName, double indexThreshold);
+
+	// setAnnotations(const vector<string>& bedFileNames)
+	//  Purpose: 
+	//		Annotates each segment with the intervals of the BED files in
+	//		bedFileNames that overlap it (see IntervalIndex.h).  The
+	//		segments are numbered by chromosome as they are scanned, so
+	//		annotation runs on single sample scans of the whole sequence
+	//		only.  An empty list turns annotation off.
+	//	Postconditions:
+	//		annotationFileNames - set
+	void setAnnotations(const vector<string>& bedFileNames);
+
+	// setProgress(ScanProgress* scanProgress)
+	//  Purpose: 
+	//		Follows the scans with scanProgress (see ScanProgress.h), which
+	//		can stop them early.  A stopped scan keeps the segments found
+	//		so far; a cached scan keeps the chromosomes read whole.  The
+	//		significance tests, annotation, coverage window file and score
+	//		index are skipped after a stop.  NULL turns this off.
+	//	Postconditions:
+	//		progress - set
+	void setProgress(ScanProgress* scanProgress);
+
+	// setSegmentStore(bool compact, string spillDirectory, long long memoryLimit)
+	//  Purpose: 
+	//		Keeps the segments and loss segments of single sample scans
+	//		and score indexes in SegmentStores (see SegmentStore.h) in
+	//		place of vectors, for thresholds that call tens of millions
+	//		of segments.  Stored scores are floats.  With a spill
+	//		directory the stores move their blocks beyond memoryLimit
+	//		bytes to temporary files there.
+	//	Postconditions:
+	//		compactSegments, segmentSpillDirectory, segmentMemoryLimit - set
+	void setSegmentStore(bool compact, string spillDirectory, long long memoryLimit);
+
 	// string results()
 	//  Purpose:
 	//		Returns a string representing the results for finding the D-Segments
@@ -47,24 +323,449 @@ public:
 	//			<result type="viterbi_iteration" iteration="<< iteration >>">
 	//				<<probabilitiesResultsString>>
 	//				<<thresholdResultsString>>
+	//				<<scoreQuantizationResultsString>>
+	//				<<pairedNormalResultsString>>
+	//				<<weightTrackResultsString>>
+	//				<<binnedScanResultsString>>
+	//				<<jointResultsString>>
+	//				<<resultCacheResultsString>>
+	//				<<scoreIndexResultsString>>
+	//				<<segmentEngineResultsString>>
+	//				<<scanProgressResultsString>>
+	//				<<segmentStoreResultsString>>
 	//				<<segmentsResultsString>>
+	//				<<segmentStatisticsResultsString>>
+	//				<<annotationResultsString>>
+	//				<<lossSegmentsResultsString>>
+	//				<<precisionValidationResultsString>>
+	//				<<significanceResultsString>>
+	//				<<coverageStatisticsResultsString>>
 	//				<<readStartCountsAllResultsString>>
 	//				<<readStartCountsDSegmentsResultsString>>
+	//				<<readStartCountsLossSegmentsResultsString>>
 	//			</result>
 	string results();
 
 private:
-	struct Segment {
-		int start;
-		int end;
-		long double score;
-	};
+	typedef DSegment Segment;
 
 	vector<Segment> segments;
 	int readStartCounts[4];
 	int dSegmentReadStartCounts[4];
 	double threshold;
 
+	// Loss segments, found when the model has the reduced state 3
+	vector<Segment> lossSegments;
+	int lossReadStartCounts[4];
+	double lossThreshold;
+	int fixedPointBits;
+	ScorePrecision scorePrecision;
+	int parserThreads;
+	bool asyncReads;
+
+	// Significance testing
+	int significanceSimulations;
+	NullModel nullModel;
+	uint64_t significanceSeed;
+	vector<double> segmentPValues;
+	double nullMaxScore95;
+
+	// Threshold calibration
+	double calibrationRate;
+	double calibrationMegabases;
+	uint64_t calibrationSeed;
+	string calibrationCacheFileName;
+	bool calibrationCached;
+
+	// Coverage statistics
+	int coverageWindowSize;
+	string coverageWindowFileName;
+	CoverageStatistics* coverageStatistics;
+
+	// Paired normal
+	string pairedNormalFileName;
+	double pairedNormalMean;
+	long long pairedMatchedRecords;
+	long long pairedTumorOnlyRecords;
+	long long pairedNormalOnlyRecords;
+
+	// Read start bias correction
+	string weightTrackFileName;
+	WeightTrack* weightTrack;
+	long long weightedPositions;
+	long long unweightedPositions;
+
+	// Sharding
+	string shardChromosome;
+	long long shardStart;
+	long long shardEnd;
+	int shardLeadIn;
+	ShardFile* shard;
+
+	// Coarse to fine scan
+	int binSize;
+	double binThreshold;
+	int binPadding;
+	bool verifyBins;
+	long long binCandidates;
+	long long binScannedPositions;
+
+	// Joint segmentation, the sample segments are those of the counts
+	// file first and then of jointSampleFileNames
+	vector<string> jointSampleFileNames;
+	string jointCountsFileName;
+	vector<vector<Segment> > jointSampleSegments;
+	vector<int> jointSupport;
+	long long jointPositions;
+	long double jointThreshold;
+
+	// Result cache
+	string resultCacheDirectory;
+	int resultCacheHits;
+	int resultCacheMisses;
+	bool resultCacheFullScan;
+
+	// Score index, built by the scan or read to find the segments
+	string scoreIndexFileName;
+	ScoreIndex* scoreIndex;
+	bool scoreIndexInput;
+
+	// Segment engine and the segments only one engine found when
+	// comparing them
+	SegmentEngine segmentEngine;
+	bool compareEngines;
+	vector<Segment> maximalOnlySegments;
+	vector<Segment> resetOnlySegments;
+	int sharedEngineSegments;
+
+	// Annotation, the chromosomes in scan order as the segments number
+	// them and per annotation file the overlapping intervals of each
+	// segment, from offsets[k] to offsets[k + 1]
+	vector<string> annotationFileNames;
+	vector<IntervalIndex*> annotationIndexes;
+	vector<string> scannedChromosomes;
+	vector<vector<int> > annotationOffsets;
+	vector<vector<int> > annotationIntervals;
+
+	// Progress of the scans, not owned
+	ScanProgress* progress;
+
+	// Compact segments, in place of segments and lossSegments
+	bool compactSegments;
+	string segmentSpillDirectory;
+	long long segmentMemoryLimit;
+	SegmentStore segmentStore;
+	SegmentStore lossSegmentStore;
+
+	// Precision validation results
+	bool validatePrecision;
+	vector<Segment> referenceOnlySegments;
+	vector<Segment> scanOnlySegments;
+	long double maxScoreDivergence;
+
+	// findDSegments(CountsReader& reader)
+	//  Purpose:
+	//		Finds the DSegments for the sequence read by reader
+	void findDSegments(CountsReader& reader);
+
+	// calibrateThreshold()
+	//  Purpose:
+	//		Calibrates the threshold on simulated normal sequence when
+	//		calibration is on
+	//	Postconditions:
+	//		threshold, calibrationMegabases, calibrationCached - set
+	void calibrateThreshold();
+
+	// bool scanStopped()
+	//  Purpose:
+	//		Returns true if the progress stopped the last scan before the
+	//		end of its input
+	bool scanStopped();
+
+	// findCachedDSegments(string cnvFileName)
+	//  Purpose:
+	//		Finds the DSegments for the sequence in cnvFileName, scanning
+	//		only the chromosomes missing from the result cache and merging
+	//		the cached scans of the others.  The whole file is scanned if
+	//		its chromosomes are split up or the cached scans can not be
+	//		merged exactly.
+	//	Postconditions:
+	//		segments, read start counts, resultCacheHits,
+	//		resultCacheMisses, resultCacheFullScan - set
+	void findCachedDSegments(string cnvFileName);
+
+	// scanChromosomeShards(CountsReader& reader, long double scale, const long double referenceScores[4], vector<ShardFile>& shards)
+	//  Purpose:
+	//		Scans each chromosome named by shards as a shard of the whole
+	//		chromosome, scoring in the Score type and accumulating in the
+	//		Sum type.  Chromosomes not in shards are skipped.
+	//	Postconditions:
+	//		shards - filled in
+	template <typename Score, typename Sum>
+	void scanChromosomeShards(CountsReader& reader, long double scale, const long double referenceScores[4], vector<ShardFile>& shards);
+
+	// scanDSegments(CountsReader& reader, long double scale, const long double referenceScores[4])
+	//  Purpose:
+	//		Scans the counts from reader for D-Segments, scoring in the Score
+	//		type and accumulating in the Sum type.  Integer scores are the
+	//		scores times scale.  When scanning for losses a second scanner
+	//		runs over the same positions with the reduced state scores.  When
+	//		precision validation is on a long double scanner using
+	//		referenceScores is run alongside and the segments are compared.
+	//		With a weight track the scores are looked up by weight class
+	//		and read starts.
+	template <typename Score, typename Sum>
+	void scanDSegments(CountsReader& reader, long double scale, const long double referenceScores[4]);
+
+	// scanBinnedDSegments(CountsReader& reader, const long double scores[4])
+	//  Purpose:
+	//		Scans the counts from reader coarse to fine.  Positions since
+	//		the bin scan last reset are buffered so a candidate can be
+	//		scanned position by position as soon as the bin scan finds it.
+	//		One fine scan runs through all the candidates in order, taking
+	//		each record at most once.
+	//	Postconditions:
+	//		segments, read start counts, binCandidates,
+	//		binScannedPositions - set
+	void scanBinnedDSegments(CountsReader& reader, const long double scores[4]);
+
+	// bool scanPairedDSegments(CountsReader& tumorReader, CountsReader& normalReader, vector<string>& tumorChromosomes, bool tumorChromosomesKnown)
+	//  Purpose:
+	//		Scans the tumor counts for D-Segments, joining each tumor
+	//		position to the normal's record for the same chromosome and
+	//		position.  Positions missing from the normal score the
+	//		transitions only.  Both files must list the chromosomes they
+	//		share in the same order; either may have chromosomes the other
+	//		lacks.  Returns false if the normal has a chromosome the tumor
+	//		lacks before ones they share, to be run again with the tumor's
+	//		chromosomes (set in tumorChromosomes) known.  Throws
+	//		runtime_error if the chromosomes are out of order.
+	//	Postconditions:
+	//		segments, read start counts and paired record counts - set
+	bool scanPairedDSegments(CountsReader& tumorReader, CountsReader& normalReader,
+		vector<string>& tumorChromosomes, bool tumorChromosomesKnown);
+
+	// scanJointDSegments(vector<CountsReader*>& readers)
+	//  Purpose:
+	//		Scans the samples read by readers jointly, joining their records
+	//		on chromosome and position.  Blocks of positions are gathered
+	//		with the samples' codes interleaved, then the summed track and
+	//		the sample lanes step through the block.  A sample without a
+	//		record at a position scores 0 there.  Joint segments do not span
+	//		chromosomes so their support can be counted a chromosome at a
+	//		time.
+	//	Postconditions:
+	//		segments, jointSampleSegments, jointSupport, jointPositions,
+	//		jointThreshold and read start counts (over all samples) - set
+	void scanJointDSegments(vector<CountsReader*>& readers);
+
+	// mergeShardFiles(vector<ShardFile>& shards)
+	//  Purpose:
+	//		Merges shards, scoring in the Score type and accumulating in the
+	//		Sum type they were scanned with
+	template <typename Score, typename Sum>
+	void mergeShardFiles(vector<ShardFile>& shards);
+
+	// annotateSegments()
+	//  Purpose:
+	//		Finds the intervals of each annotation file overlapping each
+	//		segment
+	//	Postconditions:
+	//		annotationOffsets, annotationIntervals - set
+	void annotateSegments();
+
+	// compareEngineSegments(const vector<Segment>& resetSegments, const vector<Segment>& maximalSegments)
+	//  Purpose:
+	//		Records the segments that differ between the reset scan and
+	//		the maximal subsequence engine
+	//	Postconditions:
+	//		maximalOnlySegments, resetOnlySegments, sharedEngineSegments - set
+	void compareEngineSegments(const vector<Segment>& resetSegments, const vector<Segment>& maximalSegments);
+
+	// writeScoreIndex(const long double scores[4])
+	//  Purpose:
+	//		Summarizes the score track kept by the scan in fixed-point
+	//		scores and writes the score index
+	void writeScoreIndex(const long double scores[4]);
+
+	// compareToReference(const vector<Segment>& referenceSegments)
+	//  Purpose:
+	//		Records the segments that differ between the scan and the
+	//		long double reference scan
+	//	Postconditions:
+	//		referenceOnlySegments, scanOnlySegments, maxScoreDivergence - set
+	void compareToReference(const vector<Segment>& referenceSegments);
+
+	// testSignificance(const long double scores[4])
+	//  Purpose:
+	//		Simulates the null maximum score distribution and assigns each
+	//		segment its p-value
+	//	Postconditions:
+	//		segmentPValues, nullMaxScore95 - set
+	void testSignificance(const long double scores[4]);
+
+	// string lossSegmentsResultsString()
+	//  Purpose:
+	//		Returns a string representing the loss threshold and segments
+	//		(empty when not scanning for losses)
+	//
+	//		format:
+	//			<loss_score_threshold><<lossThreshold>></loss_score_threshold>
+	//			<result type="loss_segment_list">
+	//				(segment1start, segment1end, segement1Score),(segment2start, segment2end, segment2Score),...
+	//			</result>
+	string lossSegmentsResultsString();
+
+	// string lossSegmentListResultsString(const Segments& segmentList)
+	//  Purpose:
+	//		Returns the loss segment list and statistics of
+	//		lossSegmentsResultsString for segmentList, a vector of Segments
+	//		or a SegmentStore
+	template <typename Segments>
+	string lossSegmentListResultsString(const Segments& segmentList);
+
+	// string scorePrecisionName()
+	//  Purpose:
+	//		Returns the name of the precision used for the scan
+	string scorePrecisionName();
+
+	// string precisionValidationResultsString()
+	//  Purpose:
+	//		Returns a string representing the segment calls that differ
+	//		from the long double reference (empty when not validating)
+	//
+	//		format:
+	//			<precision_validation precision="<<precision>>" reference="long double" divergent_segments="<<count>>" max_score_difference="<<difference>>">
+	//				(start,end,score,reference|scan),...
+	//			</precision_validation>
+	string precisionValidationResultsString();
+
+	// string significanceResultsString()
+	//  Purpose:
+	//		Returns a string representing the empirical p-value of each
+	//		segment (empty when not testing significance)
+	//
+	//		format:
+	//			<result type="segment_significance" null="<<model>>" simulations="<<count>>" null_max_95="<<score>>">
+	//				(segment1start,segment1end,segment1PValue),...
+	//			</result>
+	string significanceResultsString();
+
+	// string scoreQuantizationResultsString()
+	//  Purpose:
+	//		Returns a string representing the fixed-point quantization used
+	//		for the scores (empty when scoring in long double)
+	//
+	//		format:
+	//			<score_quantization fractional_bits="<<bits>>" max_error_per_position="<<error>>"/>
+	string scoreQuantizationResultsString();
+
+	// string pairedNormalResultsString()
+	//  Purpose:
+	//		Returns a string representing how the tumor and normal records
+	//		were joined (empty when not in paired mode)
+	//
+	//		format:
+	//			<paired_normal file="<<file>>" normal_mean="<<mean>>" matched="<<count>>" tumor_only="<<count>>" normal_only="<<count>>"/>
+	string pairedNormalResultsString();
+
+	// string weightTrackResultsString()
+	//  Purpose:
+	//		Returns a string representing the weight track used to correct
+	//		the scores (empty when not correcting)
+	//
+	//		format:
+	//			<weight_track file="<<file>>" classes="<<count>>" weighted="<<count>>" unweighted="<<count>>"/>
+	string weightTrackResultsString();
+
+	// string jointResultsString()
+	//  Purpose:
+	//		Returns a string representing the joint segments with their
+	//		support and each sample's own segments (empty when not in joint
+	//		mode)
+	//
+	//		format:
+	//			<joint samples="<<count>>" positions="<<count>>" threshold="<<threshold>>"/>
+	//			<result type="joint_segment_list">
+	//				(<<start>>,<<end>>,<<score>>,<<support>>),...
+	//			</result>
+	//			<result type="sample_segment_list" file="<<file>>">
+	//				(<<start>>,<<end>>,<<score>>),...
+	//			</result>
+	//			...
+	string jointResultsString();
+
+	// string resultCacheResultsString()
+	//  Purpose:
+	//		Returns a string representing how the result cache was used
+	//		(empty when not caching)
+	//
+	//		format:
+	//			<result_cache directory="<<directory>>" hits="<<count>>" misses="<<count>>" full_scan="<<true|false>>"/>
+	string resultCacheResultsString();
+
+	// string annotationResultsString()
+	//  Purpose:
+	//		Returns a string representing the intervals of each annotation
+	//		file overlapping each segment (empty when not annotating)
+	//
+	//		format:
+	//			<result type="segment_annotation" file="<<file>>" intervals="<<count>>">
+	//				(<<chromosome>>,<<start>>,<<end>>,<<overlaps>>,<<name>>;<<name>>;...),...
+	//			</result>
+	//			...
+	string annotationResultsString();
+
+	// string segmentEngineResultsString()
+	//  Purpose:
+	//		Returns a string representing the segment engine and the
+	//		segments only one engine found when comparing (empty for the
+	//		reset scan alone)
+	//
+	//		format:
+	//			<segment_engine engine="<<reset|maximal>>" [shared="<<count>>" maximal_only="<<count>>" reset_only="<<count>>"]>
+	//				(start,end,score,maximal|reset),...
+	//			</segment_engine>
+	string segmentEngineResultsString();
+
+	// string scanProgressResultsString()
+	//  Purpose:
+	//		Returns a string representing how far the scan got (empty
+	//		without progress or when it completed unwatched)
+	//
+	//		format:
+	//			<<ScanProgress::resultsString>>
+	string scanProgressResultsString();
+
+	// string segmentStoreResultsString()
+	//  Purpose:
+	//		Returns a string representing the segment stores (empty
+	//		when the segments are not compact)
+	//
+	//		format:
+	//			<segment_store segments="<<count>>" loss_segments="<<count>>" memory_bytes="<<bytes>>" spilled_bytes="<<bytes>>"/>
+	string segmentStoreResultsString();
+
+	// string scoreIndexResultsString()
+	//  Purpose:
+	//		Returns a string representing the score index written by the
+	//		scan or the segments were found from, with the blocks stepped
+	//		over and scanned (empty when there is no index)
+	//
+	//		format:
+	//			<score_index file="<<file>>" records="<<count>>" blocks="<<count>>" fractional_bits="<<bits>>" [skipped_blocks="<<count>>" scanned_blocks="<<count>>"]/>
+	string scoreIndexResultsString();
+
+	// string binnedScanResultsString()
+	//  Purpose:
+	//		Returns a string representing the coarse to fine scan, and how
+	//		it compared to the full scan when verifying (empty when not
+	//		binning)
+	//
+	//		format:
+	//			<binned_scan bin_size="<<size>>" bin_threshold="<<threshold>>" padding_bins="<<bins>>" candidates="<<count>>" scanned_positions="<<count>>" positions="<<count>>" [verified="<<true|false>>" full_only="<<count>>" binned_only="<<count>>"]/>
+	string binnedScanResultsString();
+
 	// string probabilitiesResultsString()
 	//  Purpose:
 	//		Returns a string representing the probabilites
@@ -80,12 +781,14 @@ private:
 
 	// string thresholdResultsString()
 	//  Purpose:
-	//		Returns a string representing the threshold (S=-D)
+	//		Returns a string representing the threshold (S=-D), and how it
+	//		was calibrated if it was
 	//
 	//		format:
 	//			<score_threshold>
 	//				<<threshold>>,
 	//			</score_threshold>
+	//			<threshold_calibration false_segments_per_mb="<<rate>>" simulated_mb="<<megabases>>" cached="<<true|false>>"/>
 	string thresholdResultsString();
 
 	// string segmentsResultsString()
@@ -98,6 +801,38 @@ private:
 	//			</result>
 	string segmentsResultsString();
 
+	// string segmentListResultsString(const Segments& segmentList)
+	//  Purpose:
+	//		Returns segmentsResultsString for segmentList, a vector of
+	//		Segments or a SegmentStore
+	template <typename Segments>
+	string segmentListResultsString(const Segments& segmentList);
+
+	// string segmentStatisticsResultsString(const vector<Segment>& segmentList, string type)
+	//  Purpose:
+	//		Returns a string representing the statistics of each segment in
+	//		segmentList, accumulated during the scan
+	//
+	//		format:
+	//			<result type="<<type>>">
+	//				(start,end,positions,meanReadStarts,scorePerPosition,count0/count1/count2/count3),...
+	//			</result>
+	string segmentStatisticsResultsString(const vector<Segment>& segmentList, string type);
+	string segmentStatisticsResultsString(const SegmentStore& segmentList, string type);
+
+	// string segmentListStatisticsString(const Segments& segmentList, string type)
+	//  Purpose:
+	//		Returns segmentStatisticsResultsString for segmentList, a vector
+	//		of Segments or a SegmentStore
+	template <typename Segments>
+	string segmentListStatisticsString(const Segments& segmentList, string type);
+
+	// string coverageStatisticsResultsString()
+	//  Purpose:
+	//		Returns a string representing the per chromosome coverage
+	//		statistics (empty when not accumulated)
+	string coverageStatisticsResultsString();
+
 	// string readStartCountsAllResultsString()
 	//  Purpose:
 	//		Returns a string representing the read start counts
@@ -120,6 +855,18 @@ private:
 	//			</result>
 	string readStartCountsDSegmentsResultsString();
 
+	// string readStartCountsLossSegmentsResultsString()
+	//  Purpose:
+	//		Returns a string representing the read start counts
+	//		for all positions in the loss segments (empty when not scanning
+	//		for losses)
+	//
+	//		format:
+	//			<result type="read_start_counts_histogram" positions="state3">
+	//				<<#readStarts>>=<<readStartCount>>,...
+	//			</result>
+	string readStartCountsLossSegmentsResultsString();
+
 };
 
 #endif //DSEGMENTFINDER_H
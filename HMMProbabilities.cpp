@@ -13,19 +13,43 @@
 #include "HMMProbabilities.h"
 #include "StringUtilities.h"
 #include <cmath>
+#include <cstddef>
 #include <sstream>
 #include <string>
 #include <limits>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char SNAPSHOT_MAGIC[8] = {'C', 'N', 'V', 'M', 'O', 'D', 'L', '1'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+// 64-bit FNV-1a hash of size bytes of data
+static uint64_t snapshotHash(const char* data, size_t size) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
 
 // Constuctors
 // ==============================================
 HMMProbabilities::HMMProbabilities() {
+	numStates = 0;
+	initialize();
 }
 
 HMMProbabilities::HMMProbabilities(int numOfStates) {
 	numStates = numOfStates;
+	initialize();
 	createEmissionResidueMap();
 
 	// Initialize all probabilities to zero
@@ -43,7 +67,10 @@ HMMProbabilities::HMMProbabilities(int numOfStates) {
 
 HMMProbabilities::HMMProbabilities(int normalLength, int elevatedLength, double normalMean, double elevatedMean) {
 	numStates = 3;
+	initialize();
 	createEmissionResidueMap();
+	stateLengths[1] = normalLength;
+	stateLengths[2] = elevatedLength;
 	setTransitionProbability(1, 1, 1 - ((double) 1/ (double) normalLength));
 	setTransitionProbability(1, 2,  (double) 1/(double) normalLength);
 	setTransitionProbability(2, 1,  (double) 1/(double) elevatedLength);
@@ -53,6 +80,80 @@ HMMProbabilities::HMMProbabilities(int normalLength, int elevatedLength, double
 	populateEmissionProbabilities(2, elevatedMean);
 }
 
+HMMProbabilities::HMMProbabilities(string snapshotFileName) {
+	numStates = 0;
+	initialize();
+
+	// Map the snapshot and copy it out
+	int fileDescriptor = open(snapshotFileName.c_str(), O_RDONLY);
+	struct stat status;
+	if (fileDescriptor < 0 || fstat(fileDescriptor, &status) < 0) {
+		if (fileDescriptor >= 0)
+			close(fileDescriptor);
+		throw runtime_error("could not open model snapshot " + snapshotFileName);
+	}
+	void* mapping = MAP_FAILED;
+	if ((size_t) status.st_size == sizeof(ModelSnapshot))
+		mapping = mmap(NULL, sizeof(ModelSnapshot), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	close(fileDescriptor);
+	if (mapping == MAP_FAILED)
+		throw runtime_error(snapshotFileName + " is not a model snapshot");
+	ModelSnapshot snapshot;
+	memcpy(&snapshot, mapping, sizeof(ModelSnapshot));
+	munmap(mapping, sizeof(ModelSnapshot));
+
+	if (memcmp(snapshot.magic, SNAPSHOT_MAGIC, 8) != 0)
+		throw runtime_error(snapshotFileName + " is not a model snapshot");
+	if (snapshot.version != SNAPSHOT_VERSION || snapshot.longDoubleSize != sizeof(long double))
+		throw runtime_error("model snapshot " + snapshotFileName + " was written by an incompatible version or platform");
+	if (snapshot.checksum != snapshotHash((const char*) &snapshot, offsetof(ModelSnapshot, checksum))
+		|| snapshot.numStates < 3 || snapshot.numStates > 4 || (snapshot.emissionStates & 6) != 6)
+		throw runtime_error("model snapshot " + snapshotFileName + " is corrupt");
+
+	// Probabilities and their logs as they were computed
+	numStates = snapshot.numStates;
+	createEmissionResidueMap();
+	for (int i = 0; i < 4; i++) {
+		setInitiationProbability(i, snapshot.initiation[i]);
+		poissonMeans[i] = snapshot.poissonMeans[i];
+		stateLengths[i] = snapshot.stateLengths[i];
+		for (int j = 0; j < 4; j++) {
+			transitionProbabilities[i][j] = snapshot.transitions[i][j];
+			logTransitionProbabilities[i][j] = snapshot.logTransitions[i][j];
+			scoreTable[i][j] = snapshot.scores[i][j];
+		}
+		thresholds[i] = snapshot.thresholds[i];
+		if (snapshot.emissionStates & (1 << i)) {
+			for (int j = 0; j < 4; j++) {
+				emissionProbabilities[i][j] = snapshot.emissions[i][j];
+				logEmissionProbabilities[i][j] = snapshot.logEmissions[i][j];
+			}
+		}
+	}
+
+	// The thresholds must follow from the transitions
+	for (int i = 2; i < numStates; i++) {
+		long double sameSegProb = logTransitionProbabilities[1][1] + logTransitionProbabilities[i][i];
+		long double switchSegProb = logTransitionProbabilities[1][i] + logTransitionProbabilities[i][1];
+		if (thresholds[i] != (sameSegProb - switchSegProb) / log(2))
+			throw runtime_error("model snapshot " + snapshotFileName + " has thresholds inconsistent with its transitions");
+	}
+
+	// And each state's transitions must sum to 1
+	for (int i = 1; i < numStates; i++) {
+		long double rowSum = 0;
+		for (int j = 1; j < numStates; j++)
+			rowSum += transitionProbabilities[i][j];
+		if (fabsl(rowSum - 1) > 1e-9)
+			throw runtime_error("model snapshot " + snapshotFileName + " has transitions from state " + to_string(i) + " that do not sum to 1");
+	}
+
+	precomputed = true;
+	this->snapshotFileName = snapshotFileName;
+	fromSnapshot = true;
+	snapshotChecksum = snapshot.checksum;
+}
+
 
 // Destructor
 // =============================================
@@ -106,10 +207,27 @@ long double HMMProbabilities::logTransitionProbability(int beginState, int endSt
 	return logTransitionProbabilities[beginState][endState];
 }
 
+// double poissonMean(int state)
+//  Purpose: 
+//		Returns the Poisson mean of the read starts of state
+double HMMProbabilities::poissonMean(int state) {
+	return poissonMeans[state];
+}
+
 // long double dSegmentScore(int readStarts)
 //  Purpose: 
 //		Returns the D-Segment score for the readStarts
 long double HMMProbabilities::dSegmentScore(int readStarts) {
+	return dSegmentScore(2, readStarts);
+}
+
+// long double dSegmentScore(int state, int readStarts)
+//  Purpose: 
+//		Returns the D-Segment score for the readStarts of state against
+//		the normal state (state 1)
+long double HMMProbabilities::dSegmentScore(int state, int readStarts) {
+	if (precomputed && state >= 0 && state < 4 && readStarts >= 0 && readStarts < 4)
+		return scoreTable[state][readStarts];
 
 	// Get Score contribution form state1
 	long double state1Score =
@@ -119,15 +237,110 @@ long double HMMProbabilities::dSegmentScore(int readStarts) {
 		) 
 		/ log(2);
 
-	// Get Score contribution form state2
-	long double state2Score =
+	// Get Score contribution form state
+	long double stateScore =
 		log(
-			 emissionProbabilities.at(2).at(readStarts)
-			 * transitionProbability(2, 2)
+			 emissionProbabilities.at(state).at(readStarts)
+			 * transitionProbability(state, state)
 		) 
 		/ log(2);
 
-	return state2Score - state1Score; 
+	return stateScore - state1Score; 
+}
+
+// long double dSegmentThreshold(int state)
+//  Purpose: 
+//		Returns the threshold (S=-D) for D-Segments of state against
+//		the normal state: the log odds of staying in both states over
+//		switching between them
+long double HMMProbabilities::dSegmentThreshold(int state) {
+	if (precomputed && state >= 0 && state < 4)
+		return thresholds[state];
+
+	long double sameSegProb =
+		logTransitionProbability(1, 1) + logTransitionProbability(state, state);
+	long double switchSegProb =
+		logTransitionProbability(1, state) + logTransitionProbability(state, 1);
+	return (sameSegProb - switchSegProb) / log(2);
+}
+
+// long double weightedDSegmentScore(int state, double weight, int readStarts)
+//  Purpose: 
+//		Returns the D-Segment score for the readStarts of state against
+//		the normal state at a position where the expected read starts
+//		of every state are multiplied by weight.  A weight of 0 scores
+//		the transitions only.
+long double HMMProbabilities::weightedDSegmentScore(int state, double weight, int readStarts) {
+	long double state1Score = logTransitionProbability(1, 1) / log(2);
+	long double stateScore = logTransitionProbability(state, state) / log(2);
+	if (weight <= 0)
+		return stateScore - state1Score;
+
+	state1Score += log(calculateCodeProbability(poissonMeans[1] * weight, readStarts)) / log(2);
+	stateScore += log(calculateCodeProbability(poissonMeans[state] * weight, readStarts)) / log(2);
+
+	return stateScore - state1Score;
+}
+
+// long double pairedDSegmentScore(int normalReadStarts, int readStarts, double normalSampleMean)
+//  Purpose: 
+//		Returns the D-Segment score for readStarts in a tumor sample
+//		where the matched normal sample has normalReadStarts (4 if the
+//		normal has no record for the position) at a position.  Given the
+//		total read starts of the pair, the tumor's share is binomial with
+//		p = tumorMean / (tumorMean + normalSampleMean) for the state, so
+//		copy number shared with the normal cancels out.  A missing normal
+//		record scores the transitions only.
+long double HMMProbabilities::pairedDSegmentScore(int normalReadStarts, int readStarts, double normalSampleMean) {
+	long double state1Score = logTransitionProbability(1, 1) / log(2);
+	long double state2Score = logTransitionProbability(2, 2) / log(2);
+	if (normalReadStarts > 3)
+		return state2Score - state1Score;
+
+	// Binomial coefficients cancel between the states
+	double p1 = poissonMeans[1] / (poissonMeans[1] + normalSampleMean);
+	double p2 = poissonMeans[2] / (poissonMeans[2] + normalSampleMean);
+	state1Score += (readStarts * log(p1) + normalReadStarts * log(1 - p1)) / log(2);
+	state2Score += (readStarts * log(p2) + normalReadStarts * log(1 - p2)) / log(2);
+
+	return state2Score - state1Score;
+}
+
+// addReducedState(int reducedLength, double reducedMean)
+//  Purpose: 
+//		Adds state 3 for reduced copy number, entered from the normal
+//		state as often as the elevated state is.  The state 1
+//		transitions are renormalized to sum to 1, so the state 2 and
+//		state 3 scores and thresholds follow from a valid row;
+//		state 3 is only ever scored against state 1.
+//	Postconditions:
+//		numStates - 4
+//		transition and emission probabilities set for state 3
+void HMMProbabilities::addReducedState(int reducedLength, double reducedMean) {
+	numStates = 4;
+
+	// Enter state 3 as often as state 2 and scale the row back to 1
+	long double rowSum = transitionProbability(1, 1) + 2 * transitionProbability(1, 2);
+	long double normalToNormal = transitionProbability(1, 1) / rowSum;
+	long double normalToChanged = transitionProbability(1, 2) / rowSum;
+	setTransitionProbability(1, 1, normalToNormal);
+	setTransitionProbability(1, 2, normalToChanged);
+	setTransitionProbability(1, 3, normalToChanged);
+	setTransitionProbability(2, 3, 0);
+	setTransitionProbability(3, 1,  (double) 1/(double) reducedLength);
+	setTransitionProbability(3, 2, 0);
+	setTransitionProbability(3, 3, 1 - ((double) 1/ (double) reducedLength));
+	setInitiationProbability(3, 0);
+	stateLengths[3] = reducedLength;
+
+	populateEmissionProbabilities(3, reducedMean);
+}
+
+// bool hasReducedState()
+//  Purpose: 
+//		Returns true if the model has the reduced state 3
+bool HMMProbabilities::hasReducedState() {
+	return numStates > 3;
 }
 
 // setEmissionProbability(int state, char residue, double value)
@@ -138,6 +351,7 @@ long double HMMProbabilities::dSegmentScore(int readStarts) {
 //		logEmissionProbabilites - value set for state/residue
 void HMMProbabilities::setEmissionProbability(int state, string residue, long double value) {
 	emissionProbabilities[state][getEmissionResidueIndex(residue)] = value;
+	precomputed = false;
 	double logVal;
 	if (value == 0)
 		logVal = std::numeric_limits<double>::quiet_NaN();
@@ -154,6 +368,7 @@ void HMMProbabilities::setEmissionProbability(int state, string residue, long do
 //		logInitiationProbabilites - value set for state
 void HMMProbabilities::setInitiationProbability(int state, long double value) {
 	initiationProbabilities[state] = value;
+	precomputed = false;
 	double logVal;
 	if (value == 0)
 		logVal = std::numeric_limits<double>::quiet_NaN();
@@ -171,6 +386,7 @@ void HMMProbabilities::setInitiationProbability(int state, long double value) {
 //		logTransitionProbabilites - value set for beginState to endState
 void HMMProbabilities::setTransitionProbability(int beginState, int endState, long double value) {
 	transitionProbabilities[beginState][endState] = value;
+	precomputed = false;
 	double logVal;
 	if (value == 0)
 		logVal = std::numeric_limits<double>::quiet_NaN();
@@ -179,11 +395,60 @@ void HMMProbabilities::setTransitionProbability(int beginState, int endState, lo
 	logTransitionProbabilities[beginState][endState] = logVal;
 }
 
+// writeSnapshot(string fileName)
+//  Purpose:
+//		Writes the model to fileName as a ModelSnapshot
+//	Postconditions:
+//		snapshotFileName, snapshotChecksum - set
+void HMMProbabilities::writeSnapshot(string fileName) {
+	ModelSnapshot snapshot;
+	memset(&snapshot, 0, sizeof(snapshot));
+	memcpy(snapshot.magic, SNAPSHOT_MAGIC, 8);
+	snapshot.version = SNAPSHOT_VERSION;
+	snapshot.longDoubleSize = sizeof(long double);
+	snapshot.numStates = numStates;
+	for (int i = 0; i < 4; i++) {
+		snapshot.stateLengths[i] = stateLengths[i];
+		snapshot.poissonMeans[i] = poissonMeans[i];
+		snapshot.initiation[i] = initiationProbabilities[i];
+		for (int j = 0; j < 4; j++) {
+			snapshot.transitions[i][j] = transitionProbabilities[i][j];
+			snapshot.logTransitions[i][j] = logTransitionProbabilities[i][j];
+		}
+		if (emissionProbabilities.count(i) > 0) {
+			snapshot.emissionStates |= 1 << i;
+			for (int j = 0; j < 4; j++) {
+				snapshot.emissions[i][j] = emissionProbabilities[i][j];
+				snapshot.logEmissions[i][j] = logEmissionProbabilities[i][j];
+			}
+		}
+	}
+	if ((snapshot.emissionStates & 6) != 6)
+		throw runtime_error("model snapshots need emissions for the normal and elevated states");
+	for (int i = 1; i < numStates; i++)
+		for (int j = 0; j < 4; j++)
+			snapshot.scores[i][j] = dSegmentScore(i, j);
+	for (int i = 2; i < numStates; i++)
+		snapshot.thresholds[i] = dSegmentThreshold(i);
+	snapshot.checksum = snapshotHash((const char*) &snapshot, offsetof(ModelSnapshot, checksum));
+
+	ofstream snapshotFile(fileName.c_str(), ios::binary | ios::trunc);
+	if (!snapshotFile.is_open())
+		throw runtime_error("could not open model snapshot " + fileName + " for writing");
+	snapshotFile.write((const char*) &snapshot, sizeof(snapshot));
+	if (!snapshotFile)
+		throw runtime_error("could not write model snapshot " + fileName);
+
+	snapshotFileName = fileName;
+	snapshotChecksum = snapshot.checksum;
+}
+
 // string probabilitiesResultsString()
 //  Purpose:
 //		Returns a string representing the probabilites
 //
 //		format:
+//			<<sourceResultsString>>
 //			<<statesResultsString>>
 //			<<initiationProbabilitesResultsString>>
 //			<<transmissionProbabilitesResultsString>>
@@ -196,6 +461,9 @@ string HMMProbabilities::probabilitiesResultsString() {
 	// Begin Model
 	ss << "      <model type=\"hmm\">\n";
 
+	// Source
+	ss << sourceResultsString();
+
 	// States
 	ss << statesResultsString();
 
@@ -212,6 +480,39 @@ string HMMProbabilities::probabilitiesResultsString() {
 	return ss.str();
 }
 
+// string sourceResultsString()
+//  Purpose:
+//		Returns a string representing where the model came from, empty
+//		unless it was loaded from or saved to a snapshot
+//
+//		format:
+//			<source type="<<snapshot|parameters>>" file="<<snapshot file>>" version="<<version>>" checksum="<<checksum>>" normal_length="<<length>>" elevated_length="<<length>>" normal_mean="<<mean>>" elevated_mean="<<mean>>" [reduced_length="<<length>>" reduced_mean="<<mean>>"]/>
+string HMMProbabilities::sourceResultsString() {
+	if (snapshotFileName.empty())
+		return "";
+
+	char checksum[17];
+	snprintf(checksum, sizeof(checksum), "%016llx", (unsigned long long) snapshotChecksum);
+
+	stringstream ss;
+	ss
+		<< "        <source type=\"" << (fromSnapshot ? "snapshot" : "parameters")
+		<< "\" file=\"" << snapshotFileName
+		<< "\" version=\"" << SNAPSHOT_VERSION
+		<< "\" checksum=\"" << checksum
+		<< "\" normal_length=\"" << stateLengths[1]
+		<< "\" elevated_length=\"" << stateLengths[2]
+		<< "\" normal_mean=\"" << poissonMeans[1]
+		<< "\" elevated_mean=\"" << poissonMeans[2] << "\"";
+	if (hasReducedState())
+		ss
+			<< " reduced_length=\"" << stateLengths[3]
+			<< "\" reduced_mean=\"" << poissonMeans[3] << "\"";
+	ss << "/>\n";
+
+	return ss.str();
+}
+
 // string statesResultsString()
 //  Purpose:
 //		Returns a string representing the states
@@ -333,6 +634,24 @@ string HMMProbabilities::emissionProbablitiesResultsString(int state) {
 	return ss.str();
 }
 
+// initialize()
+//  Purpose: 
+//		Zeroes the probabilities and clears the snapshot the model came
+//		from
+void HMMProbabilities::initialize() {
+	for (int i = 0; i < 4; i++) {
+		setInitiationProbability(i, 0);
+		for (int j = 0; j < 4; j++)
+			setTransitionProbability(i, j, 0);
+		poissonMeans[i] = 0;
+		stateLengths[i] = 0;
+		thresholds[i] = 0;
+	}
+	precomputed = false;
+	fromSnapshot = false;
+	snapshotChecksum = 0;
+}
+
 // map<string, int> createEmissionMap()
 //  Purpose: 
 //		Creates a map of the index location for a nucleotide emission
@@ -353,6 +672,7 @@ int HMMProbabilities::getEmissionResidueIndex(string residue) {
 }
 
 void HMMProbabilities::populateEmissionProbabilities(int state, double poissonMean) {
+	poissonMeans[state] = poissonMean;
 
 	// Set emission for 0 read starts
 	double zeroProb = calculatePoissonProbability(poissonMean, 0);
@@ -377,6 +697,19 @@ double HMMProbabilities::calculatePoissonProbability(double mean, int observedVa
 
 }
 
+// double calculateCodeProbability(double mean, int readStarts)
+//  Purpose: 
+//		Returns the Poisson probability of readStarts, with 3 standing
+//		for 3 or more
+double HMMProbabilities::calculateCodeProbability(double mean, int readStarts) {
+	if (readStarts < 3)
+		return calculatePoissonProbability(mean, readStarts);
+
+	return 1 - (calculatePoissonProbability(mean, 0)
+		+ calculatePoissonProbability(mean, 1)
+		+ calculatePoissonProbability(mean, 2));
+}
+
 int HMMProbabilities::factorial(int value) {
 	if (value == 0)
 		return 1;
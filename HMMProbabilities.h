@@ -7,6 +7,13 @@
  *	convenience methods for setting and retriving probabilties as well as
  *  the log value of each probabilty.
  *
+ *	A model can be saved as a binary snapshot and loaded again in place of
+ *  its parameters, so batch and server jobs share one validated model.
+ *  The snapshot holds the probabilities and their logs as computed, the
+ *  D-Segment score table and thresholds, so a loaded model scores exactly
+ *  as the model that was saved without recomputing anything.  It is a
+ *  single ModelSnapshot record read by mapping the file.
+ *
  *  Created on: 2-15-13
  *      Author: tomkolar
  */
@@ -14,9 +21,31 @@
 #ifndef HMMPROBABILITIES_H
 #define HMMPROBABILITIES_H
 #include <map>
+#include <stdint.h>
 #include <string>
 using namespace std;
 
+// Binary model snapshot (native byte order, version 1).  States without
+// emissions and the unused state 0 row are zero.  The checksum is the
+// 64-bit FNV-1a hash of the bytes before it, padding included.
+struct ModelSnapshot {
+	char magic[8];						// "CNVMODL1"
+	uint32_t version;
+	uint32_t longDoubleSize;			// sizeof(long double) of the writer
+	int32_t numStates;
+	int32_t emissionStates;				// bit per state with emissions
+	int32_t stateLengths[4];			// expected lengths the model was built from
+	double poissonMeans[4];
+	long double initiation[4];
+	long double transitions[4][4];
+	long double logTransitions[4][4];
+	long double emissions[4][4];		// by state and read starts (3 for 3+)
+	long double logEmissions[4][4];
+	long double scores[4][4];			// dSegmentScore(state, readStarts)
+	long double thresholds[4];			// dSegmentThreshold(state)
+	uint64_t checksum;
+};
+
 class HMMProbabilities
 {
 public:
@@ -25,6 +54,7 @@ public:
 	HMMProbabilities();
 	HMMProbabilities(int numOfStates);
 	HMMProbabilities(int normalLength, int elevatedLength, double normalMean, double elevatedMean);
+	HMMProbabilities(string snapshotFileName);
 
 		// Destructor
 	// =============================================
@@ -69,10 +99,74 @@ public:
 	//		beginState to endState
 	long double logTransitionProbability(int beginState, int endState);
 
+	// double poissonMean(int state)
+	//  Purpose: 
+	//		Returns the Poisson mean of the read starts of state
+	double poissonMean(int state);
+
 	// long double dSegmentScore(int readStarts)
 	//  Purpose: 
 	//		Returns the D-Segment score for the readStarts
 	long double dSegmentScore(int readStarts);
+
+	// long double dSegmentScore(int state, int readStarts)
+	//  Purpose: 
+	//		Returns the D-Segment score for the readStarts of state against
+	//		the normal state (state 1)
+	long double dSegmentScore(int state, int readStarts);
+
+	// dSegmentScoreTable(Score scores[4], int state = 2)
+	//  Purpose: 
+	//		Fills scores with the D-Segment score of state for 0 to 3 read
+	//		starts, computed in long double and rounded to the Score type
+	template <typename Score>
+	void dSegmentScoreTable(Score scores[4], int state = 2) {
+		for (int i = 0; i < 4; i++)
+			scores[i] = (Score) dSegmentScore(state, i);
+	}
+
+	// long double dSegmentThreshold(int state = 2)
+	//  Purpose: 
+	//		Returns the threshold (S=-D) for D-Segments of state against
+	//		the normal state: the log odds of staying in both states over
+	//		switching between them
+	long double dSegmentThreshold(int state = 2);
+
+	// long double weightedDSegmentScore(int state, double weight, int readStarts)
+	//  Purpose: 
+	//		Returns the D-Segment score for the readStarts of state against
+	//		the normal state at a position where the expected read starts
+	//		of every state are multiplied by weight (for mappability or GC
+	//		bias).  A weight of 0 scores the transitions only.
+	long double weightedDSegmentScore(int state, double weight, int readStarts);
+
+	// long double pairedDSegmentScore(int normalReadStarts, int readStarts, double normalSampleMean)
+	//  Purpose: 
+	//		Returns the D-Segment score for readStarts in a tumor sample
+	//		where the matched normal sample has normalReadStarts (4 if the
+	//		normal has no record for the position) at a position.  Given the
+	//		total read starts of the pair, the tumor's share is binomial with
+	//		p = tumorMean / (tumorMean + normalSampleMean) for the state, so
+	//		copy number shared with the normal cancels out.  A missing normal
+	//		record scores the transitions only.
+	long double pairedDSegmentScore(int normalReadStarts, int readStarts, double normalSampleMean);
+
+	// addReducedState(int reducedLength, double reducedMean)
+	//  Purpose: 
+	//		Adds state 3 for reduced copy number, entered from the normal
+	//		state as often as the elevated state is.  The state 1
+	//		transitions are renormalized to sum to 1, so the state 2 and
+	//		state 3 scores and thresholds follow from a valid row;
+	//		state 3 is only ever scored against state 1.
+	//	Postconditions:
+	//		numStates - 4
+	//		transition and emission probabilities set for state 3
+	void addReducedState(int reducedLength, double reducedMean);
+
+	// bool hasReducedState()
+	//  Purpose: 
+	//		Returns true if the model has the reduced state 3
+	bool hasReducedState();
 	
 	// setEmissionProbability(int state, char residue, double value)
 	//  Purpose: 
@@ -99,11 +193,19 @@ public:
 	//		logTransitionProbabilites - value set for beginState to endState
 	void setTransitionProbability(int beginState, int endState, long double value);
 
+	// writeSnapshot(string fileName)
+	//  Purpose:
+	//		Writes the model to fileName as a ModelSnapshot
+	//	Postconditions:
+	//		snapshotFileName, snapshotChecksum - set
+	void writeSnapshot(string fileName);
+
 	// string probabilitiesResultsString()
 	//  Purpose:
 	//		Returns a string representing the probabilites
 	//
 	//		format:
+	//			<<sourceResultsString>>
 	//			<<statesResultsString>>
 	//			<<initiationProbabilitesResultsString>>
 	//			<<transmissionProbabilitesResultsString>>
@@ -112,6 +214,15 @@ public:
 	//			...
 	string probabilitiesResultsString();
 
+	// string sourceResultsString()
+	//  Purpose:
+	//		Returns a string representing where the model came from, empty
+	//		unless it was loaded from or saved to a snapshot
+	//
+	//		format:
+	//			<source type="<<snapshot|parameters>>" file="<<snapshot file>>" version="<<version>>" checksum="<<checksum>>" normal_length="<<length>>" elevated_length="<<length>>" normal_mean="<<mean>>" elevated_mean="<<mean>>" [reduced_length="<<length>>" reduced_mean="<<mean>>"]/>
+	string sourceResultsString();
+
 	// string statesResultsString()
 	//  Purpose:
 	//		Returns a string representing the states
@@ -159,16 +270,31 @@ private:
 	int numStates;
 	map<int, map<int, long double>> emissionProbabilities;
 	map<int, map<int, long double>> logEmissionProbabilities;
-	long double transitionProbabilities[3][3];
-	long double logTransitionProbabilities[3][3];
-	long double initiationProbabilities[3];
-	long double logInitiationProbabilities[3];
+	long double transitionProbabilities[4][4];
+	long double logTransitionProbabilities[4][4];
+	long double initiationProbabilities[4];
+	long double logInitiationProbabilities[4];
+	double poissonMeans[4];
+	int stateLengths[4];
+
+	// Score table and thresholds of a loaded snapshot, used until a
+	// probability is changed
+	bool precomputed;
+	long double scoreTable[4][4];
+	long double thresholds[4];
+
+	// Snapshot the model was loaded from or saved to
+	string snapshotFileName;
+	bool fromSnapshot;
+	uint64_t snapshotChecksum;
 
 	// Private Methods
 	void createEmissionResidueMap();
+	void initialize();
 	int getEmissionResidueIndex(string residue);
 	void populateEmissionProbabilities(int state, double poissonMean);
 	double calculatePoissonProbability(double mean, int observedValue);
+	double calculateCodeProbability(double mean, int readStarts);
 	int factorial(int value);
 
 };
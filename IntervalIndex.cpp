@@ -0,0 +1,214 @@
+/*
+ * IntervalIndex.cpp
+ *
+ *	This is the cpp file for the IntervalIndex object. An IntervalIndex
+ *  holds the annotation intervals of a BED file and finds the intervals
+ *  overlapping a segment with an implicit interval tree.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "IntervalIndex.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+
+// Subtrees of this level or lower are scanned in order
+static const int SCAN_LEVEL = 3;
+
+// A BED line before sorting
+struct BedInterval {
+	string chromosome;
+	long long start;
+	long long end;
+	int nameIndex;
+
+	bool operator<(const BedInterval& other) const {
+		if (chromosome != other.chromosome)
+			return chromosome < other.chromosome;
+		return start < other.start;
+	}
+};
+
+// Constuctors
+// ==============================================
+IntervalIndex::IntervalIndex(string bedFileName) {
+	fileName = bedFileName;
+	ifstream bedFile(bedFileName.c_str());
+	if (!bedFile.is_open())
+		throw runtime_error("could not open annotation file " + bedFileName);
+
+	// Read the intervals
+	vector<BedInterval> intervals;
+	string line;
+	while (getline(bedFile, line)) {
+		if (line.empty() || line[0] == '#' || line.compare(0, 5, "track") == 0 || line.compare(0, 7, "browser") == 0)
+			continue;
+
+		stringstream fields(line);
+		BedInterval interval;
+		long long bedStart;
+		long long bedEnd;
+		if (!(fields >> interval.chromosome >> bedStart >> bedEnd) || bedEnd < bedStart)
+			throw runtime_error("bad line in annotation file " + bedFileName + ": " + line);
+		string name;
+		if (!(fields >> name)) {
+			stringstream defaultName;
+			defaultName << interval.chromosome << ":" << bedStart << "-" << bedEnd;
+			name = defaultName.str();
+		}
+		interval.start = bedStart + 1;
+		interval.end = bedEnd + 1;
+		interval.nameIndex = names.size();
+		names.push_back(name);
+		intervals.push_back(interval);
+	}
+	sort(intervals.begin(), intervals.end());
+
+	// Lay them out in flat arrays and build each chromosome's tree
+	starts.resize(intervals.size());
+	ends.resize(intervals.size());
+	maxEnds.resize(intervals.size());
+	nameIndices.resize(intervals.size());
+	for (size_t i = 0; i < intervals.size(); i++) {
+		starts[i] = intervals[i].start;
+		ends[i] = intervals[i].end;
+		nameIndices[i] = intervals[i].nameIndex;
+	}
+	for (size_t i = 0; i < intervals.size(); ) {
+		size_t last = i;
+		while (last < intervals.size() && intervals[last].chromosome == intervals[i].chromosome)
+			last++;
+		ChromosomeIntervals chromosome;
+		chromosome.first = i;
+		chromosome.count = last - i;
+		chromosome.rootLevel = buildTree(i, last - i);
+		chromosomes[intervals[i].chromosome] = chromosome;
+		i = last;
+	}
+}
+
+// Public Methods
+// =============================================
+
+// int numIntervals()
+//  Purpose:
+//		Returns the number of intervals in the index
+int IntervalIndex::numIntervals() {
+	return starts.size();
+}
+
+// int overlaps(const string& chromosome, long long start, long long end, vector<int>& intervals)
+//  Purpose:
+//		Appends the intervals overlapping positions start to end of
+//		chromosome to intervals and returns how many there were
+int IntervalIndex::overlaps(const string& chromosome, long long start, long long end, vector<int>& intervals) {
+	map<string, ChromosomeIntervals>::iterator found = chromosomes.find(chromosome);
+	if (found == chromosomes.end())
+		return 0;
+
+	// Nodes are indices from the chromosome's first interval, the query
+	// is start to end + 1 exclusive like the intervals
+	const long long* nodeStarts = starts.data() + found->second.first;
+	const long long* nodeEnds = ends.data() + found->second.first;
+	const long long* nodeMaxEnds = maxEnds.data() + found->second.first;
+	long long count = found->second.count;
+	long long queryEnd = end + 1;
+	size_t before = intervals.size();
+
+	// Stack of (node, level, whether its left subtree is done)
+	struct Node {
+		long long index;
+		int level;
+		bool leftDone;
+	};
+	Node stack[64];
+	int top = 0;
+	stack[top].level = found->second.rootLevel;
+	stack[top].index = (1LL << stack[top].level) - 1;
+	stack[top++].leftDone = false;
+	while (top > 0) {
+		Node node = stack[--top];
+
+		// Scan a small subtree in order
+		if (node.level <= SCAN_LEVEL) {
+			long long first = node.index >> node.level << node.level;
+			long long last = min(first + (1LL << (node.level + 1)) - 1, count);
+			for (long long i = first; i < last && nodeStarts[i] < queryEnd; i++)
+				if (start < nodeEnds[i])
+					intervals.push_back(found->second.first + i);
+		}
+
+		// Go left if something there ends after the query starts
+		else if (!node.leftDone) {
+			long long left = node.index - (1LL << (node.level - 1));
+			node.leftDone = true;
+			stack[top++] = node;
+			if (left >= count || nodeMaxEnds[left] > start) {
+				stack[top].index = left;
+				stack[top].level = node.level - 1;
+				stack[top++].leftDone = false;
+			}
+		}
+
+		// Then the node and its right subtree if the node starts before
+		// the query ends
+		else if (node.index < count && nodeStarts[node.index] < queryEnd) {
+			if (start < nodeEnds[node.index])
+				intervals.push_back(found->second.first + node.index);
+			stack[top].index = node.index + (1LL << (node.level - 1));
+			stack[top].level = node.level - 1;
+			stack[top++].leftDone = false;
+		}
+	}
+
+	return intervals.size() - before;
+}
+
+// string intervalName(int interval)
+//  Purpose:
+//		Returns the name of interval
+string IntervalIndex::intervalName(int interval) {
+	return names[nameIndices[interval]];
+}
+
+// Private Methods
+// =============================================
+
+// int buildTree(int first, int count)
+//  Purpose:
+//		Sets the highest end below each node of the tree of the count
+//		intervals from first and returns the level of its root.  A node
+//		missing from the right edge of the tree takes the highest end of
+//		the last interval's path.
+int IntervalIndex::buildTree(int first, int count) {
+	long long* nodeEnds = ends.data() + first;
+	long long* nodeMaxEnds = maxEnds.data() + first;
+	if (count <= 0)
+		return -1;
+
+	// Leaves
+	long long lastIndex = 0;
+	long long lastMaxEnd = 0;
+	for (long long i = 0; i < count; i += 2) {
+		lastIndex = i;
+		lastMaxEnd = nodeMaxEnds[i] = nodeEnds[i];
+	}
+
+	// Levels up from the leaves
+	int level = 1;
+	for (; (1LL << level) <= count; level++) {
+		long long half = 1LL << (level - 1);
+		for (long long i = (half << 1) - 1; i < count; i += half << 2) {
+			long long leftMax = nodeMaxEnds[i - half];
+			long long rightMax = i + half < count ? nodeMaxEnds[i + half] : lastMaxEnd;
+			nodeMaxEnds[i] = max(nodeEnds[i], max(leftMax, rightMax));
+		}
+		lastIndex = (lastIndex >> level & 1) ? lastIndex - half : lastIndex + half;
+		if (lastIndex < count && nodeMaxEnds[lastIndex] > lastMaxEnd)
+			lastMaxEnd = nodeMaxEnds[lastIndex];
+	}
+	return level - 1;
+}
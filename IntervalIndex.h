@@ -0,0 +1,92 @@
+/*
+ * IntervalIndex.h
+ *
+ *	This is the header file for the IntervalIndex object. An
+ *  IntervalIndex holds the annotation intervals of a BED file (genes,
+ *  known CNV regions) and finds the intervals overlapping a segment.
+ *
+ *	The intervals of each chromosome are sorted by start in flat arrays
+ *  and read as an implicit interval tree: the interval at index i is a
+ *  node at the level given by the trailing one bits of i, the leaves at
+ *  the even indices, and each node keeps the highest end below it.  A
+ *  query walks down from the root, skipping the subtrees that end
+ *  before it and stopping at the intervals that start after it, and
+ *  scans the small subtrees at the bottom in order.
+ *
+ *	BED format, one interval per line, extra columns ignored:
+ *		chromosome	start	end	[name]
+ *	Starts are 0-based and ends exclusive.  Lines starting with #, track
+ *  or browser are skipped.  An interval without a name is named
+ *  <<chromosome>>:<<start>>-<<end>>.
+ *
+ *	Counts positions are taken as 1-based, so the BED interval [s, e)
+ *  holds the positions s+1 to e.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef INTERVALINDEX_H
+#define INTERVALINDEX_H
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+class IntervalIndex
+{
+public:
+	// Constuctors
+	// ==============================================
+	IntervalIndex(string bedFileName);
+
+	// Public Attributes
+	// =============================================
+	string fileName;
+
+	// Public Methods
+	// =============================================
+
+	// int numIntervals()
+	//  Purpose:
+	//		Returns the number of intervals in the index
+	int numIntervals();
+
+	// int overlaps(const string& chromosome, long long start, long long end, vector<int>& intervals)
+	//  Purpose:
+	//		Appends the intervals overlapping positions start to end of
+	//		chromosome to intervals and returns how many there were
+	int overlaps(const string& chromosome, long long start, long long end, vector<int>& intervals);
+
+	// string intervalName(int interval)
+	//  Purpose:
+	//		Returns the name of interval
+	string intervalName(int interval);
+
+private:
+	// The intervals of a chromosome, from first in the arrays, and the
+	// level of the root of their tree
+	struct ChromosomeIntervals {
+		int first;
+		int count;
+		int rootLevel;
+	};
+
+	map<string, ChromosomeIntervals> chromosomes;
+
+	// Per interval, sorted by chromosome and start.  Starts and ends
+	// are 1-based positions, ends exclusive.
+	vector<long long> starts;
+	vector<long long> ends;
+	vector<long long> maxEnds;
+	vector<int> nameIndices;
+	vector<string> names;
+
+	// int buildTree(int first, int count)
+	//  Purpose:
+	//		Sets the highest end below each node of the tree of the count
+	//		intervals from first and returns the level of its root
+	int buildTree(int first, int count);
+};
+
+#endif //INTERVALINDEX_H
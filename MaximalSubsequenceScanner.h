@@ -0,0 +1,203 @@
+/*
+ * MaximalSubsequenceScanner.h
+ *
+ *	This is the header file for the MaximalSubsequenceScanner object. A
+ *  MaximalSubsequenceScanner finds all the maximal scoring subsequences
+ *  of a score track in linear time (Ruzzo and Tompa, 1999) and keeps
+ *  those scoring over the threshold as D-Segments.  It takes positions
+ *  one at a time like DSegmentScanner and can be used in its place.
+ *
+ *	Unlike the reset scan, a segment is exactly a maximal subsequence: no
+ *  subsequence containing it scores more and it starts and ends where
+ *  its score is highest.  The reset scan starts a segment after its last
+ *  reset and can cut one in two where its score drops by the threshold.
+ *
+ *	The candidates are kept on a stack in sequence order, each with the
+ *  cumulative score before its first position (left) and after its last
+ *  (right).  A positive score starts a candidate, which is merged with
+ *  the candidates before it while the nearest one with a lower left has
+ *  a lower right.  Each candidate links to that nearest lower left when
+ *  it is pushed, so the search skips the candidates between.  Once the
+ *  cumulative score falls to the lowest left on the stack no later
+ *  candidate can merge with the stack, so the candidates are final and
+ *  the stack is emptied.
+ *
+ *	The read start statistics of a segment are the difference of running
+ *  totals taken at its first and last positions.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef MAXIMALSUBSEQUENCESCANNER_H
+#define MAXIMALSUBSEQUENCESCANNER_H
+#include "DSegmentScanner.h"
+#include <vector>
+using namespace std;
+
+template <typename Score, typename Sum>
+class MaximalSubsequenceScanner
+{
+public:
+	// Constuctors
+	// ==============================================
+	MaximalSubsequenceScanner(const Score scoreTable[4], Sum scoreThreshold, long double scoreScale) {
+		for (int i = 0; i < 4; i++) {
+			scores[i] = scoreTable[i];
+			dSegmentReadStartCounts[i] = 0;
+			readStartTotals[i] = 0;
+		}
+		threshold = scoreThreshold;
+		scale = scoreScale;
+		cum = 0;
+		readStartSumTotal = 0;
+		lowestLeft = 0;
+		chromosome = -1;
+	}
+
+	// Public Attributes
+	// =============================================
+	vector<DSegment> segments;
+	int dSegmentReadStartCounts[4];
+
+	// Public Methods
+	// =============================================
+
+	// setChromosome(int chromosomeNumber)
+	//  Purpose:
+	//		Numbers the chromosome of the positions added from here on
+	void setChromosome(int chromosomeNumber) {
+		chromosome = chromosomeNumber;
+	}
+
+	// addPosition(long long position, int readStarts, int rawReadStarts)
+	//  Purpose:
+	//		Adds the score for readStarts at position to the scan
+	//	Preconditions:
+	//		readStarts - rawReadStarts capped at 3
+	void addPosition(long long position, int readStarts, int rawReadStarts) {
+		addScore(position, readStarts, rawReadStarts, scores[readStarts]);
+	}
+
+	// addScore(long long position, int readStarts, int rawReadStarts, Score score)
+	//  Purpose:
+	//		Adds score for readStarts at position to the scan, for scores
+	//		that depend on more than the read starts
+	//	Preconditions:
+	//		readStarts - rawReadStarts capped at 3
+	void addScore(long long position, int readStarts, int rawReadStarts, Score score) {
+		Candidate candidate;
+		if (score > 0) {
+			candidate.left = cum;
+			candidate.start = position;
+			for (int i = 0; i < 4; i++)
+				candidate.startTotals[i] = readStartTotals[i];
+			candidate.startSum = readStartSumTotal;
+		}
+
+		readStartTotals[readStarts]++;
+		readStartSumTotal += rawReadStarts;
+		cum += score;
+
+		if (score > 0) {
+			candidate.right = cum;
+			candidate.end = position;
+			candidate.chromosome = chromosome;
+			for (int i = 0; i < 4; i++)
+				candidate.endTotals[i] = readStartTotals[i];
+			candidate.endSum = readStartSumTotal;
+			push(candidate);
+		}
+
+		// No later candidate can merge with the stack
+		else if (!stack.empty() && cum <= lowestLeft)
+			flush();
+	}
+
+	// finish()
+	//  Purpose:
+	//		Adds the candidates left on the stack that are D-Segments
+	void finish() {
+		flush();
+	}
+
+private:
+	// A candidate subsequence.  link is the nearest candidate before it
+	// on the stack with a lower left, -1 if none.
+	struct Candidate {
+		Sum left;
+		Sum right;
+		long long start;
+		long long end;
+		int chromosome;
+		int link;
+		long long startTotals[4];
+		long long endTotals[4];
+		long long startSum;
+		long long endSum;
+	};
+
+	Score scores[4];
+	Sum threshold;
+	long double scale;
+	Sum cum;
+	long long readStartTotals[4];
+	long long readStartSumTotal;
+	vector<Candidate> stack;
+	Sum lowestLeft;
+	int chromosome;
+
+	// push(Candidate candidate)
+	//  Purpose:
+	//		Pushes candidate, merging it with the candidates before it
+	//		while the nearest one with a lower left has a lower right
+	void push(Candidate candidate) {
+		int j = (int) stack.size() - 1;
+		while (j >= 0 && stack[j].left >= candidate.left)
+			j = stack[j].link;
+		while (j >= 0 && stack[j].right < candidate.right) {
+			candidate.left = stack[j].left;
+			candidate.start = stack[j].start;
+			for (int i = 0; i < 4; i++)
+				candidate.startTotals[i] = stack[j].startTotals[i];
+			candidate.startSum = stack[j].startSum;
+			int link = stack[j].link;
+			stack.resize(j);
+			j = link;
+		}
+		candidate.link = j;
+
+		// Merging keeps the leftmost left, so the lowest left only
+		// changes with a new candidate
+		if (stack.empty() || candidate.left < lowestLeft)
+			lowestLeft = candidate.left;
+		stack.push_back(candidate);
+	}
+
+	// flush()
+	//  Purpose:
+	//		Adds the candidates on the stack that score over the threshold
+	//		as segments and empties the stack
+	void flush() {
+		for (size_t k = 0; k < stack.size(); k++) {
+			const Candidate& candidate = stack[k];
+			if (candidate.right - candidate.left < threshold)
+				continue;
+
+			DSegment segment;
+			segment.start = candidate.start;
+			segment.end = candidate.end;
+			segment.chromosome = candidate.chromosome;
+			segment.score = (candidate.right - candidate.left) / scale;
+			for (int i = 0; i < 4; i++) {
+				segment.readStartCounts[i] = (int) (candidate.endTotals[i] - candidate.startTotals[i]);
+				dSegmentReadStartCounts[i] += segment.readStartCounts[i];
+			}
+			segment.readStartSum = candidate.endSum - candidate.startSum;
+			segments.push_back(segment);
+		}
+		stack.clear();
+	}
+};
+
+#endif //MAXIMALSUBSEQUENCESCANNER_H
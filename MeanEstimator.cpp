@@ -0,0 +1,124 @@
+/*
+ * MeanEstimator.cpp
+ *
+ *	This is the cpp file for the MeanEstimator object. A MeanEstimator
+ *  estimates the mean read starts per position of the normal state from
+ *  a sample of a counts file.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "MeanEstimator.h"
+#include "CountsReader.h"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Constuctors
+// ==============================================
+MeanEstimator::MeanEstimator(int numChunks, int chunkBytes, int windowPositions) {
+	if (numChunks < 1 || chunkBytes < 1 || windowPositions < 1)
+		throw invalid_argument("mean estimation needs at least one chunk, byte and position per window");
+	chunks = numChunks;
+	chunkSize = chunkBytes;
+	windowSize = windowPositions;
+	sampledPositions = 0;
+	sampledWindows = 0;
+	usedWindows = 0;
+}
+
+// Public Methods
+// =============================================
+
+// double estimateNormalMean(string countsFileName)
+//  Purpose:
+//		Returns the median window mean of a sample of the counts in
+//		countsFileName
+//	Postconditions:
+//		sampledPositions, sampledWindows, usedWindows - set
+double MeanEstimator::estimateNormalMean(string countsFileName) {
+	int fileDescriptor = open(countsFileName.c_str(), O_RDONLY);
+	struct stat status;
+	if (fileDescriptor < 0 || fstat(fileDescriptor, &status) < 0)
+		throw runtime_error("could not open " + countsFileName);
+	long long fileSize = status.st_size;
+
+	sampledPositions = 0;
+	sampledWindows = 0;
+	usedWindows = 0;
+	vector<double> windowMeans;
+	CountsBatch batch;
+	for (int k = 0; k < chunks; k++) {
+
+		// Chunks follow each other in a small file and are spread over
+		// the file otherwise
+		long long offset = (long long) k * chunkSize;
+		if (fileSize > (long long) chunks * chunkSize)
+			offset = chunks == 1 ? 0 : (fileSize - chunkSize) / (chunks - 1) * k;
+		if (offset >= fileSize)
+			break;
+
+		batch.text.resize(chunkSize);
+		ssize_t bytes = pread(fileDescriptor, batch.text.data(), chunkSize, offset);
+		if (bytes < 0) {
+			close(fileDescriptor);
+			throw runtime_error("could not read " + countsFileName);
+		}
+		batch.text.resize(bytes);
+
+		// Keep whole lines only, the first line is whole at the start of
+		// the file and the last at the end
+		const char* text = batch.text.data();
+		size_t first = 0;
+		if (offset > 0) {
+			const char* newline = (const char*) memchr(text, '\n', bytes);
+			first = newline == NULL ? bytes : newline - text + 1;
+		}
+		size_t last = bytes;
+		if (offset + bytes < fileSize) {
+			while (last > first && text[last - 1] != '\n')
+				last--;
+		}
+		batch.text.erase(batch.text.begin() + last, batch.text.end());
+		batch.text.erase(batch.text.begin(), batch.text.begin() + first);
+		batch.parse();
+
+		// Window means, a window ends early at the end of a chromosome run
+		size_t numRecords = batch.positions.size();
+		sampledPositions += numRecords;
+		for (size_t r = 0; r < batch.chromosomes.size(); r++) {
+			size_t runEnd = r + 1 < batch.chromosomes.size() ? batch.chromosomes[r + 1].firstRecord : numRecords;
+			for (size_t start = batch.chromosomes[r].firstRecord; start < runEnd; start += windowSize) {
+				size_t end = min(start + windowSize, runEnd);
+				long long readStarts = 0;
+				for (size_t i = start; i < end; i++)
+					readStarts += batch.rawReadStarts[i];
+
+				// Short windows at the ends of a chunk are too noisy to use
+				sampledWindows++;
+				if (end - start < (size_t) windowSize / 2 || readStarts == 0)
+					continue;
+				windowMeans.push_back((double) readStarts / (end - start));
+			}
+		}
+	}
+	close(fileDescriptor);
+
+	usedWindows = windowMeans.size();
+	if (windowMeans.empty())
+		throw runtime_error("no read starts in the sample of " + countsFileName + " to estimate the normal mean from");
+
+	// Median of the window means
+	size_t middle = windowMeans.size() / 2;
+	nth_element(windowMeans.begin(), windowMeans.begin() + middle, windowMeans.end());
+	double median = windowMeans[middle];
+	if (windowMeans.size() % 2 == 0) {
+		double below = *max_element(windowMeans.begin(), windowMeans.begin() + middle);
+		median = (median + below) / 2;
+	}
+	return median;
+}
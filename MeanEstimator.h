@@ -0,0 +1,55 @@
+/*
+ * MeanEstimator.h
+ *
+ *	This is the header file for the MeanEstimator object. A MeanEstimator
+ *  estimates the mean read starts per position of the normal state from
+ *  a sample of a counts file, without reading the whole file.  Chunks
+ *  spread evenly over the file are read and parsed, the records are cut
+ *  into windows of consecutive positions and the estimate is the median
+ *  of the window means, so copy number changes and unmappable stretches
+ *  (windows without read starts, which are left out) do not pull it
+ *  away from the normal state.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef MEANESTIMATOR_H
+#define MEANESTIMATOR_H
+#include <string>
+using namespace std;
+
+class MeanEstimator
+{
+public:
+	// Constuctors
+	// ==============================================
+	MeanEstimator(int numChunks, int chunkBytes, int windowPositions);
+
+	// Public Attributes
+	// =============================================
+
+	// Positions, windows and windows with read starts in the last sample
+	long long sampledPositions;
+	int sampledWindows;
+	int usedWindows;
+
+	// Public Methods
+	// =============================================
+
+	// double estimateNormalMean(string countsFileName)
+	//  Purpose:
+	//		Returns the median window mean of a sample of the counts in
+	//		countsFileName.  A file no bigger than the sample is read whole.
+	//		Throws runtime_error if no window has read starts.
+	//	Postconditions:
+	//		sampledPositions, sampledWindows, usedWindows - set
+	double estimateNormalMean(string countsFileName);
+
+private:
+	int chunks;
+	int chunkSize;
+	int windowSize;
+};
+
+#endif //MEANESTIMATOR_H
@@ -0,0 +1,282 @@
+/*
+ * NullSimulator.cpp
+ *
+ *	This is the cpp file for the NullSimulator object. A NullSimulator
+ *  scans simulated null sequences of read start codes to find how high a
+ *  D-Segment score gets by chance.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "NullSimulator.h"
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <queue>
+#include <thread>
+
+// Random number generation
+// =============================================
+
+// uint64_t splitMix(uint64_t& state)
+//  Purpose:
+//		Returns the next value of a splitmix64 stream, used to seed the
+//		per simulation generators
+static uint64_t splitMix(uint64_t& state) {
+	uint64_t value = (state += 0x9E3779B97F4A7C15ULL);
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	return value ^ (value >> 31);
+}
+
+static inline uint64_t rotate(uint64_t value, int bits) {
+	return (value << bits) | (value >> (64 - bits));
+}
+
+// Independent xoshiro256** generators stored lane by lane so the
+// compiler can step all lanes with vector instructions
+struct RandomLanes {
+	static const int LANES = 4;
+	uint64_t s0[LANES];
+	uint64_t s1[LANES];
+	uint64_t s2[LANES];
+	uint64_t s3[LANES];
+
+	RandomLanes(uint64_t seed) {
+		for (int i = 0; i < LANES; i++) {
+			s0[i] = splitMix(seed);
+			s1[i] = splitMix(seed);
+			s2[i] = splitMix(seed);
+			s3[i] = splitMix(seed);
+		}
+	}
+
+	void next(uint64_t values[LANES]) {
+		for (int i = 0; i < LANES; i++) {
+			values[i] = rotate(s1[i] * 5, 7) * 9;
+			uint64_t shifted = s1[i] << 17;
+			s2[i] ^= s0[i];
+			s3[i] ^= s1[i];
+			s1[i] ^= s2[i];
+			s0[i] ^= s3[i];
+			s2[i] ^= shifted;
+			s3[i] = rotate(s3[i], 45);
+		}
+	}
+};
+
+// Number of codes drawn at a time
+static const int CODE_BLOCK = 4096;
+
+// Number of pieces a long calibration sequence is split into, fixed so
+// the result does not depend on the number of threads
+static const int CALIBRATION_PIECES = 64;
+
+// fillCodes(RandomLanes& random, const uint32_t thresholds[3], unsigned char codes[CODE_BLOCK])
+//  Purpose:
+//		Fills codes with CODE_BLOCK codes.  Each 64 bit random value gives
+//		two codes, a 32 bit half r gives (r >= t0) + (r >= t1) + (r >= t2).
+static void fillCodes(RandomLanes& random, const uint32_t thresholds[3], unsigned char codes[CODE_BLOCK]) {
+	uint64_t values[RandomLanes::LANES];
+	for (int i = 0; i < CODE_BLOCK; i += 2 * RandomLanes::LANES) {
+		random.next(values);
+		for (int j = 0; j < 2 * RandomLanes::LANES; j++) {
+			uint32_t half = (uint32_t) (values[j >> 1] >> (32 * (j & 1)));
+			codes[i + j] =
+				(half >= thresholds[0]) + (half >= thresholds[1]) + (half >= thresholds[2]);
+		}
+	}
+}
+
+// Constuctors
+// ==============================================
+NullSimulator::NullSimulator(const long double scores[4], const long double codeProbabilities[4]) {
+	for (int i = 0; i < 4; i++)
+		scoreTable[i] = scores[i];
+
+	// Cumulative code probabilities scaled to 32 bits
+	long double total = 0;
+	for (int i = 0; i < 4; i++)
+		total += codeProbabilities[i];
+	long double cumulative = 0;
+	for (int i = 0; i < 3; i++) {
+		cumulative += codeProbabilities[i] / total;
+		long double scaled = roundl(cumulative * 4294967296.0L);
+		codeThresholds[i] = scaled >= 4294967295.0L ? 0xFFFFFFFFU : (uint32_t) scaled;
+	}
+}
+
+// Public Methods
+// =============================================
+
+// simulateMaxScores(long long length, int simulations, uint64_t seed)
+//  Purpose:
+//		Scans simulations null sequences of length positions and records
+//		the maximum segment score of each
+//	Postconditions:
+//		maxScores - sorted maximum score of each simulation
+void NullSimulator::simulateMaxScores(long long length, int simulations, uint64_t seed) {
+	maxScores.assign(simulations, 0);
+	runThreads(&NullSimulator::simulateMaxScoreRange, length, simulations, seed);
+	sort(maxScores.begin(), maxScores.end());
+}
+
+// simulateTopExcursions(long long length, int count, uint64_t seed)
+//  Purpose:
+//		Scans a null sequence of length positions and records the count
+//		highest excursion scores.  An excursion is a run of the cumulative
+//		score above zero, so its height is the score of the segment a scan
+//		with a threshold below that height would call, unless the scan
+//		splits it where the score falls the threshold below its maximum.
+//	Postconditions:
+//		excursionHeights - highest excursion scores in decreasing order
+void NullSimulator::simulateTopExcursions(long long length, int count, uint64_t seed) {
+	topExcursionCount = count;
+	pieceExcursions.assign(CALIBRATION_PIECES, vector<double>());
+	runThreads(&NullSimulator::simulateExcursionRange, length, CALIBRATION_PIECES, seed);
+
+	// Merge the pieces and keep the highest
+	excursionHeights.clear();
+	for (int i = 0; i < CALIBRATION_PIECES; i++)
+		excursionHeights.insert(excursionHeights.end(), pieceExcursions[i].begin(), pieceExcursions[i].end());
+	sort(excursionHeights.begin(), excursionHeights.end(), greater<double>());
+	if ((int) excursionHeights.size() > count)
+		excursionHeights.resize(count);
+	pieceExcursions.clear();
+}
+
+// double pValue(long double score)
+//  Purpose:
+//		Returns the empirical probability that the maximum segment score
+//		of a null sequence is at least score, (1 + #null >= score) / (1 + #null)
+double NullSimulator::pValue(long double score) {
+	size_t atLeast = maxScores.end() - lower_bound(maxScores.begin(), maxScores.end(), (double) score);
+	return (double) (1 + atLeast) / (double) (1 + maxScores.size());
+}
+
+// double maxScoreQuantile(double quantile)
+//  Purpose:
+//		Returns the quantile of the simulated maximum scores
+double NullSimulator::maxScoreQuantile(double quantile) {
+	if (maxScores.empty())
+		return 0;
+	size_t index = (size_t) (quantile * (maxScores.size() - 1) + 0.5);
+	return maxScores[index];
+}
+
+// Public Class Methods
+// =============================================
+
+// int defaultThreads()
+//  Purpose:
+//		Returns the number of threads to simulate with
+int NullSimulator::defaultThreads() {
+	int threads = thread::hardware_concurrency();
+	return threads < 1 ? 1 : threads;
+}
+
+// Private Methods
+// =============================================
+
+// runThreads(RangeMethod method, long long length, int tasks, uint64_t seed)
+//  Purpose:
+//		Runs method on all cores, each thread taking every numThreads'th
+//		of the tasks
+void NullSimulator::runThreads(RangeMethod method, long long length, int tasks, uint64_t seed) {
+	int numThreads = defaultThreads();
+	if (numThreads > tasks)
+		numThreads = tasks;
+	vector<thread> threads;
+	for (int i = 0; i < numThreads; i++)
+		threads.push_back(thread(method, this, length, tasks, i, numThreads, seed));
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+// double maxScore(long long length, uint64_t seed)
+//  Purpose:
+//		Scans one null sequence and returns its maximum segment score
+double NullSimulator::maxScore(long long length, uint64_t seed) {
+	RandomLanes random(seed);
+	unsigned char codes[CODE_BLOCK];
+	double cum = 0;
+	double max = 0;
+
+	for (long long done = 0; done < length; done += CODE_BLOCK) {
+		fillCodes(random, codeThresholds, codes);
+		int count = (length - done) < CODE_BLOCK ? (int) (length - done) : CODE_BLOCK;
+		for (int i = 0; i < count; i++) {
+			// The highest scoring segment is the highest cumulative score
+			// since the last time it dropped to zero
+			cum += scoreTable[codes[i]];
+			if (cum < 0)
+				cum = 0;
+			if (cum > max)
+				max = cum;
+		}
+	}
+
+	return max;
+}
+
+// topExcursions(long long length, uint64_t seed, vector<double>& heights)
+//  Purpose:
+//		Scans one null sequence and fills heights with its
+//		topExcursionCount highest excursion scores
+void NullSimulator::topExcursions(long long length, uint64_t seed, vector<double>& heights) {
+	RandomLanes random(seed);
+	unsigned char codes[CODE_BLOCK];
+	priority_queue<double, vector<double>, greater<double> > top;
+	double cum = 0;
+	double max = 0;
+
+	for (long long done = 0; done < length; done += CODE_BLOCK) {
+		fillCodes(random, codeThresholds, codes);
+		int count = (length - done) < CODE_BLOCK ? (int) (length - done) : CODE_BLOCK;
+		for (int i = 0; i < count; i++) {
+			cum += scoreTable[codes[i]];
+			if (cum > max)
+				max = cum;
+
+			// End of the excursion, keep its height if it is one of the highest
+			if (cum <= 0) {
+				if (max > 0 && ((int) top.size() < topExcursionCount || max > top.top())) {
+					top.push(max);
+					if ((int) top.size() > topExcursionCount)
+						top.pop();
+				}
+				cum = 0;
+				max = 0;
+			}
+		}
+	}
+	if (max > 0)
+		top.push(max);
+
+	heights.clear();
+	while (!top.empty()) {
+		heights.push_back(top.top());
+		top.pop();
+	}
+}
+
+// simulateMaxScoreRange(long long length, int tasks, int first, int step, uint64_t seed)
+//  Purpose:
+//		Thread body.  Runs simulations first, first + step, ...
+void NullSimulator::simulateMaxScoreRange(long long length, int tasks, int first, int step, uint64_t seed) {
+	for (int i = first; i < tasks; i += step)
+		maxScores[i] = maxScore(length, seed ^ (0xD1B54A32D192ED03ULL * (i + 1)));
+}
+
+// simulateExcursionRange(long long length, int tasks, int first, int step, uint64_t seed)
+//  Purpose:
+//		Thread body.  Scans pieces first, first + step, ... of a null
+//		sequence of length positions split into tasks pieces
+void NullSimulator::simulateExcursionRange(long long length, int tasks, int first, int step, uint64_t seed) {
+	for (int i = first; i < tasks; i += step) {
+		long long pieceLength = length / tasks;
+		if (i == tasks - 1)
+			pieceLength += length % tasks;
+		topExcursions(pieceLength, seed ^ (0xD1B54A32D192ED03ULL * (i + 1)), pieceExcursions[i]);
+	}
+}
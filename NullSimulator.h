@@ -0,0 +1,123 @@
+/*
+ * NullSimulator.h
+ *
+ *	This is the header file for the NullSimulator object. A NullSimulator
+ *  scans simulated null sequences of read start codes to find how high a
+ *  D-Segment score gets by chance.  Codes are drawn independently from a
+ *  fixed distribution: the observed read start frequencies (the limit of
+ *  permuting the observed sequence) or the normal state emissions of the
+ *  HMM.
+ *
+ *	Codes are drawn a block at a time from four interleaved xoshiro256**
+ *  generators so the generator vectorizes.  Simulations are spread over
+ *  all cores.  Each simulation draws from its
+ *  own random stream seeded from its index, so the results do not depend
+ *  on the number of threads.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef NULLSIMULATOR_H
+#define NULLSIMULATOR_H
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+// Distribution the null sequence codes are drawn from
+enum NullModel {
+	PERMUTED_NULL,
+	HMM_NULL
+};
+
+class NullSimulator
+{
+public:
+	// Constuctors
+	// ==============================================
+	NullSimulator(const long double scores[4], const long double codeProbabilities[4]);
+
+	// Public Methods
+	// =============================================
+
+	// simulateMaxScores(long long length, int simulations, uint64_t seed)
+	//  Purpose:
+	//		Scans simulations null sequences of length positions and records
+	//		the maximum segment score of each
+	//	Postconditions:
+	//		maxScores - sorted maximum score of each simulation
+	void simulateMaxScores(long long length, int simulations, uint64_t seed);
+
+	// simulateTopExcursions(long long length, int count, uint64_t seed)
+	//  Purpose:
+	//		Scans a null sequence of length positions and records the count
+	//		highest excursion scores.  An excursion is a run of the cumulative
+	//		score above zero, so its height is the score of the segment a scan
+	//		with a threshold below that height would call, unless the scan
+	//		splits it where the score falls the threshold below its maximum.
+	//	Postconditions:
+	//		excursionHeights - highest excursion scores in decreasing order
+	void simulateTopExcursions(long long length, int count, uint64_t seed);
+
+	// double pValue(long double score)
+	//  Purpose:
+	//		Returns the empirical probability that the maximum segment score
+	//		of a null sequence is at least score, (1 + #null >= score) / (1 + #null)
+	double pValue(long double score);
+
+	// double maxScoreQuantile(double quantile)
+	//  Purpose:
+	//		Returns the quantile of the simulated maximum scores
+	double maxScoreQuantile(double quantile);
+
+	// Public Attributes
+	// =============================================
+	vector<double> maxScores;
+	vector<double> excursionHeights;
+
+	// Public Class Methods
+	// =============================================
+
+	// int defaultThreads()
+	//  Purpose:
+	//		Returns the number of threads to simulate with
+	static int defaultThreads();
+
+private:
+	typedef void (NullSimulator::*RangeMethod)(long long, int, int, int, uint64_t);
+
+	double scoreTable[4];
+	uint32_t codeThresholds[3];
+	int topExcursionCount;
+	vector<vector<double> > pieceExcursions;
+
+	// runThreads(RangeMethod method, long long length, int tasks, uint64_t seed)
+	//  Purpose:
+	//		Runs method on all cores, each thread taking every numThreads'th
+	//		of the tasks
+	void runThreads(RangeMethod method, long long length, int tasks, uint64_t seed);
+
+	// double maxScore(long long length, uint64_t seed)
+	//  Purpose:
+	//		Scans one null sequence and returns its maximum segment score
+	double maxScore(long long length, uint64_t seed);
+
+	// topExcursions(long long length, uint64_t seed, vector<double>& heights)
+	//  Purpose:
+	//		Scans one null sequence and fills heights with its
+	//		topExcursionCount highest excursion scores
+	void topExcursions(long long length, uint64_t seed, vector<double>& heights);
+
+	// simulateMaxScoreRange(long long length, int tasks, int first, int step, uint64_t seed)
+	//  Purpose:
+	//		Thread body.  Runs simulations first, first + step, ...
+	void simulateMaxScoreRange(long long length, int tasks, int first, int step, uint64_t seed);
+
+	// simulateExcursionRange(long long length, int tasks, int first, int step, uint64_t seed)
+	//  Purpose:
+	//		Thread body.  Scans pieces first, first + step, ... of a null
+	//		sequence of length positions split into tasks pieces
+	void simulateExcursionRange(long long length, int tasks, int first, int step, uint64_t seed);
+};
+
+#endif //NULLSIMULATOR_H
@@ -0,0 +1,178 @@
+/*
+ * ResultCache.cpp
+ *
+ *	This is the cpp file for the ResultCache object. A ResultCache keeps
+ *  the scan of each chromosome of a counts file in a cache directory,
+ *  keyed by a hash of the chromosome's lines and of the model.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "ResultCache.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint64_t HASH_MULTIPLIER = 0x9e3779b97f4a7c15ULL;
+
+// Constuctors
+// ==============================================
+ResultCache::ResultCache(string cacheDirectory, const string& modelKey) {
+	directory = cacheDirectory;
+	modelHash = hash(modelKey.data(), modelKey.size(), 0);
+
+	if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST)
+		throw runtime_error("could not create result cache directory " + directory);
+}
+
+// Public Methods
+// =============================================
+
+// string entryFileName(const CountsChromosome& chromosome)
+//  Purpose:
+//		Returns the name of the cache entry for chromosome
+string ResultCache::entryFileName(const CountsChromosome& chromosome) {
+	char name[40];
+	snprintf(name, sizeof(name), "%016llx-%016llx.shard",
+		(unsigned long long) modelHash, (unsigned long long) chromosome.hash);
+	return directory + "/" + name;
+}
+
+// bool contains(const CountsChromosome& chromosome)
+//  Purpose:
+//		Returns true if the cache has an entry for chromosome
+bool ResultCache::contains(const CountsChromosome& chromosome) {
+	struct stat status;
+	return stat(entryFileName(chromosome).c_str(), &status) == 0;
+}
+
+// store(const CountsChromosome& chromosome, ShardFile& shard)
+//  Purpose:
+//		Writes shard as the entry for chromosome under a temporary name
+//		and renames it
+void ResultCache::store(const CountsChromosome& chromosome, ShardFile& shard) {
+	string fileName = entryFileName(chromosome);
+	string temporaryFileName = fileName + "." + to_string(getpid()) + ".tmp";
+	shard.write(temporaryFileName);
+	if (rename(temporaryFileName.c_str(), fileName.c_str()) < 0) {
+		unlink(temporaryFileName.c_str());
+		throw runtime_error("could not store result cache entry " + fileName);
+	}
+}
+
+// Public Class Methods
+// =============================================
+
+// bool hashChromosomes(string countsFileName, vector<CountsChromosome>& chromosomes)
+//  Purpose:
+//		Hashes the lines of each chromosome of the counts file, in file
+//		order.  Returns false if a chromosome's lines are not all
+//		together.
+bool ResultCache::hashChromosomes(string countsFileName, vector<CountsChromosome>& chromosomes) {
+	chromosomes.clear();
+
+	int fileDescriptor = open(countsFileName.c_str(), O_RDONLY);
+	struct stat status;
+	if (fileDescriptor < 0 || fstat(fileDescriptor, &status) < 0)
+		throw runtime_error("could not open " + countsFileName);
+	size_t size = status.st_size;
+	if (size == 0) {
+		close(fileDescriptor);
+		return true;
+	}
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fileDescriptor, 0);
+	close(fileDescriptor);
+	if (mapping == MAP_FAILED)
+		throw runtime_error("could not map " + countsFileName);
+
+	// Find where the chromosome changes, only the start of each line is
+	// compared to the current chromosome.  A line without a tab stays
+	// with the chromosome before it.
+	const char* data = (const char*) mapping;
+	const char* end = data + size;
+	const char* chromosomeStart = data;
+	string name;
+	bool together = true;
+	for (const char* line = data; line < end; ) {
+		const char* next = (const char*) memchr(line, '\n', end - line);
+		next = next == NULL ? end : next + 1;
+
+		bool sameChromosome = (size_t) (next - line) > name.size()
+			&& line[name.size()] == '\t' && memcmp(line, name.data(), name.size()) == 0;
+		const char* tab = sameChromosome ? NULL : (const char*) memchr(line, '\t', next - line);
+		if (tab != NULL) {
+			if (line > chromosomeStart) {
+				CountsChromosome chromosome;
+				chromosome.name = name;
+				chromosome.bytes = line - chromosomeStart;
+				chromosome.hash = hash(chromosomeStart, line - chromosomeStart, 0);
+				chromosomes.push_back(chromosome);
+			}
+			chromosomeStart = line;
+			name.assign(line, tab - line);
+			for (size_t i = 0; i < chromosomes.size(); i++)
+				if (chromosomes[i].name == name)
+					together = false;
+		}
+		line = next;
+	}
+	if (end > chromosomeStart) {
+		CountsChromosome chromosome;
+		chromosome.name = name;
+		chromosome.bytes = end - chromosomeStart;
+		chromosome.hash = hash(chromosomeStart, end - chromosomeStart, 0);
+		chromosomes.push_back(chromosome);
+	}
+
+	munmap(mapping, size);
+	return together;
+}
+
+// uint64_t hash(const char* data, size_t size, uint64_t seed)
+//  Purpose:
+//		Returns a 64-bit hash of size bytes of data.  Four words are
+//		hashed independently at a time so the multiplies overlap.
+uint64_t ResultCache::hash(const char* data, size_t size, uint64_t seed) {
+	uint64_t h[4];
+	for (int j = 0; j < 4; j++)
+		h[j] = (seed + j) ^ (size * HASH_MULTIPLIER);
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		for (int j = 0; j < 4; j++) {
+			uint64_t word;
+			memcpy(&word, data + i + j * 8, 8);
+			h[j] = (h[j] ^ word) * HASH_MULTIPLIER;
+			h[j] ^= h[j] >> 32;
+		}
+	}
+
+	// The last few words and bytes
+	uint64_t result = h[0];
+	for (int j = 1; j < 4; j++)
+		result = (result ^ h[j]) * HASH_MULTIPLIER;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		result = (result ^ word) * HASH_MULTIPLIER;
+		result ^= result >> 32;
+	}
+	uint64_t word = 0;
+	memcpy(&word, data + i, size - i);
+	result = (result ^ word) * HASH_MULTIPLIER;
+
+	// Mix the bits
+	result ^= result >> 33;
+	result *= 0xff51afd7ed558ccdULL;
+	result ^= result >> 33;
+	result *= 0xc4ceb9fe1a85ec53ULL;
+	result ^= result >> 33;
+	return result;
+}
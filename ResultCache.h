@@ -0,0 +1,82 @@
+/*
+ * ResultCache.h
+ *
+ *	This is the header file for the ResultCache object. A ResultCache
+ *  keeps the scan of each chromosome of a counts file in a cache
+ *  directory, keyed by a hash of the chromosome's lines and of the model
+ *  it was scanned with, so rerunning a job only scans the chromosomes
+ *  that changed.  Each entry is its chromosome scanned as a shard (see
+ *  ShardFile.h), so the entries of a file merge into exactly the result
+ *  of a serial scan.
+ *
+ *		entry file name:
+ *			<<directory>>/<<model hash>>-<<chromosome hash>>.shard
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+#include "ShardFile.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+// A chromosome of a counts file and the hash of its lines
+struct CountsChromosome {
+	string name;
+	uint64_t hash;
+	long long bytes;
+};
+
+class ResultCache
+{
+public:
+	// Constuctors
+	// ==============================================
+	ResultCache(string cacheDirectory, const string& modelKey);
+
+	// Public Attributes
+	// =============================================
+	string directory;
+	uint64_t modelHash;
+
+	// Public Methods
+	// =============================================
+
+	// string entryFileName(const CountsChromosome& chromosome)
+	//  Purpose:
+	//		Returns the name of the cache entry for chromosome
+	string entryFileName(const CountsChromosome& chromosome);
+
+	// bool contains(const CountsChromosome& chromosome)
+	//  Purpose:
+	//		Returns true if the cache has an entry for chromosome
+	bool contains(const CountsChromosome& chromosome);
+
+	// store(const CountsChromosome& chromosome, ShardFile& shard)
+	//  Purpose:
+	//		Writes shard as the entry for chromosome.  The entry is written
+	//		under a temporary name and renamed so a reader never sees part
+	//		of one.
+	void store(const CountsChromosome& chromosome, ShardFile& shard);
+
+	// Public Class Methods
+	// =============================================
+
+	// bool hashChromosomes(string countsFileName, vector<CountsChromosome>& chromosomes)
+	//  Purpose:
+	//		Hashes the lines of each chromosome of the counts file, in file
+	//		order.  Returns false if a chromosome's lines are not all
+	//		together, the entries could then not be merged in file order.
+	static bool hashChromosomes(string countsFileName, vector<CountsChromosome>& chromosomes);
+
+	// uint64_t hash(const char* data, size_t size, uint64_t seed)
+	//  Purpose:
+	//		Returns a 64-bit hash of size bytes of data
+	static uint64_t hash(const char* data, size_t size, uint64_t seed);
+};
+
+#endif //RESULTCACHE_H
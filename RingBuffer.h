@@ -0,0 +1,74 @@
+/*
+ * RingBuffer.h
+ *
+ *	This is the header file for the RingBuffer object. A RingBuffer is a
+ *  bounded lock-free queue for passing items from exactly one producer
+ *  thread to exactly one consumer thread.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+using namespace std;
+
+template <typename T>
+class RingBuffer
+{
+public:
+	// Constuctors
+	// ==============================================
+	RingBuffer(size_t minimumCapacity) {
+		size_t capacity = 2;
+		while (capacity < minimumCapacity)
+			capacity *= 2;
+		items.resize(capacity);
+		mask = capacity - 1;
+		head.store(0);
+		tail.store(0);
+	}
+
+	// Public Methods
+	// =============================================
+
+	// bool push(const T& item)
+	//  Purpose:
+	//		Adds item to the back of the buffer.  Returns false if the
+	//		buffer is full.  Only call from the producer thread.
+	bool push(const T& item) {
+		size_t currentTail = tail.load(memory_order_relaxed);
+		if (currentTail - head.load(memory_order_acquire) > mask)
+			return false;
+		items[currentTail & mask] = item;
+		tail.store(currentTail + 1, memory_order_release);
+		return true;
+	}
+
+	// bool pop(T& item)
+	//  Purpose:
+	//		Removes the front of the buffer into item.  Returns false if the
+	//		buffer is empty.  Only call from the consumer thread.
+	bool pop(T& item) {
+		size_t currentHead = head.load(memory_order_relaxed);
+		if (currentHead == tail.load(memory_order_acquire))
+			return false;
+		item = items[currentHead & mask];
+		head.store(currentHead + 1, memory_order_release);
+		return true;
+	}
+
+private:
+	vector<T> items;
+	size_t mask;
+
+	// Keep the indexes on their own cache lines so the producer and
+	// consumer do not contend
+	alignas(64) atomic<size_t> head;
+	alignas(64) atomic<size_t> tail;
+};
+
+#endif //RINGBUFFER_H
@@ -0,0 +1,262 @@
+/*
+ * ScanProgress.cpp
+ *
+ *	This is the cpp file for the ScanProgress object. A ScanProgress
+ *  follows a scan, reports it on stderr and stops it when it is cancelled
+ *  or runs out of its time budget.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "ScanProgress.h"
+#include <iostream>
+#include <signal.h>
+#include <sstream>
+#include <stdio.h>
+
+// Set by the signal handlers, read by the scans and reporters
+static volatile sig_atomic_t reportSignalled = 0;
+static volatile sig_atomic_t cancelSignalled = 0;
+
+// Handles SIGUSR1
+static void reportSignalHandler(int) {
+	reportSignalled = 1;
+}
+
+// Handles SIGINT and SIGTERM, the second one ends the process
+static void cancelSignalHandler(int signalNumber) {
+	cancelSignalled = 1;
+	signal(signalNumber, SIG_DFL);
+}
+
+// Constuctors
+// ==============================================
+ScanProgress::ScanProgress(double reportSeconds, double budgetSeconds) {
+	reportInterval = reportSeconds;
+	timeBudget = budgetSeconds;
+	startTime = chrono::steady_clock::now();
+	records.store(0);
+	bytes.store(0);
+	totalBytes.store(0);
+	stopStatus.store(SCAN_COMPLETE);
+	lastPosition = 0;
+	reporterStopping = false;
+	reporter = thread(&ScanProgress::reportLoop, this);
+}
+
+// Destructor
+// =============================================
+ScanProgress::~ScanProgress() {
+	{
+		lock_guard<mutex> lock(reporterMutex);
+		reporterStopping = true;
+	}
+	reporterWake.notify_all();
+	reporter.join();
+}
+
+// Public Methods
+// =============================================
+
+// addTotalBytes(long long bytes)
+//  Purpose:
+//		Adds the size of an input to the bytes expected
+void ScanProgress::addTotalBytes(long long inputBytes) {
+	totalBytes.fetch_add(inputBytes, memory_order_relaxed);
+}
+
+// addBatch(long long records, long long bytes, const vector<ChromosomeRun>& chromosomes, long long lastPosition)
+//  Purpose:
+//		Counts a batch handed out by a reader, with the chromosome runs
+//		in it and the position of its last record
+void ScanProgress::addBatch(long long batchRecords, long long batchBytes, const vector<ChromosomeRun>& runs, long long batchLastPosition) {
+	records.fetch_add(batchRecords, memory_order_relaxed);
+	bytes.fetch_add(batchBytes, memory_order_relaxed);
+	if (runs.empty())
+		return;
+
+	lock_guard<mutex> lock(chromosomesMutex);
+	for (size_t r = 0; r < runs.size(); r++)
+		if (chromosomes.empty() || chromosomes.back() != runs[r].name)
+			chromosomes.push_back(runs[r].name);
+	lastPosition = batchLastPosition;
+}
+
+// cancel()
+//  Purpose:
+//		Asks the scan to stop
+void ScanProgress::cancel() {
+	int running = SCAN_COMPLETE;
+	stopStatus.compare_exchange_strong(running, SCAN_CANCELLED);
+}
+
+// bool stopRequested()
+//  Purpose:
+//		Returns true if the scan should stop, because it was cancelled or
+//		is over its time budget
+bool ScanProgress::stopRequested() {
+	if (stopStatus.load(memory_order_relaxed) != SCAN_COMPLETE)
+		return true;
+	if (cancelSignalled)
+		cancel();
+	else if (timeBudget > 0 && elapsedSeconds() >= timeBudget) {
+		int running = SCAN_COMPLETE;
+		stopStatus.compare_exchange_strong(running, SCAN_OUT_OF_TIME);
+	}
+	return stopStatus.load(memory_order_relaxed) != SCAN_COMPLETE;
+}
+
+// ScanStatus status()
+//  Purpose:
+//		Returns why the scan stopped, SCAN_COMPLETE if it did not
+ScanStatus ScanProgress::status() {
+	return (ScanStatus) stopStatus.load();
+}
+
+// bool chromosomeComplete(const string& chromosome)
+//  Purpose:
+//		Returns true if chromosome was read whole: the scan went on past
+//		it or was not stopped
+bool ScanProgress::chromosomeComplete(const string& chromosome) {
+	if (status() == SCAN_COMPLETE)
+		return true;
+
+	lock_guard<mutex> lock(chromosomesMutex);
+	for (size_t i = 0; i + 1 < chromosomes.size(); i++)
+		if (chromosomes[i] == chromosome)
+			return true;
+	return false;
+}
+
+// string reportString()
+//  Purpose:
+//		Returns the progress report line
+//
+//		format:
+//			progress: <<chromosome>>:<<position>>, <<records>> records, <<MB>> of <<MB>> MB (<<percent>>%), <<rate>> records/s, <<time>> left
+string ScanProgress::reportString() {
+	double seconds = elapsedSeconds();
+	long long recordsRead = records.load(memory_order_relaxed);
+	long long bytesRead = bytes.load(memory_order_relaxed);
+	long long bytesExpected = totalBytes.load(memory_order_relaxed);
+
+	stringstream ss;
+	ss << "progress: ";
+	{
+		lock_guard<mutex> lock(chromosomesMutex);
+		if (!chromosomes.empty())
+			ss << chromosomes.back() << ":" << lastPosition << ", ";
+	}
+	ss << recordsRead << " records, ";
+
+	char text[64];
+	snprintf(text, sizeof(text), "%.1f", bytesRead / 1048576.0);
+	ss << text;
+	if (bytesExpected > 0) {
+		snprintf(text, sizeof(text), " of %.1f MB (%.1f%%)", bytesExpected / 1048576.0, 100.0 * bytesRead / bytesExpected);
+		ss << text;
+	}
+	else
+		ss << " MB";
+	if (seconds > 0)
+		ss << ", " << (long long) (recordsRead / seconds) << " records/s";
+
+	// Time left at the rate so far
+	if (bytesExpected > 0 && bytesRead > 0 && bytesRead < bytesExpected) {
+		long long left = (long long) (seconds * (bytesExpected - bytesRead) / bytesRead);
+		snprintf(text, sizeof(text), ", %lld:%02lld:%02lld left", left / 3600, left / 60 % 60, left % 60);
+		ss << text;
+	}
+
+	if (status() == SCAN_CANCELLED)
+		ss << ", cancelled";
+	else if (status() == SCAN_OUT_OF_TIME)
+		ss << ", out of time";
+
+	return ss.str();
+}
+
+// string resultsString()
+//  Purpose:
+//		Returns a string representing how far the scan got, empty if it
+//		completed without progress reports or a time budget
+//
+//		format:
+//			<scan_progress status="<<complete|cancelled|time_budget>>" records="<<count>>" bytes="<<count>>" total_bytes="<<count>>" seconds="<<seconds>>" records_per_second="<<rate>>" complete_chromosomes="<<count>>" [partial_chromosome="<<chromosome>>" partial_end="<<position>>"]/>
+string ScanProgress::resultsString() {
+	ScanStatus scanStatus = status();
+	if (scanStatus == SCAN_COMPLETE && reportInterval <= 0 && timeBudget <= 0)
+		return "";
+
+	double seconds = elapsedSeconds();
+	long long recordsRead = records.load();
+	stringstream ss;
+	ss << "    <scan_progress status=\""
+		<< (scanStatus == SCAN_COMPLETE ? "complete" : scanStatus == SCAN_CANCELLED ? "cancelled" : "time_budget")
+		<< "\" records=\"" << recordsRead
+		<< "\" bytes=\"" << bytes.load()
+		<< "\" total_bytes=\"" << totalBytes.load()
+		<< "\" seconds=\"" << seconds
+		<< "\" records_per_second=\"" << (long long) (seconds > 0 ? recordsRead / seconds : 0)
+		<< "\"";
+
+	lock_guard<mutex> lock(chromosomesMutex);
+	if (scanStatus == SCAN_COMPLETE || chromosomes.empty())
+		ss << " complete_chromosomes=\"" << chromosomes.size() << "\"";
+	else
+		ss
+			<< " complete_chromosomes=\"" << chromosomes.size() - 1
+			<< "\" partial_chromosome=\"" << chromosomes.back()
+			<< "\" partial_end=\"" << lastPosition << "\"";
+	ss << "/>\n";
+
+	return ss.str();
+}
+
+// Public Class Methods
+// =============================================
+
+// installSignalHandlers()
+//  Purpose:
+//		Reports the progress of the running scans on SIGUSR1 and cancels
+//		them on the first SIGINT or SIGTERM.  A second one ends the
+//		process.
+void ScanProgress::installSignalHandlers() {
+	signal(SIGUSR1, reportSignalHandler);
+	signal(SIGINT, cancelSignalHandler);
+	signal(SIGTERM, cancelSignalHandler);
+}
+
+// Private Methods
+// =============================================
+
+// double elapsedSeconds()
+//  Purpose:
+//		Returns the seconds since the scan started
+double ScanProgress::elapsedSeconds() {
+	return chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+// reportLoop()
+//  Purpose:
+//		Reporter thread body.  Writes the report every report interval and
+//		on SIGUSR1 until the progress is destroyed.
+void ScanProgress::reportLoop() {
+	double nextReport = reportInterval;
+	unique_lock<mutex> lock(reporterMutex);
+	while (!reporterStopping) {
+		reporterWake.wait_for(lock, chrono::milliseconds(100));
+		if (reporterStopping)
+			break;
+
+		bool signalled = reportSignalled != 0;
+		reportSignalled = 0;
+		double seconds = elapsedSeconds();
+		bool due = reportInterval > 0 && seconds >= nextReport;
+		if (due)
+			while (nextReport <= seconds)
+				nextReport += reportInterval;
+		if (signalled || due)
+			cerr << reportString() << endl;
+	}
+}
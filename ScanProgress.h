@@ -0,0 +1,147 @@
+/*
+ * ScanProgress.h
+ *
+ *	This is the header file for the ScanProgress object. A ScanProgress
+ *  follows a scan as its CountsReaders hand out batches: the records and
+ *  bytes read, the rate, the time left and the chromosome reached.  It
+ *  reports them on stderr every few seconds or when the process gets
+ *  SIGUSR1, and stops the scan when it is cancelled (SIGINT or SIGTERM)
+ *  or runs out of its time budget.
+ *
+ *	The counts are atomics updated once per batch, so following a scan
+ *  costs nothing measurable.  A stopped scan is stopped cooperatively:
+ *  the readers return no more batches, as at the end of the file, so
+ *  the scan finishes the segments it has and the results cover the
+ *  chromosomes read whole and the part of the last one that was read.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef SCANPROGRESS_H
+#define SCANPROGRESS_H
+#include "CountsReader.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Why a scan ended
+enum ScanStatus {
+	SCAN_COMPLETE,
+	SCAN_CANCELLED,
+	SCAN_OUT_OF_TIME
+};
+
+class ScanProgress
+{
+public:
+	// Constuctors
+	// ==============================================
+	ScanProgress(double reportSeconds, double budgetSeconds);
+
+	// Destructor
+	// =============================================
+	~ScanProgress();
+
+	// Public Methods
+	// =============================================
+
+	// addTotalBytes(long long bytes)
+	//  Purpose:
+	//		Adds the size of an input to the bytes expected
+	void addTotalBytes(long long bytes);
+
+	// addBatch(long long records, long long bytes, const vector<ChromosomeRun>& chromosomes, long long lastPosition)
+	//  Purpose:
+	//		Counts a batch handed out by a reader, with the chromosome
+	//		runs in it and the position of its last record
+	void addBatch(long long records, long long bytes, const vector<ChromosomeRun>& chromosomes, long long lastPosition);
+
+	// cancel()
+	//  Purpose:
+	//		Asks the scan to stop
+	void cancel();
+
+	// bool stopRequested()
+	//  Purpose:
+	//		Returns true if the scan should stop, because it was cancelled
+	//		or is over its time budget
+	bool stopRequested();
+
+	// ScanStatus status()
+	//  Purpose:
+	//		Returns why the scan stopped, SCAN_COMPLETE if it did not
+	ScanStatus status();
+
+	// bool chromosomeComplete(const string& chromosome)
+	//  Purpose:
+	//		Returns true if chromosome was read whole: the scan went on
+	//		past it or was not stopped
+	bool chromosomeComplete(const string& chromosome);
+
+	// string reportString()
+	//  Purpose:
+	//		Returns the progress report line
+	//
+	//		format:
+	//			progress: <<chromosome>>:<<position>>, <<records>> records, <<MB>> of <<MB>> MB (<<percent>>%), <<rate>> records/s, <<time>> left
+	string reportString();
+
+	// string resultsString()
+	//  Purpose:
+	//		Returns a string representing how far the scan got, empty if
+	//		it completed without progress reports or a time budget
+	//
+	//		format:
+	//			<scan_progress status="<<complete|cancelled|time_budget>>" records="<<count>>" bytes="<<count>>" total_bytes="<<count>>" seconds="<<seconds>>" records_per_second="<<rate>>" complete_chromosomes="<<count>>" [partial_chromosome="<<chromosome>>" partial_end="<<position>>"]/>
+	string resultsString();
+
+	// Public Class Methods
+	// =============================================
+
+	// installSignalHandlers()
+	//  Purpose:
+	//		Reports the progress of the running scans on SIGUSR1 and
+	//		cancels them on the first SIGINT or SIGTERM.  A second one
+	//		ends the process.
+	static void installSignalHandlers();
+
+private:
+	double reportInterval;
+	double timeBudget;
+	chrono::steady_clock::time_point startTime;
+
+	atomic<long long> records;
+	atomic<long long> bytes;
+	atomic<long long> totalBytes;
+	atomic<int> stopStatus;
+
+	// Chromosomes in the order read and the last position handed out
+	mutex chromosomesMutex;
+	vector<string> chromosomes;
+	long long lastPosition;
+
+	// Reporter thread
+	mutex reporterMutex;
+	condition_variable reporterWake;
+	bool reporterStopping;
+	thread reporter;
+
+	// double elapsedSeconds()
+	//  Purpose:
+	//		Returns the seconds since the scan started
+	double elapsedSeconds();
+
+	// reportLoop()
+	//  Purpose:
+	//		Reporter thread body.  Writes the report every report interval
+	//		and on SIGUSR1 until the progress is destroyed.
+	void reportLoop();
+};
+
+#endif //SCANPROGRESS_H
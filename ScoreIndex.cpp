@@ -0,0 +1,290 @@
+/*
+ * ScoreIndex.cpp
+ *
+ *	This is the cpp file for the ScoreIndex object. A ScoreIndex keeps
+ *  the score track of a scan with a summary of the cumulative score over
+ *  each block of records, so the sequence can be segmented again at
+ *  another threshold without reading the counts.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "ScoreIndex.h"
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <math.h>
+#include <string.h>
+
+static const char MAGIC[8] = {'C', 'N', 'V', 'S', 'I', 'D', 'X', '1'};
+
+// Records summarized per block
+static const int SCORE_BLOCK_SIZE = 4096;
+
+// Constuctors
+// ==============================================
+ScoreIndex::ScoreIndex() {
+	fractionalBits = 0;
+	blockSize = SCORE_BLOCK_SIZE;
+	for (int i = 0; i < 4; i++) {
+		scores[i] = 0;
+		readStartCounts[i] = 0;
+	}
+	skippedBlocks = 0;
+	scannedBlocks = 0;
+}
+
+// Public Methods
+// =============================================
+
+// addRecords(const long long* recordPositions, const unsigned short* recordReadStarts, size_t count)
+//  Purpose:
+//		Appends count records, in scan order
+void ScoreIndex::addRecords(const long long* recordPositions, const unsigned short* recordReadStarts, size_t count) {
+	positions.insert(positions.end(), recordPositions, recordPositions + count);
+	readStarts.insert(readStarts.end(), recordReadStarts, recordReadStarts + count);
+}
+
+// build(const int32_t scoreTable[4], int bits)
+//  Purpose:
+//		Summarizes the records' cumulative score block by block with the
+//		fixed-point scores in scoreTable
+//	Postconditions:
+//		fractionalBits, scores, readStartCounts, blocks - set
+void ScoreIndex::build(const int32_t scoreTable[4], int bits) {
+	fractionalBits = bits;
+	for (int i = 0; i < 4; i++) {
+		scores[i] = scoreTable[i];
+		readStartCounts[i] = 0;
+	}
+
+	size_t numRecords = positions.size();
+	blocks.clear();
+	int64_t prefix = 0;
+	for (size_t first = 0; first < numRecords; first += blockSize) {
+		size_t last = min(first + blockSize, numRecords);
+		ScoreBlock block;
+		block.prefix = prefix;
+		block.minPrefix = numeric_limits<int64_t>::max();
+		block.maxPrefix = numeric_limits<int64_t>::min();
+		block.maxAfterMin = numeric_limits<int64_t>::min();
+		block.maxRise = numeric_limits<int64_t>::min();
+		block.minIndex = 0;
+		block.maxIndex = 0;
+		block.maxAfterMinIndex = -1;
+		block.padding = 0;
+
+		for (size_t i = first; i < last; i++) {
+			int code = readStarts[i] > 3 ? 3 : readStarts[i];
+			readStartCounts[code]++;
+			prefix += scores[code];
+			int index = i - first;
+
+			// The rise is from the lowest point before this record
+			if (index > 0)
+				block.maxRise = max(block.maxRise, prefix - block.minPrefix);
+			if (prefix <= block.minPrefix) {
+				block.minPrefix = prefix;
+				block.minIndex = index;
+				block.maxAfterMin = numeric_limits<int64_t>::min();
+				block.maxAfterMinIndex = -1;
+			}
+			else if (prefix >= block.maxAfterMin) {
+				block.maxAfterMin = prefix;
+				block.maxAfterMinIndex = index;
+			}
+			if (prefix >= block.maxPrefix) {
+				block.maxPrefix = prefix;
+				block.maxIndex = index;
+			}
+		}
+		blocks.push_back(block);
+	}
+}
+
+// findSegments(int64_t threshold, vector<DSegment>& segments)
+//  Purpose:
+//		Finds the D-Segments scoring over threshold, scanning record by
+//		record only the blocks whose summary can not be stepped over
+//	Postconditions:
+//		segments, skippedBlocks, scannedBlocks - set
+void ScoreIndex::findSegments(int64_t threshold, vector<DSegment>& segments) {
+	scanSegments(threshold, segments);
+}
+
+// findSegments(int64_t threshold, SegmentStore& segments)
+//  Purpose:
+//		Finds the D-Segments scoring over threshold into a segment store
+//	Postconditions:
+//		segments, skippedBlocks, scannedBlocks - set
+void ScoreIndex::findSegments(int64_t threshold, SegmentStore& segments) {
+	scanSegments(threshold, segments);
+}
+
+// write(string fileName)
+//  Purpose:
+//		Writes the index to fileName
+void ScoreIndex::write(string fileName) {
+	ofstream indexFile(fileName.c_str(), ios::binary | ios::trunc);
+	if (!indexFile.is_open())
+		throw runtime_error("could not open score index " + fileName + " for writing");
+
+	uint64_t numRecords = positions.size();
+	uint64_t numBlocks = blocks.size();
+	indexFile.write(MAGIC, 8);
+	indexFile.write((const char*) &fractionalBits, 4);
+	indexFile.write((const char*) scores, sizeof(scores));
+	indexFile.write((const char*) &blockSize, 4);
+	indexFile.write((const char*) &numRecords, 8);
+	indexFile.write((const char*) &numBlocks, 8);
+	indexFile.write((const char*) blocks.data(), numBlocks * sizeof(ScoreBlock));
+	indexFile.write((const char*) positions.data(), numRecords * sizeof(int64_t));
+	indexFile.write((const char*) readStarts.data(), numRecords * sizeof(unsigned short));
+	if (!indexFile)
+		throw runtime_error("could not write score index " + fileName);
+}
+
+// read(string fileName)
+//  Purpose:
+//		Reads the index from fileName
+void ScoreIndex::read(string fileName) {
+	ifstream indexFile(fileName.c_str(), ios::binary);
+	if (!indexFile.is_open())
+		throw runtime_error("could not open score index " + fileName);
+
+	char magic[8];
+	uint64_t numRecords = 0;
+	uint64_t numBlocks = 0;
+	indexFile.read(magic, 8);
+	indexFile.read((char*) &fractionalBits, 4);
+	indexFile.read((char*) scores, sizeof(scores));
+	indexFile.read((char*) &blockSize, 4);
+	indexFile.read((char*) &numRecords, 8);
+	indexFile.read((char*) &numBlocks, 8);
+	if (!indexFile || memcmp(magic, MAGIC, 8) != 0 || blockSize < 1
+		|| numBlocks != (numRecords + blockSize - 1) / blockSize)
+		throw runtime_error(fileName + " is not a score index");
+
+	blocks.resize(numBlocks);
+	positions.resize(numRecords);
+	readStarts.resize(numRecords);
+	indexFile.read((char*) blocks.data(), numBlocks * sizeof(ScoreBlock));
+	indexFile.read((char*) positions.data(), numRecords * sizeof(int64_t));
+	indexFile.read((char*) readStarts.data(), numRecords * sizeof(unsigned short));
+	if (!indexFile)
+		throw runtime_error("score index " + fileName + " is truncated");
+
+	for (int i = 0; i < 4; i++)
+		readStartCounts[i] = 0;
+	for (uint64_t i = 0; i < numRecords; i++)
+		readStartCounts[readStarts[i] > 3 ? 3 : readStarts[i]]++;
+}
+
+// Private Methods
+// =============================================
+
+// scanSegments(int64_t threshold, Segments& segments)
+//  Purpose:
+//		Finds the D-Segments scoring over threshold into segments.  The
+//		scan state is that of DSegmentScanner with the cumulative score
+//		kept as the prefix at the last reset (base), so the prefix of a
+//		record less base is the scanner's cumulative score.
+template <typename Segments>
+void ScoreIndex::scanSegments(int64_t threshold, Segments& segments) {
+	segments.clear();
+	skippedBlocks = 0;
+	scannedBlocks = 0;
+
+	int64_t base = 0;
+	int64_t max = 0;
+	size_t start = 0;
+	size_t end = 0;
+	bool startPending = true;
+	size_t numRecords = positions.size();
+	for (size_t b = 0; b < blocks.size(); b++) {
+		const ScoreBlock& block = blocks[b];
+		size_t first = b * blockSize;
+		size_t last = min(first + blockSize, numRecords);
+
+		// With the maximum under the threshold the scan resets only at
+		// new lows, so if no record rises to the threshold over the
+		// lowest point before it the block ends in a state its summary
+		// gives
+		if (max < threshold && block.maxPrefix - base < threshold && block.maxRise < threshold) {
+			skippedBlocks++;
+			if (block.minPrefix <= base) {
+				base = block.minPrefix;
+				max = 0;
+				startPending = block.maxAfterMinIndex < 0;
+				if (!startPending) {
+					start = first + block.minIndex + 1;
+					max = block.maxAfterMin - base;
+					end = first + block.maxAfterMinIndex;
+				}
+			}
+			else {
+				if (startPending) {
+					start = first;
+					startPending = false;
+				}
+				if (block.maxPrefix - base >= max) {
+					max = block.maxPrefix - base;
+					end = first + block.maxIndex;
+				}
+			}
+			continue;
+		}
+
+		// Scan the block record by record
+		scannedBlocks++;
+		int64_t prefix = block.prefix;
+		for (size_t i = first; i < last; i++) {
+			if (startPending) {
+				start = i;
+				startPending = false;
+			}
+			prefix += scores[readStarts[i] > 3 ? 3 : readStarts[i]];
+
+			// Keep track of maximum score to this point
+			int64_t cum = prefix - base;
+			if (cum >= max) {
+				max = cum;
+				end = i;
+			}
+
+			// Check if over threshold
+			if (cum <= 0 || cum <= max - threshold) {
+				if (max >= threshold)
+					segments.push_back(makeSegment(start, end, max));
+				base = prefix;
+				max = 0;
+				startPending = true;
+			}
+		}
+	}
+
+	// Check if last segment is a D-Segment
+	if (max >= threshold)
+		segments.push_back(makeSegment(start, end, max));
+}
+
+// DSegment makeSegment(size_t first, size_t last, int64_t max)
+//  Purpose:
+//		Returns the segment of records first to last scoring max, with its
+//		read start statistics
+DSegment ScoreIndex::makeSegment(size_t first, size_t last, int64_t max) {
+	DSegment segment;
+	segment.start = positions[first];
+	segment.end = positions[last];
+	segment.score = (long double) max / ldexpl(1, fractionalBits);
+	for (int c = 0; c < 4; c++)
+		segment.readStartCounts[c] = 0;
+	segment.readStartSum = 0;
+	segment.chromosome = -1;
+	for (size_t i = first; i <= last; i++) {
+		segment.readStartCounts[readStarts[i] > 3 ? 3 : readStarts[i]]++;
+		segment.readStartSum += readStarts[i];
+	}
+	return segment;
+}
@@ -0,0 +1,138 @@
+/*
+ * ScoreIndex.h
+ *
+ *	This is the header file for the ScoreIndex object. A ScoreIndex
+ *  keeps the score track of a scan, the records with their read starts
+ *  and a summary of the cumulative score over each block of records, so
+ *  the sequence can be segmented again at another threshold without
+ *  reading the counts.
+ *
+ *	The scores are fixed-point integers (see setFixedPointScoring in
+ *  DSegmentsFinder.h), so the cumulative score is exact and a block's
+ *  summary says exactly what the scan does inside it.  While the open
+ *  segment's maximum is under the threshold the scan only resets where
+ *  the cumulative score reaches a new minimum, so a block in which no
+ *  score rises the threshold above the lowest point before it can be
+ *  stepped over from its summary.  Only the other blocks are scanned
+ *  record by record.  The segments are exactly those of a fixed-point
+ *  scan at the new threshold.
+ *
+ *	Binary format (native byte order):
+ *		char magic[8]					"CNVSIDX1"
+ *		int32_t fractionalBits
+ *		int32_t scores[4]				scores times 2^fractionalBits
+ *		int32_t blockSize
+ *		uint64_t numRecords
+ *		uint64_t numBlocks
+ *		ScoreBlock blocks[numBlocks]
+ *		int64_t positions[numRecords]
+ *		uint16_t readStarts[numRecords]	uncapped, up to 65535
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef SCOREINDEX_H
+#define SCOREINDEX_H
+#include "DSegmentScanner.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Summary of the cumulative score over a block of records.  The
+// cumulative score after a record is the sum of the scores of the
+// records up to and including it, indices are from the block's first
+// record and the last one is taken when several tie.
+struct ScoreBlock {
+	int64_t prefix;				// cumulative score before the block
+	int64_t minPrefix;			// lowest cumulative score in the block
+	int64_t maxPrefix;			// highest cumulative score in the block
+	int64_t maxAfterMin;		// highest after the lowest
+	int64_t maxRise;			// largest rise from one record to a later one
+	int32_t minIndex;
+	int32_t maxIndex;
+	int32_t maxAfterMinIndex;	// -1 if the lowest is the last record
+	int32_t padding;
+};
+
+class ScoreIndex
+{
+public:
+	// Constuctors
+	// ==============================================
+	ScoreIndex();
+
+	// Public Attributes
+	// =============================================
+	int fractionalBits;
+	int blockSize;
+	int32_t scores[4];
+	long long readStartCounts[4];
+	vector<int64_t> positions;
+	vector<unsigned short> readStarts;
+	vector<ScoreBlock> blocks;
+
+	// Blocks stepped over and scanned by the last findSegments
+	long long skippedBlocks;
+	long long scannedBlocks;
+
+	// Public Methods
+	// =============================================
+
+	// addRecords(const long long* recordPositions, const unsigned short* recordReadStarts, size_t count)
+	//  Purpose:
+	//		Appends count records, in scan order
+	void addRecords(const long long* recordPositions, const unsigned short* recordReadStarts, size_t count);
+
+	// build(const int32_t scoreTable[4], int bits)
+	//  Purpose:
+	//		Summarizes the records' cumulative score block by block with
+	//		the fixed-point scores in scoreTable
+	//	Postconditions:
+	//		fractionalBits, scores, readStartCounts, blocks - set
+	void build(const int32_t scoreTable[4], int bits);
+
+	// findSegments(int64_t threshold, vector<DSegment>& segments)
+	//  Purpose:
+	//		Finds the D-Segments scoring over threshold (a fixed-point
+	//		score), scanning record by record only the blocks whose
+	//		summary can not be stepped over
+	//	Postconditions:
+	//		segments, skippedBlocks, scannedBlocks - set
+	void findSegments(int64_t threshold, vector<DSegment>& segments);
+
+	// findSegments(int64_t threshold, SegmentStore& segments)
+	//  Purpose:
+	//		Finds the D-Segments scoring over threshold into a segment
+	//		store
+	//	Postconditions:
+	//		segments, skippedBlocks, scannedBlocks - set
+	void findSegments(int64_t threshold, SegmentStore& segments);
+
+	// write(string fileName)
+	//  Purpose:
+	//		Writes the index to fileName
+	void write(string fileName);
+
+	// read(string fileName)
+	//  Purpose:
+	//		Reads the index from fileName
+	void read(string fileName);
+
+private:
+	// scanSegments(int64_t threshold, Segments& segments)
+	//  Purpose:
+	//		Finds the D-Segments scoring over threshold into segments, a
+	//		vector of DSegments or a SegmentStore
+	template <typename Segments>
+	void scanSegments(int64_t threshold, Segments& segments);
+
+	// DSegment makeSegment(size_t first, size_t last, int64_t max)
+	//  Purpose:
+	//		Returns the segment of records first to last scoring max, with
+	//		its read start statistics
+	DSegment makeSegment(size_t first, size_t last, int64_t max);
+};
+
+#endif //SCOREINDEX_H
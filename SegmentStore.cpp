@@ -0,0 +1,354 @@
+/*
+ * SegmentStore.cpp
+ *
+ *	This is the cpp file for the SegmentStore object. A SegmentStore holds
+ *  a large set of segments compactly: float scores in chunks and the rest
+ *  delta and varint encoded in arena blocks, optionally spilled to a
+ *  temporary file.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "SegmentStore.h"
+#include <errno.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Bytes in an arena block and scores in a score chunk
+static const uint32_t BLOCK_BYTES = 1 << 20;
+static const size_t SCORE_CHUNK = 1 << 16;
+
+// Segments between the places decoding can start
+static const size_t GROUP_SIZE = 32;
+
+// Most bytes a segment can take: three 64-bit and one 32-bit zigzag
+// varints, four 32-bit varints and the 64-bit sum
+static const uint32_t MAX_SEGMENT_BYTES = 3 * 10 + 5 + 4 * 5 + 10;
+
+// Appends value to bytes as a varint and returns the bytes written
+static inline int putVarint(char* bytes, uint64_t value) {
+	int n = 0;
+	while (value >= 0x80) {
+		bytes[n++] = (char) (value | 0x80);
+		value >>= 7;
+	}
+	bytes[n++] = (char) value;
+	return n;
+}
+
+// Reads a varint from bytes at offset and moves offset past it
+static inline uint64_t getVarint(const char* bytes, uint32_t& offset) {
+	uint64_t value = 0;
+	int shift = 0;
+	unsigned char byte;
+	do {
+		byte = (unsigned char) bytes[offset++];
+		value |= (uint64_t) (byte & 0x7f) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+	return value;
+}
+
+// Signed values as varints, small magnitudes small
+static inline uint64_t zigzag(int64_t value) {
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+// Constuctors
+// ==============================================
+SegmentStore::SegmentStore() {
+	numSegments = 0;
+	lastEnd = 0;
+	lastChromosome = 0;
+	spillLimit = 0;
+	spillFile = -1;
+	blocksInFile = 0;
+	blocksInMemory = 0;
+	cursor.index = 0;
+	cursor.block = 0;
+	cursor.offset = 0;
+	cursor.lastEnd = 0;
+	cursor.lastChromosome = 0;
+	spilledBlockIndex = -1;
+}
+
+SegmentStore::SegmentStore(const SegmentStore& other) : SegmentStore() {
+	setSpill(other.spillDirectory, other.spillLimit);
+	append(other);
+}
+
+SegmentStore& SegmentStore::operator=(const SegmentStore& other) {
+	if (this != &other) {
+		clear();
+		setSpill(other.spillDirectory, other.spillLimit);
+		append(other);
+	}
+	return *this;
+}
+
+// Destructor
+// =============================================
+SegmentStore::~SegmentStore() {
+	clear();
+}
+
+// Public Methods
+// =============================================
+
+// setSpill(string directory, long long memoryLimit)
+//  Purpose:
+//		Moves full blocks to a temporary file in directory once the blocks
+//		in memory take more than memoryLimit bytes.  An empty directory
+//		keeps every block in memory.
+void SegmentStore::setSpill(string directory, long long memoryLimit) {
+	spillDirectory = directory;
+	spillLimit = memoryLimit;
+}
+
+// push_back(const DSegment& segment)
+//  Purpose:
+//		Appends segment
+void SegmentStore::push_back(const DSegment& segment) {
+
+	// Start a block when the segment might not fit
+	if (blocks.empty() || blockBytes.back() + MAX_SEGMENT_BYTES > BLOCK_BYTES) {
+		blocks.push_back((char*) malloc(BLOCK_BYTES));
+		if (blocks.back() == NULL)
+			throw runtime_error("out of memory for the segment store");
+		blockBytes.push_back(0);
+		blocksInMemory++;
+		if (!spillDirectory.empty() && blocksInMemory * (long long) BLOCK_BYTES > spillLimit)
+			spill();
+	}
+	if (numSegments % SCORE_CHUNK == 0)
+		scoreChunks.push_back(new float[SCORE_CHUNK]);
+
+	// A group starts here
+	if (numSegments % GROUP_SIZE == 0) {
+		SegmentGroup group;
+		group.block = blocks.size() - 1;
+		group.offset = blockBytes.back();
+		group.lastEnd = lastEnd;
+		group.lastChromosome = lastChromosome;
+		groups.push_back(group);
+	}
+
+	// Encode it
+	char* bytes = blocks.back() + blockBytes.back();
+	int n = 0;
+	n += putVarint(bytes + n, zigzag((int64_t) segment.chromosome - lastChromosome));
+	n += putVarint(bytes + n, zigzag((int64_t) segment.start - lastEnd));
+	n += putVarint(bytes + n, zigzag((int64_t) segment.end - segment.start));
+	for (int i = 0; i < 4; i++)
+		n += putVarint(bytes + n, (uint32_t) segment.readStartCounts[i]);
+	int64_t cappedSum = (int64_t) segment.readStartCounts[1] + 2LL * segment.readStartCounts[2] + 3LL * segment.readStartCounts[3];
+	n += putVarint(bytes + n, zigzag(segment.readStartSum - cappedSum));
+	blockBytes.back() += n;
+
+	scoreChunks.back()[numSegments % SCORE_CHUNK] = (float) segment.score;
+	lastEnd = segment.end;
+	lastChromosome = segment.chromosome;
+	numSegments++;
+}
+
+// append(const SegmentStore& other)
+//  Purpose:
+//		Appends the segments of other
+void SegmentStore::append(const SegmentStore& other) {
+	size_t count = other.size();
+	for (size_t i = 0; i < count; i++)
+		push_back(other[i]);
+}
+
+// clear()
+//  Purpose:
+//		Removes all the segments
+void SegmentStore::clear() {
+	for (size_t i = 0; i < blocks.size(); i++)
+		free(blocks[i]);
+	for (size_t i = 0; i < scoreChunks.size(); i++)
+		delete[] scoreChunks[i];
+	if (spillFile >= 0)
+		close(spillFile);
+	blocks.clear();
+	blockBytes.clear();
+	scoreChunks.clear();
+	groups.clear();
+	vector<char>().swap(spilledBlock);
+	numSegments = 0;
+	lastEnd = 0;
+	lastChromosome = 0;
+	spillFile = -1;
+	blocksInFile = 0;
+	blocksInMemory = 0;
+	spilledBlockIndex = -1;
+	cursor.index = 0;
+	cursor.block = 0;
+	cursor.offset = 0;
+	cursor.lastEnd = 0;
+	cursor.lastChromosome = 0;
+}
+
+// size_t size()
+//  Purpose:
+//		Returns the number of segments
+size_t SegmentStore::size() const {
+	return numSegments;
+}
+
+// bool empty()
+//  Purpose:
+//		Returns true if there are no segments
+bool SegmentStore::empty() const {
+	return numSegments == 0;
+}
+
+// DSegment operator[](size_t index)
+//  Purpose:
+//		Returns segment index
+DSegment SegmentStore::operator[](size_t index) const {
+	if (index >= numSegments)
+		throw out_of_range("segment store index out of range");
+	if (index != cursor.index)
+		seek(index);
+	DSegment segment = decode();
+	segment.score = scoreChunks[index / SCORE_CHUNK][index % SCORE_CHUNK];
+	return segment;
+}
+
+// float score(size_t index)
+//  Purpose:
+//		Returns the score of segment index without decoding it
+float SegmentStore::score(size_t index) const {
+	return scoreChunks[index / SCORE_CHUNK][index % SCORE_CHUNK];
+}
+
+// long long memoryBytes()
+//  Purpose:
+//		Returns the bytes the segments take in memory: the bytes used in
+//		the blocks held, the scores and the groups.  The unused end of
+//		the last block and of the last score chunk is not counted.
+long long SegmentStore::memoryBytes() const {
+	long long bytes = (long long) numSegments * sizeof(float)
+		+ (long long) groups.size() * sizeof(SegmentGroup);
+	for (size_t i = 0; i < blocks.size(); i++)
+		if (blocks[i] != NULL)
+			bytes += blockBytes[i];
+	return bytes;
+}
+
+// long long spilledBytes()
+//  Purpose:
+//		Returns the bytes of segments the store has moved to its
+//		temporary file
+long long SegmentStore::spilledBytes() const {
+	long long bytes = 0;
+	for (size_t i = 0; i < blocks.size(); i++)
+		if (blocks[i] == NULL)
+			bytes += blockBytes[i];
+	return bytes;
+}
+
+// Private Methods
+// =============================================
+
+// const char* blockData(uint32_t block)
+//  Purpose:
+//		Returns the bytes of block, reading it back if spilled
+const char* SegmentStore::blockData(uint32_t block) const {
+	if (blocks[block] != NULL)
+		return blocks[block];
+
+	if (spilledBlockIndex != (long long) block) {
+		spilledBlock.resize(BLOCK_BYTES);
+		off_t offset = (off_t) block * BLOCK_BYTES;
+		size_t done = 0;
+		while (done < blockBytes[block]) {
+			ssize_t n = pread(spillFile, spilledBlock.data() + done, blockBytes[block] - done, offset + done);
+			if (n <= 0)
+				throw runtime_error("could not read the segment spill file: " + string(strerror(errno)));
+			done += n;
+		}
+		spilledBlockIndex = block;
+	}
+	return spilledBlock.data();
+}
+
+// spill()
+//  Purpose:
+//		Moves the full blocks in memory to the temporary file
+void SegmentStore::spill() {
+	if (spillFile < 0) {
+		string pattern = spillDirectory + "/cnv_segments_XXXXXX";
+		vector<char> fileName(pattern.begin(), pattern.end());
+		fileName.push_back('\0');
+		spillFile = mkstemp(fileName.data());
+		if (spillFile < 0)
+			throw runtime_error("could not create a segment spill file in " + spillDirectory + ": " + strerror(errno));
+		unlink(fileName.data());
+	}
+
+	// Every block but the one being filled, each at its own offset
+	for (size_t block = 0; block + 1 < blocks.size(); block++) {
+		if (blocks[block] == NULL)
+			continue;
+		off_t offset = (off_t) block * BLOCK_BYTES;
+		size_t done = 0;
+		while (done < blockBytes[block]) {
+			ssize_t n = pwrite(spillFile, blocks[block] + done, blockBytes[block] - done, offset + done);
+			if (n <= 0)
+				throw runtime_error("could not write the segment spill file: " + string(strerror(errno)));
+			done += n;
+		}
+		free(blocks[block]);
+		blocks[block] = NULL;
+		blocksInFile++;
+		blocksInMemory--;
+	}
+}
+
+// seek(size_t index)
+//  Purpose:
+//		Moves the read position to segment index
+void SegmentStore::seek(size_t index) const {
+	const SegmentGroup& group = groups[index / GROUP_SIZE];
+	cursor.index = index / GROUP_SIZE * GROUP_SIZE;
+	cursor.block = group.block;
+	cursor.offset = group.offset;
+	cursor.lastEnd = group.lastEnd;
+	cursor.lastChromosome = group.lastChromosome;
+	while (cursor.index < index)
+		decode();
+}
+
+// DSegment decode()
+//  Purpose:
+//		Decodes the segment at the read position and moves past it
+DSegment SegmentStore::decode() const {
+	if (cursor.offset >= blockBytes[cursor.block]) {
+		cursor.block++;
+		cursor.offset = 0;
+	}
+	const char* bytes = blockData(cursor.block);
+
+	DSegment segment;
+	segment.chromosome = (int) (cursor.lastChromosome + unzigzag(getVarint(bytes, cursor.offset)));
+	segment.start = cursor.lastEnd + unzigzag(getVarint(bytes, cursor.offset));
+	segment.end = segment.start + unzigzag(getVarint(bytes, cursor.offset));
+	for (int i = 0; i < 4; i++)
+		segment.readStartCounts[i] = (int) getVarint(bytes, cursor.offset);
+	segment.readStartSum = (long long) segment.readStartCounts[1] + 2LL * segment.readStartCounts[2] + 3LL * segment.readStartCounts[3]
+		+ unzigzag(getVarint(bytes, cursor.offset));
+	segment.score = 0;
+
+	cursor.lastEnd = segment.end;
+	cursor.lastChromosome = segment.chromosome;
+	cursor.index++;
+	return segment;
+}
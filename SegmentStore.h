@@ -0,0 +1,179 @@
+/*
+ * SegmentStore.h
+ *
+ *	This is the header file for the SegmentStore object. A SegmentStore
+ *  holds a large set of segments compactly, in place of a vector of
+ *  DSegments (64 bytes each), for permissive thresholds that call tens of
+ *  millions of segments.  Segments are appended in scan order and read
+ *  back by index.
+ *
+ *	The store is columnar:
+ *		scores		- floats, in fixed-size chunks
+ *		segments	- per segment, in arena blocks:
+ *						chromosome			zigzag varint, from the last segment's
+ *						start				zigzag varint, from the last segment's end
+ *						end					zigzag varint, from start
+ *						readStartCounts[4]	varints
+ *						readStartSum		zigzag varint, from
+ *											count1 + 2 count2 + 3 count3
+ *		groups		- the block, offset and last chromosome and end before
+ *					  every 32nd segment, where decoding can start
+ *
+ *	so a segment in scan order takes about 12 bytes plus 4 for its score,
+ *  coordinates are 64-bit and neither column is ever copied to grow.
+ *  Reading the segments in order decodes each once; reading one out of
+ *  order decodes at most the 31 before it in its group.
+ *
+ *	Scores are kept as floats, so a stored segment's score is its scan
+ *  score rounded to about 7 significant digits.
+ *
+ *	With a spill directory, full blocks beyond the memory limit are moved
+ *  to an unlinked temporary file there and read back a block at a time.
+ *
+ *	The read position is kept in the store, so a store is read by one
+ *  thread at a time.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef SEGMENTSTORE_H
+#define SEGMENTSTORE_H
+#include "DSegment.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+class SegmentStore
+{
+public:
+	// Constuctors
+	// ==============================================
+	SegmentStore();
+	SegmentStore(const SegmentStore& other);
+	SegmentStore& operator=(const SegmentStore& other);
+
+	// Destructor
+	// =============================================
+	~SegmentStore();
+
+	// Public Methods
+	// =============================================
+
+	// setSpill(string directory, long long memoryLimit)
+	//  Purpose:
+	//		Moves full blocks to a temporary file in directory once the
+	//		blocks in memory take more than memoryLimit bytes.  An empty
+	//		directory keeps every block in memory.
+	void setSpill(string directory, long long memoryLimit);
+
+	// push_back(const DSegment& segment)
+	//  Purpose:
+	//		Appends segment
+	void push_back(const DSegment& segment);
+
+	// append(const SegmentStore& other)
+	//  Purpose:
+	//		Appends the segments of other
+	void append(const SegmentStore& other);
+
+	// clear()
+	//  Purpose:
+	//		Removes all the segments
+	void clear();
+
+	// size_t size()
+	//  Purpose:
+	//		Returns the number of segments
+	size_t size() const;
+
+	// bool empty()
+	//  Purpose:
+	//		Returns true if there are no segments
+	bool empty() const;
+
+	// DSegment operator[](size_t index)
+	//  Purpose:
+	//		Returns segment index
+	DSegment operator[](size_t index) const;
+
+	// float score(size_t index)
+	//  Purpose:
+	//		Returns the score of segment index without decoding it
+	float score(size_t index) const;
+
+	// long long memoryBytes()
+	//  Purpose:
+	//		Returns the bytes the segments take in memory: the bytes used
+	//		in the blocks held, the scores and the groups.  The unused end
+	//		of the last block and of the last score chunk is not counted.
+	long long memoryBytes() const;
+
+	// long long spilledBytes()
+	//  Purpose:
+	//		Returns the bytes of segments the store has moved to its
+	//		temporary file
+	long long spilledBytes() const;
+
+private:
+	// Where decoding can start: the byte at offset of block holds the
+	// first segment of the group
+	struct SegmentGroup {
+		uint32_t block;
+		uint32_t offset;
+		int64_t lastEnd;
+		int32_t lastChromosome;
+	};
+
+	// Read position, the next segment to decode
+	struct Cursor {
+		size_t index;
+		uint32_t block;
+		uint32_t offset;
+		int64_t lastEnd;
+		int32_t lastChromosome;
+	};
+
+	size_t numSegments;
+	vector<float*> scoreChunks;
+	vector<char*> blocks;			// NULL once spilled
+	vector<uint32_t> blockBytes;	// bytes used in each block
+	vector<SegmentGroup> groups;
+	int64_t lastEnd;
+	int32_t lastChromosome;
+
+	// Spilling
+	string spillDirectory;
+	long long spillLimit;
+	int spillFile;
+	size_t blocksInFile;
+	long long blocksInMemory;
+
+	// Read position and the spilled block read last
+	mutable Cursor cursor;
+	mutable vector<char> spilledBlock;
+	mutable long long spilledBlockIndex;
+
+	// const char* blockData(uint32_t block)
+	//  Purpose:
+	//		Returns the bytes of block, reading it back if spilled
+	const char* blockData(uint32_t block) const;
+
+	// spill()
+	//  Purpose:
+	//		Moves the full blocks in memory to the temporary file
+	void spill();
+
+	// seek(size_t index)
+	//  Purpose:
+	//		Moves the read position to segment index
+	void seek(size_t index) const;
+
+	// DSegment decode()
+	//  Purpose:
+	//		Decodes the segment at the read position and moves past it
+	DSegment decode() const;
+};
+
+#endif //SEGMENTSTORE_H
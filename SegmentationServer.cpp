@@ -0,0 +1,358 @@
+/*
+ * SegmentationServer.cpp
+ *
+ *	This is the cpp file for the SegmentationServer object. A
+ *  SegmentationServer is a long running process that finds D-Segments for
+ *  jobs sent over a Unix domain socket.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "SegmentationServer.h"
+#include "DSegmentsFinder.h"
+#include "StringUtilities.h"
+#include <chrono>
+#include <errno.h>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Constuctors
+// ==============================================
+SegmentationServer::SegmentationServer(string path, int threads, int normalLength, int elevatedLength, double normalMean, double elevatedMean) {
+	socketPath = path;
+	numThreads = threads < 1 ? 1 : threads;
+	listenSocket = -1;
+	stopping = false;
+	allowShutdown = false;
+	maxCountsBytes = DEFAULT_MAX_COUNTS_BYTES;
+
+	// Keep the defaults as text so they fill in missing job parameters
+	defaultNormalLength = to_string(normalLength);
+	defaultElevatedLength = to_string(elevatedLength);
+	stringstream ss;
+	ss.precision(17);
+	ss << normalMean << " " << elevatedMean;
+	ss >> defaultNormalMean >> defaultElevatedMean;
+}
+
+// Destructor
+// =============================================
+SegmentationServer::~SegmentationServer() {
+	for (map<string, HMMProbabilities*>::iterator it = models.begin(); it != models.end(); it++)
+		delete it->second;
+}
+
+// Public Methods
+// =============================================
+
+// int run()
+//  Purpose:
+//		Listens on the socket and serves jobs until a shutdown request.
+//		Returns 0, or -1 if the socket could not be opened.
+int SegmentationServer::run() {
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path))
+		return -1;
+	strcpy(address.sun_path, socketPath.c_str());
+
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket < 0)
+		return -1;
+	unlink(socketPath.c_str());
+	if (bind(listenSocket, (struct sockaddr*) &address, sizeof(address)) < 0
+		|| listen(listenSocket, 64) < 0) {
+		close(listenSocket);
+		return -1;
+	}
+
+	// Start the workers
+	vector<thread> workers;
+	for (int i = 0; i < numThreads; i++)
+		workers.push_back(thread(&SegmentationServer::serveClients, this));
+
+	// Hand connections to the workers until stopped
+	while (true) {
+		int clientSocket = accept(listenSocket, NULL, NULL);
+		int acceptError = errno;
+		{
+			unique_lock<mutex> lock(clientsMutex);
+			if (stopping) {
+				if (clientSocket >= 0)
+					close(clientSocket);
+				break;
+			}
+			if (clientSocket >= 0) {
+				clients.push(clientSocket);
+				clientsReady.notify_one();
+				continue;
+			}
+		}
+
+		// Out of descriptors or another lasting error, wait for it to
+		// clear instead of spinning on accept
+		if (acceptError != EINTR && acceptError != ECONNABORTED)
+			this_thread::sleep_for(chrono::milliseconds(ACCEPT_RETRY_MILLISECONDS));
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	close(listenSocket);
+	unlink(socketPath.c_str());
+
+	return 0;
+}
+
+// setDefaultModel(string modelFileName)
+//  Purpose:
+//		Uses the model snapshot modelFileName for jobs without model
+//		parameters instead of the default parameters
+//	Postconditions:
+//		defaultModelFileName - set
+void SegmentationServer::setDefaultModel(string modelFileName) {
+	defaultModelFileName = modelFileName;
+}
+
+// setAllowShutdown(bool allow)
+//  Purpose:
+//		Lets a "shutdown" request stop the server if allow is true
+//	Postconditions:
+//		allowShutdown - set
+void SegmentationServer::setAllowShutdown(bool allow) {
+	allowShutdown = allow;
+}
+
+// setMaxCountsBytes(long long maxBytes)
+//  Purpose:
+//		Rejects jobs sending more than maxBytes of inline counts
+//	Postconditions:
+//		maxCountsBytes - set
+void SegmentationServer::setMaxCountsBytes(long long maxBytes) {
+	maxCountsBytes = maxBytes;
+}
+
+// Private Methods
+// =============================================
+
+// serveClients()
+//  Purpose:
+//		Worker thread body.  Handles connections until stopping.
+void SegmentationServer::serveClients() {
+	while (true) {
+		int clientSocket;
+		{
+			unique_lock<mutex> lock(clientsMutex);
+			while (clients.empty() && !stopping)
+				clientsReady.wait(lock);
+			if (clients.empty())
+				return;
+			clientSocket = clients.front();
+			clients.pop();
+		}
+
+		handleClient(clientSocket);
+		close(clientSocket);
+	}
+}
+
+// handleClient(int clientSocket)
+//  Purpose:
+//		Reads the job from clientSocket, runs it and sends the results
+void SegmentationServer::handleClient(int clientSocket) {
+	// Drop clients that stall sending or reading, a worker waits on
+	// each one
+	struct timeval timeout;
+	timeout.tv_sec = CLIENT_TIMEOUT;
+	timeout.tv_usec = 0;
+	setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(clientSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	// Read the request line
+	string received;
+	char buffer[65536];
+	size_t lineEnd;
+	while ((lineEnd = received.find('\n')) == string::npos) {
+		if (received.size() > MAX_REQUEST_LINE) {
+			sendAll(clientSocket, "<error>request line longer than " + to_string(MAX_REQUEST_LINE) + " bytes</error>\n");
+			return;
+		}
+		ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+		if (bytesRead <= 0)
+			return;
+		received.append(buffer, bytesRead);
+	}
+	string line = received.substr(0, lineEnd);
+	string counts = received.substr(lineEnd + 1);
+
+	if (line == "shutdown") {
+		if (!allowShutdown) {
+			sendAll(clientSocket, "<error>shutdown requests are not allowed</error>\n");
+			return;
+		}
+		sendAll(clientSocket, "<shutdown/>\n");
+		stop();
+		return;
+	}
+
+	// Split the request line into the job parameters
+	map<string, string> job;
+	vector<string> tokens;
+	StringUtilities::split(line, ' ', tokens);
+	for (size_t i = 0; i < tokens.size(); i++) {
+		size_t equals = tokens[i].find('=');
+		if (equals != string::npos)
+			job[tokens[i].substr(0, equals)] = tokens[i].substr(equals + 1);
+	}
+
+	// Read the inline counts
+	if (job.count("counts_bytes") > 0) {
+		size_t countsBytes = strtoull(job["counts_bytes"].c_str(), NULL, 10);
+		if (countsBytes > (unsigned long long) maxCountsBytes) {
+			sendAll(clientSocket, "<error>counts_bytes over the server limit of " + to_string(maxCountsBytes) + "</error>\n");
+			return;
+		}
+		while (counts.size() < countsBytes) {
+			ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+			if (bytesRead <= 0)
+				return;
+			counts.append(buffer, bytesRead);
+		}
+		counts.resize(countsBytes);
+	}
+	else if (job.count("file") == 0) {
+		sendAll(clientSocket, "<error>request needs file or counts_bytes</error>\n");
+		return;
+	}
+
+	string results;
+	try {
+		results = runJob(job, counts);
+	}
+	catch (exception& e) {
+		results = string("<error>") + e.what() + "</error>\n";
+	}
+	sendAll(clientSocket, results);
+}
+
+// string runJob(map<string, string>& job, const string& counts)
+//  Purpose:
+//		Finds the D-Segments for the job and returns the results
+string SegmentationServer::runJob(map<string, string>& job, const string& counts) {
+	// A model past the cache's limit lives for this job only
+	bool cached;
+	HMMProbabilities* probs = model(job, cached);
+	unique_ptr<HMMProbabilities> uncachedModel(cached ? NULL : probs);
+
+	DSegmentsFinder finder(probs);
+
+	// Jobs run in parallel so each parses on a single thread
+	finder.setParserThreads(1);
+	if (job.count("fixed_point") > 0)
+		finder.setFixedPointScoring(atoi(job["fixed_point"].c_str()));
+	if (job["precision"] == "float")
+		finder.setScorePrecision(FLOAT_SCORES);
+	else if (job["precision"] == "double")
+		finder.setScorePrecision(DOUBLE_SCORES);
+	else if (job["precision"] == "long-double")
+		finder.setScorePrecision(LONG_DOUBLE_SCORES);
+	if (job.count("significance") > 0)
+		finder.setSignificanceTesting(atoi(job["significance"].c_str()), PERMUTED_NULL,
+			strtoull(job["seed"].c_str(), NULL, 10));
+
+	if (job.count("file") > 0)
+		finder.findDSegments(job["file"]);
+	else
+		finder.findDSegmentsInCounts(counts);
+
+	return finder.results();
+}
+
+// HMMProbabilities* model(map<string, string>& job, bool& cached)
+//  Purpose:
+//		Returns the model for the job's parameters or snapshot, creating
+//		it the first time they are seen.  Models are kept until MAX_MODELS
+//		are cached, after that a new one is returned uncached for the
+//		caller to delete.
+//	Postconditions:
+//		cached - true if the model is kept by the server
+HMMProbabilities* SegmentationServer::model(map<string, string>& job, bool& cached) {
+	// The server's snapshot stands in for missing parameters
+	if (job.count("model") == 0 && !defaultModelFileName.empty()
+		&& job.count("normal_length") == 0 && job.count("elevated_length") == 0
+		&& job.count("normal_mean") == 0 && job.count("elevated_mean") == 0)
+		job["model"] = defaultModelFileName;
+	if (job.count("model") > 0) {
+		string key = "snapshot " + job["model"];
+		lock_guard<mutex> lock(modelsMutex);
+		cached = models.count(key) > 0 || models.size() < MAX_MODELS;
+		if (!cached)
+			return new HMMProbabilities(job["model"]);
+		if (models.count(key) == 0)
+			models[key] = new HMMProbabilities(job["model"]);
+		return models[key];
+	}
+
+	if (job.count("normal_length") == 0)
+		job["normal_length"] = defaultNormalLength;
+	if (job.count("elevated_length") == 0)
+		job["elevated_length"] = defaultElevatedLength;
+	if (job.count("normal_mean") == 0)
+		job["normal_mean"] = defaultNormalMean;
+	if (job.count("elevated_mean") == 0)
+		job["elevated_mean"] = defaultElevatedMean;
+
+	string key =
+		job["normal_length"] + " " + job["elevated_length"] + " "
+		+ job["normal_mean"] + " " + job["elevated_mean"];
+
+	lock_guard<mutex> lock(modelsMutex);
+	cached = models.count(key) > 0 || models.size() < MAX_MODELS;
+	if (cached && models.count(key) > 0)
+		return models[key];
+	HMMProbabilities* probs = new HMMProbabilities(
+		atoi(job["normal_length"].c_str()),
+		atoi(job["elevated_length"].c_str()),
+		atof(job["normal_mean"].c_str()),
+		atof(job["elevated_mean"].c_str()));
+	if (cached)
+		models[key] = probs;
+
+	return probs;
+}
+
+// stop()
+//  Purpose:
+//		Stops accepting connections and wakes the workers
+void SegmentationServer::stop() {
+	lock_guard<mutex> lock(clientsMutex);
+	stopping = true;
+	clientsReady.notify_all();
+
+	// Wake the accept in run()
+	shutdown(listenSocket, SHUT_RDWR);
+}
+
+// Private Class Methods
+// =============================================
+
+// bool sendAll(int socket, const string& text)
+//  Purpose:
+//		Writes all of text to socket.  Returns false on error.
+bool SegmentationServer::sendAll(int socket, const string& text) {
+	size_t sent = 0;
+	while (sent < text.size()) {
+		ssize_t bytesSent = send(socket, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+		if (bytesSent <= 0)
+			return false;
+		sent += bytesSent;
+	}
+	return true;
+}
@@ -0,0 +1,169 @@
+/*
+ * SegmentationServer.h
+ *
+ *	This is the header file for the SegmentationServer object. A
+ *  SegmentationServer is a long running process that finds D-Segments for
+ *  jobs sent over a Unix domain socket.  Models are kept between jobs and
+ *  jobs run concurrently on a pool of worker threads, so small jobs do not
+ *  pay for process startup and model construction.
+ *
+ *	Protocol (one job per connection):
+ *		request:
+ *			<<key>>=<<value>> <<key>>=<<value>> ...\n
+ *			[<<counts_bytes>> bytes of counts file text]
+ *		keys:
+ *			file				counts file to read on the server host
+ *			counts_bytes		number of bytes of counts text following the
+ *								request line (instead of file)
+ *			normal_length, elevated_length, normal_mean, elevated_mean
+ *								model parameters (server defaults if missing)
+ *			model				model snapshot file on the server host, used
+ *								instead of the parameters (see
+ *								HMMProbabilities.h)
+ *			fixed_point, precision, significance, seed
+ *								same as the command line options
+ *		response:
+ *			the D-Segments results, or <error>message</error>, then the
+ *			connection is closed.  The results are sent once the job is
+ *			done, not as the scan finds them.
+ *
+ *	A request line of "shutdown" stops the server if shutdown requests
+ *  are allowed (setAllowShutdown), otherwise it is answered with an
+ *  error.  A job without model parameters uses the server's default
+ *  snapshot if it has one.  A snapshot is loaded the first time it is
+ *  named.  Up to MAX_MODELS models are kept, a job naming another one
+ *  builds it for itself.
+ *
+ *	A client that sends nothing or takes nothing for CLIENT_TIMEOUT
+ *  seconds is dropped.  A failing accept, such as running out of file
+ *  descriptors, is retried every ACCEPT_RETRY_MILLISECONDS.
+ *  A request line longer than MAX_REQUEST_LINE bytes or counts_bytes
+ *  over the server's limit (setMaxCountsBytes) is answered with an
+ *  error.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef SEGMENTATIONSERVER_H
+#define SEGMENTATIONSERVER_H
+#include "HMMProbabilities.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+class SegmentationServer
+{
+public:
+	// Constuctors
+	// ==============================================
+	SegmentationServer(string path, int threads, int normalLength, int elevatedLength, double normalMean, double elevatedMean);
+
+	// Destructor
+	// =============================================
+	~SegmentationServer();
+
+	// Public Methods
+	// =============================================
+
+	// int run()
+	//  Purpose:
+	//		Listens on the socket and serves jobs until a shutdown request.
+	//		Returns 0, or -1 if the socket could not be opened.
+	int run();
+
+	// setDefaultModel(string modelFileName)
+	//  Purpose:
+	//		Uses the model snapshot modelFileName for jobs without model
+	//		parameters instead of the default parameters
+	//	Postconditions:
+	//		defaultModelFileName - set
+	void setDefaultModel(string modelFileName);
+
+	// setAllowShutdown(bool allow)
+	//  Purpose:
+	//		Lets a "shutdown" request stop the server if allow is true
+	//	Postconditions:
+	//		allowShutdown - set
+	void setAllowShutdown(bool allow);
+
+	// setMaxCountsBytes(long long maxBytes)
+	//  Purpose:
+	//		Rejects jobs sending more than maxBytes of inline counts
+	//	Postconditions:
+	//		maxCountsBytes - set
+	void setMaxCountsBytes(long long maxBytes);
+
+	static const int CLIENT_TIMEOUT = 30;
+	static const int ACCEPT_RETRY_MILLISECONDS = 100;
+	static const size_t MAX_MODELS = 64;
+	static const size_t MAX_REQUEST_LINE = 65536;
+	static const long long DEFAULT_MAX_COUNTS_BYTES = 1LL << 30;
+
+private:
+	string socketPath;
+	int numThreads;
+	int listenSocket;
+	string defaultNormalLength;
+	string defaultElevatedLength;
+	string defaultNormalMean;
+	string defaultElevatedMean;
+	string defaultModelFileName;
+	bool allowShutdown;
+	long long maxCountsBytes;
+
+	// Waiting connections
+	mutex clientsMutex;
+	condition_variable clientsReady;
+	queue<int> clients;
+	bool stopping;
+
+	// Models by parameters or snapshot file
+	mutex modelsMutex;
+	map<string, HMMProbabilities*> models;
+
+	// serveClients()
+	//  Purpose:
+	//		Worker thread body.  Handles connections until stopping.
+	void serveClients();
+
+	// handleClient(int clientSocket)
+	//  Purpose:
+	//		Reads the job from clientSocket, runs it and sends the results
+	void handleClient(int clientSocket);
+
+	// string runJob(map<string, string>& job, const string& counts)
+	//  Purpose:
+	//		Finds the D-Segments for the job and returns the results
+	string runJob(map<string, string>& job, const string& counts);
+
+	// HMMProbabilities* model(map<string, string>& job, bool& cached)
+	//  Purpose:
+	//		Returns the model for the job's parameters or snapshot, creating
+	//		it the first time they are seen.  Models are kept until
+	//		MAX_MODELS are cached, after that a new one is returned uncached
+	//		for the caller to delete.
+	//	Postconditions:
+	//		cached - true if the model is kept by the server
+	HMMProbabilities* model(map<string, string>& job, bool& cached);
+
+	// stop()
+	//  Purpose:
+	//		Stops accepting connections and wakes the workers
+	void stop();
+
+	// Private Class Methods
+	// =============================================
+
+	// bool sendAll(int socket, const string& text)
+	//  Purpose:
+	//		Writes all of text to socket.  Returns false on error.
+	static bool sendAll(int socket, const string& text);
+};
+
+#endif //SEGMENTATIONSERVER_H
@@ -0,0 +1,201 @@
+/*
+ * ShardFile.cpp
+ *
+ *	This is the cpp file for the ShardFile object. A ShardFile holds
+ *  the result of scanning one coordinate range of a sequence, with the
+ *  scan state needed to merge the shards exactly.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "ShardFile.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+
+// Number of lead-in positions written per line
+static const int LEAD_IN_LINE = 4096;
+
+// long double readNumber(istream& in)
+//  Purpose:
+//		Reads a long double written in decimal or hexfloat
+static long double readNumber(istream& in) {
+	string word;
+	in >> word;
+	return strtold(word.c_str(), NULL);
+}
+
+// Constuctors
+// ==============================================
+ShardFile::ShardFile() {
+	start = 0;
+	end = 0;
+	scorePrecision = 0;
+	fixedPointBits = 0;
+	threshold = 0;
+	scale = 1;
+	records = 0;
+	for (int i = 0; i < 4; i++) {
+		readStartCounts[i] = 0;
+		segmentReadStartCounts[i] = 0;
+		endState.readStartCounts[i] = 0;
+	}
+	for (int i = 0; i < 4; i++)
+		endState.pendingReadStartCounts[i] = 0;
+	endState.cum = 0;
+	endState.max = 0;
+	endState.start = 0;
+	endState.end = 0;
+	endState.startPending = true;
+	endState.readStartSum = 0;
+	endState.pendingReadStartSum = 0;
+}
+
+// Public Methods
+// =============================================
+
+// write(string fileName)
+//  Purpose:
+//		Writes the shard to fileName
+void ShardFile::write(string fileName) {
+	ofstream file(fileName);
+	if (!file)
+		throw runtime_error("could not create shard file " + fileName);
+	file << hexfloat;
+
+	file << "cnv_shard 1\n";
+	file << "range " << chromosome << " " << start << " " << end << "\n";
+	file << "precision " << scorePrecision << " " << fixedPointBits << "\n";
+	file << "threshold " << threshold << " " << scale << "\n";
+	file << "scores";
+	for (size_t i = 0; i < scores.size(); i++)
+		file << " " << scores[i];
+	file << "\n";
+	file << "records " << records << "\n";
+	file << "read_start_counts";
+	for (int i = 0; i < 4; i++)
+		file << " " << readStartCounts[i];
+	file << "\n";
+	file << "segment_read_start_counts";
+	for (int i = 0; i < 4; i++)
+		file << " " << segmentReadStartCounts[i];
+	file << "\n";
+	file << "end_state " << endState.cum << " " << endState.max
+		<< " " << endState.start << " " << endState.end << " " << endState.startPending;
+	for (int i = 0; i < 4; i++)
+		file << " " << endState.readStartCounts[i];
+	file << " " << endState.readStartSum;
+	for (int i = 0; i < 4; i++)
+		file << " " << endState.pendingReadStartCounts[i];
+	file << " " << endState.pendingReadStartSum << "\n";
+
+	for (size_t i = 0; i < segments.size(); i++) {
+		file << "segment " << segments[i].start << " " << segments[i].end
+			<< " " << segments[i].score;
+		for (int j = 0; j < 4; j++)
+			file << " " << segments[i].readStartCounts[j];
+		file << " " << segments[i].readStartSum << "\n";
+	}
+
+	// Lead-in, a line per run of consecutive positions
+	for (size_t i = 0; i < leadInPositions.size(); ) {
+		file << "lead_in " << leadInPositions[i] << " ";
+		size_t j = i;
+		do {
+			if (j > i)
+				file << ",";
+			file << leadInIndices[j];
+			if (leadInReadStarts[j] > 3)
+				file << ":" << leadInReadStarts[j];
+			j++;
+		} while (j < leadInPositions.size() && j - i < (size_t) LEAD_IN_LINE
+			&& leadInPositions[j] == leadInPositions[j - 1] + 1);
+		file << "\n";
+		i = j;
+	}
+
+	if (!file)
+		throw runtime_error("could not write shard file " + fileName);
+}
+
+// read(string fileName)
+//  Purpose:
+//		Reads the shard from fileName
+void ShardFile::read(string fileName) {
+	ifstream file(fileName);
+	if (!file)
+		throw runtime_error("could not open shard file " + fileName);
+
+	string line;
+	getline(file, line);
+	if (line != "cnv_shard 1")
+		throw runtime_error(fileName + " is not a shard file");
+
+	while (getline(file, line)) {
+		istringstream in(line);
+		string key;
+		in >> key;
+
+		if (key == "range")
+			in >> chromosome >> start >> end;
+		else if (key == "precision")
+			in >> scorePrecision >> fixedPointBits;
+		else if (key == "threshold") {
+			threshold = readNumber(in);
+			scale = readNumber(in);
+		}
+		else if (key == "scores") {
+			scores.clear();
+			string score;
+			while (in >> score)
+				scores.push_back(strtold(score.c_str(), NULL));
+			in.clear();
+		}
+		else if (key == "records")
+			in >> records;
+		else if (key == "read_start_counts")
+			in >> readStartCounts[0] >> readStartCounts[1] >> readStartCounts[2] >> readStartCounts[3];
+		else if (key == "segment_read_start_counts")
+			in >> segmentReadStartCounts[0] >> segmentReadStartCounts[1]
+				>> segmentReadStartCounts[2] >> segmentReadStartCounts[3];
+		else if (key == "end_state") {
+			endState.cum = readNumber(in);
+			endState.max = readNumber(in);
+			in >> endState.start >> endState.end >> endState.startPending;
+			for (int i = 0; i < 4; i++)
+				in >> endState.readStartCounts[i];
+			in >> endState.readStartSum;
+			for (int i = 0; i < 4; i++)
+				in >> endState.pendingReadStartCounts[i];
+			in >> endState.pendingReadStartSum;
+		}
+		else if (key == "segment") {
+			DSegment segment;
+			in >> segment.start >> segment.end;
+			segment.score = readNumber(in);
+			for (int i = 0; i < 4; i++)
+				in >> segment.readStartCounts[i];
+			in >> segment.readStartSum;
+			segment.chromosome = -1;
+			segments.push_back(segment);
+		}
+		else if (key == "lead_in") {
+			long long position;
+			string indices;
+			in >> position >> indices;
+			istringstream list(indices);
+			string index;
+			while (getline(list, index, ',')) {
+				int scoreIndex = atoi(index.c_str());
+				size_t colon = index.find(':');
+				leadInPositions.push_back(position++);
+				leadInIndices.push_back(scoreIndex);
+				leadInReadStarts.push_back(colon == string::npos ? scoreIndex % 4 : atoi(index.c_str() + colon + 1));
+			}
+		}
+
+		if (in.fail())
+			throw runtime_error("bad line in shard file " + fileName + ": " + line);
+	}
+}
@@ -0,0 +1,88 @@
+/*
+ * ShardFile.h
+ *
+ *	This is the header file for the ShardFile object. A ShardFile holds
+ *  the result of scanning one coordinate range (a shard) of a sequence,
+ *  with the scan state needed to merge the shards into exactly the
+ *  result of a serial scan.
+ *
+ *	A shard is scanned from an empty state.  The serial scan enters the
+ *  shard in the state the previous shards left, but once the two scans
+ *  pass through the same state they agree from there on.  The shard
+ *  keeps the score index of its first positions (the lead-in) so the
+ *  merge can replay both scans until they meet, and keeps its end state
+ *  so the merge can carry the serial scan into the next shard.  The
+ *  segment still open at the end of the shard is not in segments.
+ *
+ *	Text format, numbers in hexfloat where they must round trip:
+ *		cnv_shard 1
+ *		range <<chromosome>> <<start>> <<end>>
+ *		precision <<ScorePrecision>> <<fixedPointBits>>
+ *		threshold <<threshold>> <<scale>>
+ *		scores <<score0>> <<score1>> ...
+ *		records <<count>>
+ *		read_start_counts <<0>> <<1>> <<2>> <<3>>
+ *		segment_read_start_counts <<0>> <<1>> <<2>> <<3>>
+ *		end_state <<cum>> <<max>> <<start>> <<end>> <<startPending>>
+ *			<<0>> <<1>> <<2>> <<3>> <<sum>> <<pending0>> ... <<pending3>> <<pendingSum>>
+ *		segment <<start>> <<end>> <<score>> <<0>> <<1>> <<2>> <<3>> <<sum>>
+ *		...
+ *		lead_in <<firstPosition>> <<index>>[:<<readStarts>>],...	(consecutive positions)
+ *		...
+ *
+ *	A score index is weightClass * 4 + readStarts, or readStarts without
+ *  a weight track.  The uncapped read starts follow the index when they
+ *  are over 3.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef SHARDFILE_H
+#define SHARDFILE_H
+#include "DSegmentScanner.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+class ShardFile
+{
+public:
+	// Constuctors
+	// ==============================================
+	ShardFile();
+
+	// Public Attributes
+	// =============================================
+	string chromosome;
+	long long start;
+	long long end;
+	int scorePrecision;
+	int fixedPointBits;
+	long double threshold;
+	long double scale;
+	vector<long double> scores;
+	long long records;
+	long long readStartCounts[4];
+	long long segmentReadStartCounts[4];
+	DSegmentScanState endState;
+	vector<DSegment> segments;
+	vector<long long> leadInPositions;
+	vector<int> leadInIndices;
+	vector<int> leadInReadStarts;
+
+	// Public Methods
+	// =============================================
+
+	// write(string fileName)
+	//  Purpose:
+	//		Writes the shard to fileName
+	void write(string fileName);
+
+	// read(string fileName)
+	//  Purpose:
+	//		Reads the shard from fileName
+	void read(string fileName);
+};
+
+#endif //SHARDFILE_H
@@ -0,0 +1,118 @@
+/*
+ * ThresholdCalibrator.cpp
+ *
+ *	This is the cpp file for the ThresholdCalibrator object. A
+ *  ThresholdCalibrator picks the D-Segment score threshold that gives a
+ *  target rate of false segments per megabase on sequences simulated from
+ *  the normal state of an HMM.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "ThresholdCalibrator.h"
+#include "NullSimulator.h"
+#include <fstream>
+#include <sstream>
+#include <math.h>
+#include <stdlib.h>
+
+// Constuctors
+// ==============================================
+ThresholdCalibrator::ThresholdCalibrator(HMMProbabilities* probs) {
+	probabilities = probs;
+	cached = false;
+	simulatedMegabases = 0;
+}
+
+// Public Methods
+// =============================================
+
+// double calibrate(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName)
+//  Purpose:
+//		Returns the threshold giving falseSegmentsPerMegabase segments
+//		per megabase of simulated normal state sequence.  At least
+//		megabases are simulated, more if needed to see 10 false segments.
+//		An empty cacheFileName turns off the cache.
+//	Postconditions:
+//		cached, simulatedMegabases - set
+double ThresholdCalibrator::calibrate(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName) {
+	simulatedMegabases = megabases;
+	if (falseSegmentsPerMegabase * simulatedMegabases < 10)
+		simulatedMegabases = 10 / falseSegmentsPerMegabase;
+
+	string key = cacheKey(falseSegmentsPerMegabase, simulatedMegabases, seed);
+	double threshold;
+	cached = !cacheFileName.empty() && readCache(cacheFileName, key, threshold);
+	if (cached)
+		return threshold;
+
+	// Find the highest false segments in the simulated sequence
+	long double scores[4];
+	long double normalProbabilities[4];
+	for (int i = 0; i < 4; i++) {
+		scores[i] = probabilities->dSegmentScore(i);
+		normalProbabilities[i] = probabilities->emissionProbability(1, to_string(i));
+	}
+	int allowed = (int) floor(falseSegmentsPerMegabase * simulatedMegabases + 0.5);
+	NullSimulator simulator(scores, normalProbabilities);
+	simulator.simulateTopExcursions((long long) (simulatedMegabases * 1e6), allowed + 1, seed);
+
+	// Put the threshold halfway between the last allowed false segment and
+	// the first one that is not allowed
+	vector<double>& heights = simulator.excursionHeights;
+	if ((int) heights.size() <= allowed)
+		threshold = heights.empty() ? 0 : heights.back();
+	else
+		threshold = (heights[allowed] + heights[allowed - 1]) / 2;
+
+	if (!cacheFileName.empty())
+		writeCache(cacheFileName, key, threshold);
+
+	return threshold;
+}
+
+// Private Methods
+// =============================================
+
+// string cacheKey(double falseSegmentsPerMegabase, double megabases, uint64_t seed)
+//  Purpose:
+//		Returns the cache key for the model and calibration settings
+string ThresholdCalibrator::cacheKey(double falseSegmentsPerMegabase, double megabases, uint64_t seed) {
+	stringstream ss;
+	ss << hexfloat;
+
+	// The scores and normal emissions determine the simulated scores
+	for (int i = 0; i < 4; i++)
+		ss << (double) probabilities->dSegmentScore(i) << ",";
+	for (int i = 0; i < 4; i++)
+		ss << (double) probabilities->emissionProbability(1, to_string(i)) << ",";
+	ss << falseSegmentsPerMegabase << "," << megabases << "," << seed;
+
+	return ss.str();
+}
+
+// bool readCache(string cacheFileName, string key, double& threshold)
+//  Purpose:
+//		Looks up key in the cache file.  Returns true and sets
+//		threshold if found.
+bool ThresholdCalibrator::readCache(string cacheFileName, string key, double& threshold) {
+	ifstream cacheFile(cacheFileName);
+	string line;
+	while (getline(cacheFile, line)) {
+		size_t tab = line.find('\t');
+		if (tab != string::npos && line.compare(0, tab, key) == 0) {
+			threshold = atof(line.substr(tab + 1).c_str());
+			return true;
+		}
+	}
+	return false;
+}
+
+// writeCache(string cacheFileName, string key, double threshold)
+//  Purpose:
+//		Appends the threshold for key to the cache file
+void ThresholdCalibrator::writeCache(string cacheFileName, string key, double threshold) {
+	ofstream cacheFile(cacheFileName, ios::app);
+	cacheFile.precision(17);
+	cacheFile << key << "\t" << threshold << "\n";
+}
@@ -0,0 +1,82 @@
+/*
+ * ThresholdCalibrator.h
+ *
+ *	This is the header file for the ThresholdCalibrator object. A
+ *  ThresholdCalibrator picks the D-Segment score threshold that gives a
+ *  target rate of false segments per megabase on sequences simulated from
+ *  the normal state of an HMM.  Calibrated thresholds can be kept in a
+ *  cache file keyed by the model and calibration settings so a parameter
+ *  set is only simulated once.
+ *
+ *	The false segments are counted as excursions, runs of the cumulative
+ *  score above zero (see NullSimulator::simulateTopExcursions).  This
+ *  approximates the scan, which also ends a segment once the cumulative
+ *  score falls threshold below its maximum: an excursion the scan splits
+ *  in two counts once, so the calibrated threshold can be slightly below
+ *  the one an exact count would give.  At the low rates calibrated for,
+ *  excursions reaching the threshold are rare enough that this seldom
+ *  matters.
+ *
+ *		cache file format (one line per calibration):
+ *			<<key>>	<<threshold>>
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef THRESHOLDCALIBRATOR_H
+#define THRESHOLDCALIBRATOR_H
+#include "HMMProbabilities.h"
+#include <stdint.h>
+#include <string>
+using namespace std;
+
+class ThresholdCalibrator
+{
+public:
+	// Constuctors
+	// ==============================================
+	ThresholdCalibrator(HMMProbabilities* probs);
+
+	// Public Attributes
+	// =============================================
+	HMMProbabilities* probabilities;
+
+	// True if the last threshold came from the cache
+	bool cached;
+
+	// Megabases simulated for the last threshold
+	double simulatedMegabases;
+
+	// Public Methods
+	// =============================================
+
+	// double calibrate(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName)
+	//  Purpose:
+	//		Returns the threshold giving falseSegmentsPerMegabase segments
+	//		per megabase of simulated normal state sequence.  At least
+	//		megabases are simulated, more if needed to see 10 false segments.
+	//		An empty cacheFileName turns off the cache.
+	//	Postconditions:
+	//		cached, simulatedMegabases - set
+	double calibrate(double falseSegmentsPerMegabase, double megabases, uint64_t seed, string cacheFileName);
+
+private:
+	// string cacheKey(double falseSegmentsPerMegabase, double megabases, uint64_t seed)
+	//  Purpose:
+	//		Returns the cache key for the model and calibration settings
+	string cacheKey(double falseSegmentsPerMegabase, double megabases, uint64_t seed);
+
+	// bool readCache(string cacheFileName, string key, double& threshold)
+	//  Purpose:
+	//		Looks up key in the cache file.  Returns true and sets
+	//		threshold if found.
+	bool readCache(string cacheFileName, string key, double& threshold);
+
+	// writeCache(string cacheFileName, string key, double threshold)
+	//  Purpose:
+	//		Appends the threshold for key to the cache file
+	void writeCache(string cacheFileName, string key, double threshold);
+};
+
+#endif //THRESHOLDCALIBRATOR_H
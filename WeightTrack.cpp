@@ -0,0 +1,229 @@
+/*
+ * WeightTrack.cpp
+ *
+ *	This is the cpp file for the WeightTrack object. A WeightTrack
+ *  holds a per-position correction for read start bias as one weight
+ *  class byte per position, memory mapped from a binary track file.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+#include "WeightTrack.h"
+#include <fstream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[8] = {'C', 'N', 'V', 'W', 'T', 'R', 'K', '1'};
+static const int NAME_SIZE = 64;
+static const size_t HEADER_SIZE = 8 + 4 + 4 + 8;
+static const size_t DIRECTORY_ENTRY_SIZE = NAME_SIZE + 8 + 8 + 8;
+
+// Constuctors
+// ==============================================
+WeightTrack::WeightTrack(string fileName) {
+	trackFileName = fileName;
+	lastChromosome = 0;
+	mapping = MAP_FAILED;
+	mappingSize = 0;
+
+	fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	struct stat status;
+	if (fileDescriptor < 0 || fstat(fileDescriptor, &status) < 0)
+		throw runtime_error("could not open weight track " + fileName);
+	mappingSize = status.st_size;
+	if (mappingSize >= HEADER_SIZE)
+		mapping = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close(fileDescriptor);
+		throw runtime_error("could not map weight track " + fileName);
+	}
+
+	// Header
+	const char* data = (const char*) mapping;
+	uint32_t numClasses;
+	uint32_t numChromosomes;
+	uint64_t directoryOffset;
+	memcpy(&numClasses, data + 8, 4);
+	memcpy(&numChromosomes, data + 12, 4);
+	memcpy(&directoryOffset, data + 16, 8);
+	if (memcmp(data, MAGIC, 8) != 0
+		|| numClasses > MAX_CLASSES
+		|| HEADER_SIZE + numClasses * sizeof(float) > mappingSize
+		|| directoryOffset > mappingSize
+		|| numChromosomes > (mappingSize - directoryOffset) / DIRECTORY_ENTRY_SIZE) {
+		munmap(mapping, mappingSize);
+		close(fileDescriptor);
+		throw runtime_error(fileName + " is not a weight track");
+	}
+
+	classCount = numClasses;
+	classWeights.resize(numClasses);
+	memcpy(classWeights.data(), data + HEADER_SIZE, numClasses * sizeof(float));
+
+	// Directory
+	const char* entry = data + directoryOffset;
+	for (uint32_t i = 0; i < numChromosomes; i++, entry += DIRECTORY_ENTRY_SIZE) {
+		Chromosome chromosome;
+		chromosome.name = string(entry, strnlen(entry, NAME_SIZE));
+		int64_t firstPosition;
+		int64_t length;
+		memcpy(&firstPosition, entry + NAME_SIZE, 8);
+		memcpy(&length, entry + NAME_SIZE + 8, 8);
+		memcpy(&chromosome.offset, entry + NAME_SIZE + 16, 8);
+		chromosome.firstPosition = firstPosition;
+		chromosome.length = length;
+
+		// Drop chromosomes that run past the data
+		if (length < 0 || chromosome.offset > directoryOffset
+			|| (uint64_t) length > directoryOffset - chromosome.offset)
+			continue;
+		chromosomes.push_back(chromosome);
+	}
+}
+
+// Destructor
+// =============================================
+WeightTrack::~WeightTrack() {
+	munmap(mapping, mappingSize);
+	close(fileDescriptor);
+}
+
+// Public Methods
+// =============================================
+
+// double classWeight(int weightClass)
+//  Purpose:
+//		Returns the weight of weightClass, 1 for the class of positions
+//		without a weight
+double WeightTrack::classWeight(int weightClass) {
+	if (weightClass < 0 || weightClass >= classCount)
+		return 1;
+	return classWeights[weightClass];
+}
+
+// const unsigned char* chromosomeClasses(const string& chromosome, long long& firstPosition, long long& length)
+//  Purpose:
+//		Returns the weight classes of chromosome, the class of
+//		firstPosition first.  Returns NULL with length 0 if the track
+//		does not cover chromosome.
+const unsigned char* WeightTrack::chromosomeClasses(const string& chromosome, long long& firstPosition, long long& length) {
+	firstPosition = 0;
+	length = 0;
+
+	if (lastChromosome >= chromosomes.size() || chromosomes[lastChromosome].name != chromosome) {
+		size_t i = 0;
+		while (i < chromosomes.size() && chromosomes[i].name != chromosome)
+			i++;
+		if (i == chromosomes.size())
+			return NULL;
+		lastChromosome = i;
+	}
+
+	firstPosition = chromosomes[lastChromosome].firstPosition;
+	length = chromosomes[lastChromosome].length;
+	return (const unsigned char*) mapping + chromosomes[lastChromosome].offset;
+}
+
+// Public Class Methods
+// =============================================
+
+// convert(string textFileName, string binaryFileName, int numClasses, double maxWeight)
+//  Purpose:
+//		Converts a text weight track to the binary format, rounding
+//		the weights to numClasses classes evenly spaced from 0 to
+//		maxWeight (larger weights are clipped)
+void WeightTrack::convert(string textFileName, string binaryFileName, int numClasses, double maxWeight) {
+	if (numClasses < 2 || numClasses > MAX_CLASSES)
+		throw invalid_argument("weight classes must be between 2 and 255");
+	if (maxWeight <= 0)
+		throw invalid_argument("maximum weight must be positive");
+
+	ifstream textFile(textFileName);
+	if (!textFile)
+		throw runtime_error("could not open " + textFileName);
+	ofstream binaryFile(binaryFileName, ios::binary | ios::trunc);
+	if (!binaryFile)
+		throw runtime_error("could not create " + binaryFileName);
+
+	// Header, the counts and directory offset are filled in at the end
+	uint32_t classes = numClasses;
+	uint32_t numChromosomes = 0;
+	uint64_t directoryOffset = 0;
+	binaryFile.write(MAGIC, 8);
+	binaryFile.write((const char*) &classes, 4);
+	binaryFile.write((const char*) &numChromosomes, 4);
+	binaryFile.write((const char*) &directoryOffset, 8);
+	for (int i = 0; i < numClasses; i++) {
+		float weight = maxWeight * i / (numClasses - 1);
+		binaryFile.write((const char*) &weight, sizeof(float));
+	}
+
+	// Classes, a chromosome at a time
+	vector<Chromosome> directory;
+	uint64_t offset = HEADER_SIZE + numClasses * sizeof(float);
+	long long nextPosition = 0;
+	string line;
+	while (getline(textFile, line)) {
+		size_t tab1 = line.find('\t');
+		size_t tab2 = tab1 == string::npos ? string::npos : line.find('\t', tab1 + 1);
+		if (tab2 == string::npos)
+			continue;
+		string name = line.substr(0, tab1);
+		long long position = atoll(line.c_str() + tab1 + 1);
+		double weight = atof(line.c_str() + tab2 + 1);
+		if (name.size() >= (size_t) NAME_SIZE)
+			throw runtime_error("chromosome name too long in weight track: " + name);
+
+		if (directory.empty() || directory.back().name != name) {
+			Chromosome chromosome;
+			chromosome.name = name;
+			chromosome.firstPosition = position;
+			chromosome.length = 0;
+			chromosome.offset = offset;
+			directory.push_back(chromosome);
+			nextPosition = position;
+		}
+		if (position < nextPosition)
+			throw runtime_error("positions out of order in weight track " + textFileName);
+
+		// Positions skipped by the text have no weight
+		for (; nextPosition < position; nextPosition++)
+			binaryFile.put((char) numClasses);
+
+		if (weight < 0)
+			weight = 0;
+		if (weight > maxWeight)
+			weight = maxWeight;
+		binaryFile.put((char) (int) (weight / maxWeight * (numClasses - 1) + 0.5));
+		nextPosition++;
+
+		directory.back().length = nextPosition - directory.back().firstPosition;
+		offset = directory.back().offset + directory.back().length;
+	}
+
+	// Directory
+	directoryOffset = offset;
+	for (size_t i = 0; i < directory.size(); i++) {
+		char name[NAME_SIZE];
+		memset(name, 0, NAME_SIZE);
+		memcpy(name, directory[i].name.data(), directory[i].name.size());
+		int64_t firstPosition = directory[i].firstPosition;
+		int64_t length = directory[i].length;
+		binaryFile.write(name, NAME_SIZE);
+		binaryFile.write((const char*) &firstPosition, 8);
+		binaryFile.write((const char*) &length, 8);
+		binaryFile.write((const char*) &directory[i].offset, 8);
+	}
+
+	numChromosomes = directory.size();
+	binaryFile.seekp(12);
+	binaryFile.write((const char*) &numChromosomes, 4);
+	binaryFile.write((const char*) &directoryOffset, 8);
+	if (!binaryFile)
+		throw runtime_error("could not write " + binaryFileName);
+}
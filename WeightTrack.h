@@ -0,0 +1,116 @@
+/*
+ * WeightTrack.h
+ *
+ *	This is the header file for the WeightTrack object. A WeightTrack
+ *  holds a per-position correction for read start bias (mappability,
+ *  GC) as one weight class byte per position.  Each class has a weight
+ *  that multiplies the expected read starts of every state.
+ *
+ *	The track is converted once from text to a binary file that is
+ *  memory mapped, so opening it costs nothing and only the pages for
+ *  the chromosomes scanned are read.  The class bytes are not checked,
+ *  a byte past numClasses is treated as a position without a weight.
+ *
+ *	Text format, one line per position, positions increasing within a
+ *  chromosome:
+ *		chromosome	position	weight
+ *
+ *	Binary format (native byte order):
+ *		char magic[8]					"CNVWTRK1"
+ *		uint32_t numClasses
+ *		uint32_t numChromosomes
+ *		uint64_t directoryOffset
+ *		float classWeights[numClasses]
+ *		unsigned char classes[...]		per chromosome, from its first
+ *										position to its last
+ *		directory at directoryOffset, per chromosome:
+ *			char name[64]
+ *			int64_t firstPosition
+ *			int64_t length
+ *			uint64_t offset
+ *
+ *	Positions inside a chromosome's range with no line in the text are
+ *  stored as class numClasses, which has weight 1, as are positions
+ *  outside the track.
+ *
+ *  Created on: 3-16-13
+ *      Author: tomkolar
+ */
+
+#ifndef WEIGHTTRACK_H
+#define WEIGHTTRACK_H
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+class WeightTrack
+{
+public:
+	// Constuctors
+	// ==============================================
+	WeightTrack(string fileName);
+
+	// Destructor
+	// =============================================
+	~WeightTrack();
+
+	// Public Methods
+	// =============================================
+
+	// int numClasses()
+	//  Purpose:
+	//		Returns the number of weight classes, not counting the class
+	//		for positions without a weight
+	int numClasses() {
+		return classCount;
+	}
+
+	// double classWeight(int weightClass)
+	//  Purpose:
+	//		Returns the weight of weightClass, 1 for the class of positions
+	//		without a weight
+	double classWeight(int weightClass);
+
+	// const unsigned char* chromosomeClasses(const string& chromosome, long long& firstPosition, long long& length)
+	//  Purpose:
+	//		Returns the weight classes of chromosome, the class of
+	//		firstPosition first.  Returns NULL with length 0 if the track
+	//		does not cover chromosome.
+	const unsigned char* chromosomeClasses(const string& chromosome, long long& firstPosition, long long& length);
+
+	// Public Class Methods
+	// =============================================
+
+	// convert(string textFileName, string binaryFileName, int numClasses, double maxWeight)
+	//  Purpose:
+	//		Converts a text weight track to the binary format, rounding
+	//		the weights to numClasses classes evenly spaced from 0 to
+	//		maxWeight (larger weights are clipped)
+	static void convert(string textFileName, string binaryFileName, int numClasses, double maxWeight);
+
+	static const int MAX_CLASSES = 255;
+
+private:
+	struct Chromosome {
+		string name;
+		long long firstPosition;
+		long long length;
+		uint64_t offset;
+	};
+
+	string trackFileName;
+	int fileDescriptor;
+	void* mapping;
+	size_t mappingSize;
+	int classCount;
+	vector<float> classWeights;
+	vector<Chromosome> chromosomes;
+
+	// Chromosome of the last lookup, the scan asks for the same one
+	// batch after batch
+	size_t lastChromosome;
+};
+
+#endif //WEIGHTTRACK_H
@@ -5,51 +5,511 @@
  *  using the maximal D-Segment algorithm.
  *
  *	Typical use:
- *		cnv cnvFile normalLength elevatedLength normalMean eleveatedMean
+ *		cnv cnvFile normalLength elevatedLength normalMean eleveatedMean [options]
+ *		cnv cnvFile --model=<file> [options]
+ *
+ *	Options:
+ *		--model=<file>			use the model snapshot <file> (see
+ *								HMMProbabilities.h) instead of the lengths and
+ *								means
+ *		--save-model=<file>		save the model, after --losses and
+ *								--estimate-means, as a snapshot to <file>
+ *		--fixed-point=<bits>	score with fixed-point integers using <bits>
+ *								fractional bits
+ *		--precision=<precision>	score in float, double or long-double
+ *		--engine=<engine>		find the segments with the reset scan (reset) or
+ *								as maximal scoring subsequences (maximal)
+ *		--compare-engines		run the other engine alongside and report the
+ *								segments that differ
+ *		--validate-precision	run a long double reference scan alongside and
+ *								report any segment calls that differ
+ *		--threads=<count>		number of threads parsing the counts file
+ *		--io-uring				keep several reads in flight with io_uring
+ *		--significance=<count>	assign each segment an empirical p-value from
+ *								<count> simulated null sequences, for
+ *								unweighted gain scans
+ *		--null=<model>			draw null sequences from the observed read start
+ *								frequencies (permuted) or the normal state (hmm)
+ *		--seed=<seed>			seed for the null simulations
+ *		--calibrate=<rate>		calibrate the threshold to give <rate> false
+ *								segments per megabase of normal sequence
+ *		--calibration-mb=<mb>	megabases of normal sequence to simulate
+ *		--calibration-cache=<file>	keep calibrated thresholds in <file>, for
+ *								example $HOME/.cnv_thresholds (default none)
+ *		--window-size=<size>	accumulate coverage statistics per chromosome and
+ *								per window of <size> positions
+ *		--window-stats=<file>	write the per window statistics to <file>
+ *		--losses=<length>,<mean>	also scan for reduced copy number with a
+ *								reduced state of expected <length> and Poisson
+ *								<mean>, in the same pass.  The normal state
+ *								then enters the reduced state as often as the
+ *								elevated one, so its transitions are rescaled
+ *								and the gain scores and threshold shift
+ *								slightly from a scan without --losses
+ *		--normal=<file>			score cnvFile as a tumor against the matched
+ *								normal counts in <file>, read in the same pass
+ *		--normal-mean=<mean>	mean read starts per position of the normal
+ *								(default normalMean)
+ *		--weights=<file>		correct the scores for read start bias with the
+ *								binary weight track <file> (see WeightTrack.h)
+ *		--convert-weights=<text>	convert the text weight track <text> to the
+ *								binary track named by --weights and exit
+ *		--weight-classes=<count>	number of weight classes to convert to
+ *		--max-weight=<weight>	largest weight class when converting
+ *		--shard=<chromosome>[:<start>-<end>]	scan only this range as one shard
+ *								of a sequence split across runs
+ *		--shard-file=<file>		write the shard to <file> for --merge
+ *		--lead-in=<positions>	positions kept at the start of a shard to
+ *								merge it exactly (default 1000000)
+ *		--merge=<file>,<file>,...	merge shard files, in sequence order, into
+ *								the results of a serial run
+ *		--bin-size=<records>	find segments coarse to fine, scanning bins of
+ *								<records> positions for candidates first.
+ *								Every record is still parsed and buffered,
+ *								only the position by position scan is
+ *								skipped.  The segments are only checked
+ *								against the full scan with --verify-bins.
+ *		--bin-threshold=<score>	bin scan threshold (default half the threshold)
+ *		--bin-padding=<bins>	bins scanned on each side of a candidate
+ *								(default 2)
+ *		--verify-bins			also run the full scan and report differences
+ *		--joint=<file>,<file>,...	segment cnvFile jointly with these samples,
+ *								read in the same pass, reporting each joint
+ *								segment's support and each sample's segments.
+ *								The summed scores are held to the threshold
+ *								times the number of samples.
+ *		--annotate=<file>,<file>,...	report the intervals of these BED files
+ *								(genes, known CNV regions) overlapping each
+ *								segment
+ *		--estimate-means		estimate normalMean (and the normal's mean in
+ *								paired mode) from a sample of the counts file
+ *								spread over the file, and set elevatedMean to
+ *								normalMean times the copy ratio.  The --losses
+ *								mean keeps its ratio to normalMean.  Not with
+ *								--model, --merge or --from-score-index.
+ *		--copy-ratio=<ratio>	elevated to normal mean ratio when estimating
+ *								(default 1.5, three copies over two)
+ *		--cache-dir=<dir>		keep the scan of each chromosome in <dir> and
+ *								reuse it when the chromosome and model have
+ *								not changed
+ *		--score-index=<file>	write the score track of the scan to <file> to
+ *								find the segments again at other thresholds
+ *		--from-score-index=<file>	find the segments from the score index
+ *								<file> instead of reading cnvFile
+ *		--index-threshold=<score>	threshold for --from-score-index (default
+ *								the threshold of the model)
+ *		--progress=<seconds>	report the progress of the scan on stderr every
+ *								<seconds> (also on SIGUSR1 without it); SIGINT
+ *								or SIGTERM stops the scan and prints the
+ *								segments found so far
+ *		--time-budget=<seconds>	stop the scan after <seconds> and print the
+ *								segments found so far.  The budget stops
+ *								the scan only: threshold calibration before
+ *								it counts toward the time but runs to the
+ *								end, and a stopped scan skips the
+ *								significance tests, annotation, coverage
+ *								window file and score index.  A stopped
+ *								shard scan writes no shard.
+ *		--segment-store			keep the segments compactly, with float scores,
+ *								for thresholds that call very many segments
+ *		--segment-spill=<dir>	with --segment-store, move the segments beyond
+ *								--segment-memory to a temporary file in <dir>
+ *		--segment-memory=<MB>	memory for the segments before spilling
+ *								(default 256)
+ *		--server=<socket>		serve jobs on the Unix domain socket <socket>
+ *								(see SegmentationServer.h), using the
+ *								parameters or --model as the default model
+ *		--server-threads=<count>	number of jobs run at once by the server
+ *		--server-allow-shutdown	let a "shutdown" request stop the server
+ *		--server-max-counts=<bytes>	largest inline counts a server job may
+ *								send (default 1 GB)
  *
  *  Created on: 3-16-13
  *      Author: tomkolar
  */
 #include "DSegmentsFinder.h"
 #include "HMMProbabilities.h"
+#include "SegmentationServer.h"
+#include "MeanEstimator.h"
+#include "ScanProgress.h"
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 using namespace std;
 
-int main( int argc, char *argv[] ) {
-/*
-	// Check that file name, lengths and means were enetered as parameters
-	if (argc < 5) {
-			cout << "Invalid # of arguments\n";
-			cout << "usage: cnv cnvFile normalLength elevatedLength normalMean eleveatedMean \n";
-			return -1;
-	}
+// Sample used to estimate the means, 64 chunks of 256 KB cut into
+// windows of 1000 positions
+static const int MEAN_SAMPLE_CHUNKS = 64;
+static const int MEAN_SAMPLE_CHUNK_BYTES = 1 << 18;
+static const int MEAN_WINDOW_POSITIONS = 1000;
 
-	cout << "Starting\n";
+// int run(int argc, char *argv[])
+//  Purpose:
+//		Parses the command line and runs the segmentation, returning the
+//		exit status
+static int run(int argc, char *argv[]) {
 
-	// Get Parameters
-	string cnvFileName = argv[1];
-	int normalLength = atoi(argv[2]);
-	int elevatedLength = atoi(argv[3]);
-	double normalMean = atof(argv[4]);
-	double elevatedMean = atof(argv[5]);
-*/
 	// Set Parameters
 	string cnvFileName = "C:/Users/kolart/Documents/Genome540/Assignment9/NA19238.chr20.counts";
 	int normalLength = 1000000;
 	int elevatedLength = 10000;
 	double normalMean = 0.38;
 	double elevatedMean = 0.57;
+	string modelFileName;
+	string savedModelFileName;
+	int fixedPointBits = 0;
+	ScorePrecision scorePrecision = CNV_SCORE_PRECISION;
+	bool validatePrecision = false;
+	SegmentEngine segmentEngine = RESET_SCAN_ENGINE;
+	bool compareEngines = false;
+	int parserThreads = CountsReader::defaultParserThreads();
+	bool asyncReads = false;
+	int significanceSimulations = 0;
+	NullModel nullModel = PERMUTED_NULL;
+	uint64_t seed = 0;
+	double calibrationRate = 0;
+	double calibrationMegabases = 100;
+	string calibrationCacheFileName;
+	int coverageWindowSize = 0;
+	string coverageWindowFileName;
+	int reducedLength = 0;
+	double reducedMean = 0;
+	string pairedNormalFileName;
+	double pairedNormalMean = -1;
+	string weightTrackFileName;
+	string weightTextFileName;
+	int weightClasses = 64;
+	double maxWeight = 2;
+	string shardChromosome;
+	long long shardStart = 0;
+	long long shardEnd = 0x7fffffffffffffffLL;
+	string shardFileName;
+	int leadInPositions = 1000000;
+	vector<string> mergeFileNames;
+	int binSize = 0;
+	double binThreshold = -1;
+	int binPadding = 2;
+	bool verifyBins = false;
+	vector<string> jointSampleFileNames;
+	string resultCacheDirectory;
+	vector<string> annotationFileNames;
+	string scoreIndexFileName;
+	string scoreIndexInputFileName;
+	double indexThreshold = 0;
+	bool estimateMeans = false;
+	double copyRatio = 1.5;
+	double progressSeconds = 0;
+	double timeBudgetSeconds = 0;
+	bool segmentStore = false;
+	string segmentSpillDirectory;
+	double segmentMemoryMegabytes = 256;
+	string serverSocketPath;
+	int serverThreads = NullSimulator::defaultThreads();
+	bool serverAllowShutdown = false;
+	long long serverMaxCountsBytes = SegmentationServer::DEFAULT_MAX_COUNTS_BYTES;
+
+	// Seperate the options from the positional parameters
+	vector<string> params;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg.compare(0, 8, "--model=") == 0)
+			modelFileName = arg.substr(8);
+		else if (arg.compare(0, 13, "--save-model=") == 0)
+			savedModelFileName = arg.substr(13);
+		else if (arg.compare(0, 14, "--fixed-point=") == 0)
+			fixedPointBits = atoi(arg.substr(14).c_str());
+		else if (arg == "--precision=float")
+			scorePrecision = FLOAT_SCORES;
+		else if (arg == "--precision=double")
+			scorePrecision = DOUBLE_SCORES;
+		else if (arg == "--precision=long-double")
+			scorePrecision = LONG_DOUBLE_SCORES;
+		else if (arg == "--engine=reset")
+			segmentEngine = RESET_SCAN_ENGINE;
+		else if (arg == "--engine=maximal")
+			segmentEngine = MAXIMAL_SUBSEQUENCE_ENGINE;
+		else if (arg == "--compare-engines")
+			compareEngines = true;
+		else if (arg == "--validate-precision")
+			validatePrecision = true;
+		else if (arg.compare(0, 10, "--threads=") == 0)
+			parserThreads = atoi(arg.substr(10).c_str());
+		else if (arg == "--io-uring")
+			asyncReads = true;
+		else if (arg.compare(0, 15, "--significance=") == 0)
+			significanceSimulations = atoi(arg.substr(15).c_str());
+		else if (arg == "--null=permuted")
+			nullModel = PERMUTED_NULL;
+		else if (arg == "--null=hmm")
+			nullModel = HMM_NULL;
+		else if (arg.compare(0, 7, "--seed=") == 0)
+			seed = strtoull(arg.substr(7).c_str(), NULL, 10);
+		else if (arg.compare(0, 12, "--calibrate=") == 0)
+			calibrationRate = atof(arg.substr(12).c_str());
+		else if (arg.compare(0, 17, "--calibration-mb=") == 0)
+			calibrationMegabases = atof(arg.substr(17).c_str());
+		else if (arg.compare(0, 20, "--calibration-cache=") == 0)
+			calibrationCacheFileName = arg.substr(20);
+		else if (arg.compare(0, 14, "--window-size=") == 0)
+			coverageWindowSize = atoi(arg.substr(14).c_str());
+		else if (arg.compare(0, 15, "--window-stats=") == 0)
+			coverageWindowFileName = arg.substr(15);
+		else if (arg.compare(0, 9, "--losses=") == 0) {
+			reducedLength = atoi(arg.substr(9).c_str());
+			size_t comma = arg.find(',');
+			if (comma != string::npos)
+				reducedMean = atof(arg.substr(comma + 1).c_str());
+			if (reducedLength <= 0 || reducedMean <= 0) {
+				cout << "--losses needs a length and the mean of the reduced state, --losses=<length>,<mean>\n";
+				return -1;
+			}
+		}
+		else if (arg.compare(0, 9, "--normal=") == 0)
+			pairedNormalFileName = arg.substr(9);
+		else if (arg.compare(0, 14, "--normal-mean=") == 0)
+			pairedNormalMean = atof(arg.substr(14).c_str());
+		else if (arg.compare(0, 10, "--weights=") == 0)
+			weightTrackFileName = arg.substr(10);
+		else if (arg.compare(0, 18, "--convert-weights=") == 0)
+			weightTextFileName = arg.substr(18);
+		else if (arg.compare(0, 17, "--weight-classes=") == 0)
+			weightClasses = atoi(arg.substr(17).c_str());
+		else if (arg.compare(0, 13, "--max-weight=") == 0)
+			maxWeight = atof(arg.substr(13).c_str());
+		else if (arg.compare(0, 8, "--shard=") == 0) {
+			shardChromosome = arg.substr(8);
+			size_t colon = shardChromosome.find(':');
+			if (colon != string::npos) {
+				string range = shardChromosome.substr(colon + 1);
+				shardChromosome = shardChromosome.substr(0, colon);
+				shardStart = atoll(range.c_str());
+				size_t dash = range.find('-');
+				if (dash != string::npos)
+					shardEnd = atoll(range.substr(dash + 1).c_str());
+			}
+		}
+		else if (arg.compare(0, 13, "--shard-file=") == 0)
+			shardFileName = arg.substr(13);
+		else if (arg.compare(0, 10, "--lead-in=") == 0)
+			leadInPositions = atoi(arg.substr(10).c_str());
+		else if (arg.compare(0, 8, "--merge=") == 0) {
+			stringstream files(arg.substr(8));
+			string file;
+			while (getline(files, file, ','))
+				mergeFileNames.push_back(file);
+		}
+		else if (arg.compare(0, 11, "--bin-size=") == 0)
+			binSize = atoi(arg.substr(11).c_str());
+		else if (arg.compare(0, 16, "--bin-threshold=") == 0)
+			binThreshold = atof(arg.substr(16).c_str());
+		else if (arg.compare(0, 14, "--bin-padding=") == 0)
+			binPadding = atoi(arg.substr(14).c_str());
+		else if (arg == "--verify-bins")
+			verifyBins = true;
+		else if (arg.compare(0, 8, "--joint=") == 0) {
+			stringstream files(arg.substr(8));
+			string file;
+			while (getline(files, file, ','))
+				jointSampleFileNames.push_back(file);
+		}
+		else if (arg.compare(0, 11, "--annotate=") == 0) {
+			stringstream files(arg.substr(11));
+			string file;
+			while (getline(files, file, ','))
+				annotationFileNames.push_back(file);
+		}
+		else if (arg == "--estimate-means")
+			estimateMeans = true;
+		else if (arg.compare(0, 13, "--copy-ratio=") == 0)
+			copyRatio = atof(arg.substr(13).c_str());
+		else if (arg.compare(0, 12, "--cache-dir=") == 0)
+			resultCacheDirectory = arg.substr(12);
+		else if (arg.compare(0, 14, "--score-index=") == 0)
+			scoreIndexFileName = arg.substr(14);
+		else if (arg.compare(0, 19, "--from-score-index=") == 0)
+			scoreIndexInputFileName = arg.substr(19);
+		else if (arg.compare(0, 18, "--index-threshold=") == 0)
+			indexThreshold = atof(arg.substr(18).c_str());
+		else if (arg.compare(0, 11, "--progress=") == 0)
+			progressSeconds = atof(arg.substr(11).c_str());
+		else if (arg.compare(0, 14, "--time-budget=") == 0)
+			timeBudgetSeconds = atof(arg.substr(14).c_str());
+		else if (arg == "--segment-store")
+			segmentStore = true;
+		else if (arg.compare(0, 16, "--segment-spill=") == 0)
+			segmentSpillDirectory = arg.substr(16);
+		else if (arg.compare(0, 17, "--segment-memory=") == 0)
+			segmentMemoryMegabytes = atof(arg.substr(17).c_str());
+		else if (arg.compare(0, 9, "--server=") == 0)
+			serverSocketPath = arg.substr(9);
+		else if (arg.compare(0, 17, "--server-threads=") == 0)
+			serverThreads = atoi(arg.substr(17).c_str());
+		else if (arg == "--server-allow-shutdown")
+			serverAllowShutdown = true;
+		else if (arg.compare(0, 20, "--server-max-counts=") == 0)
+			serverMaxCountsBytes = atoll(arg.substr(20).c_str());
+		else if (arg.compare(0, 2, "--") == 0) {
+			cout << "Unknown option " << arg << "\n";
+			return -1;
+		}
+		else
+			params.push_back(arg);
+	}
+
+	// Check that file name, lengths and means were enetered as parameters,
+	// or just the file name with a model snapshot
+	if (!modelFileName.empty() && params.size() == 1)
+		cnvFileName = params[0];
+	else if (params.size() > 0 && params.size() < 5) {
+			cout << "Invalid # of arguments\n";
+			cout << "usage: cnv cnvFile normalLength elevatedLength normalMean eleveatedMean [options]\n";
+			return -1;
+	}
+
+	// Get Parameters
+	if (params.size() >= 5) {
+		cnvFileName = params[0];
+		normalLength = atoi(params[1].c_str());
+		elevatedLength = atoi(params[2].c_str());
+		normalMean = atof(params[3].c_str());
+		elevatedMean = atof(params[4].c_str());
+	}
+
+	// Convert a weight track
+	if (!weightTextFileName.empty()) {
+		if (weightTrackFileName.empty()) {
+			cout << "--convert-weights needs --weights=<file> for the binary track\n";
+			return -1;
+		}
+		WeightTrack::convert(weightTextFileName, weightTrackFileName, weightClasses, maxWeight);
+		cout << "Converted " << weightTextFileName << " to " << weightTrackFileName << "\n";
+		return 0;
+	}
+
+	// Serve jobs until shutdown
+	if (!serverSocketPath.empty()) {
+		SegmentationServer server(serverSocketPath, serverThreads, normalLength, elevatedLength, normalMean, elevatedMean);
+		if (!modelFileName.empty())
+			server.setDefaultModel(modelFileName);
+		server.setAllowShutdown(serverAllowShutdown);
+		server.setMaxCountsBytes(serverMaxCountsBytes);
+		cout << "Serving on " << serverSocketPath << "\n";
+		if (server.run() < 0) {
+			cout << "Could not listen on " << serverSocketPath << "\n";
+			return -1;
+		}
+		return 0;
+	}
+
+	// Estimate the means from samples of the counts
+	if (estimateMeans) {
+		if (!modelFileName.empty() || !mergeFileNames.empty() || !scoreIndexInputFileName.empty()) {
+			cout << "--estimate-means needs a counts file scan, not --model, --merge or --from-score-index\n";
+			return -1;
+		}
+		MeanEstimator estimator(MEAN_SAMPLE_CHUNKS, MEAN_SAMPLE_CHUNK_BYTES, MEAN_WINDOW_POSITIONS);
+		double estimatedMean = estimator.estimateNormalMean(cnvFileName);
+		if (normalMean > 0)
+			reducedMean *= estimatedMean / normalMean;
+		normalMean = estimatedMean;
+		elevatedMean = normalMean * copyRatio;
+		cout << "Estimated normal mean " << normalMean << " from " << estimator.usedWindows
+			<< " of " << estimator.sampledWindows << " windows (" << estimator.sampledPositions
+			<< " positions), elevated mean " << elevatedMean;
+		if (reducedLength > 0)
+			cout << ", loss mean " << reducedMean;
+		cout << "\n";
+		if (!pairedNormalFileName.empty() && pairedNormalMean < 0) {
+			pairedNormalMean = estimator.estimateNormalMean(pairedNormalFileName);
+			cout << "Estimated mean " << pairedNormalMean << " of the normal from " << estimator.usedWindows
+				<< " of " << estimator.sampledWindows << " windows (" << estimator.sampledPositions << " positions)\n";
+		}
+	}
+
+	// Create the model, or load it from a snapshot
+	HMMProbabilities* probs;
+	if (!modelFileName.empty()) {
+		probs = new HMMProbabilities(modelFileName);
+		if (reducedLength > 0)
+			cout << "Ignoring --losses, the model snapshot sets the states\n";
+	}
+	else {
+		probs = new HMMProbabilities(normalLength, elevatedLength, normalMean, elevatedMean);
+		if (reducedLength > 0)
+			probs->addReducedState(reducedLength, reducedMean);
+	}
+	if (!savedModelFileName.empty()) {
+		probs->writeSnapshot(savedModelFileName);
+		cout << "Saved model snapshot " << savedModelFileName << "\n";
+	}
 
 	// Create the DSegmentsFinder
-	HMMProbabilities* probs = new HMMProbabilities(normalLength, elevatedLength, normalMean, elevatedMean);
 	DSegmentsFinder* finder = new DSegmentsFinder(probs);
+	finder->setFixedPointScoring(fixedPointBits);
+	finder->setScorePrecision(scorePrecision);
+	finder->setPrecisionValidation(validatePrecision);
+	finder->setSegmentEngine(segmentEngine, compareEngines);
+	finder->setParserThreads(parserThreads);
+	finder->setAsyncReads(asyncReads);
+	finder->setSignificanceTesting(significanceSimulations, nullModel, seed);
+	finder->setThresholdCalibration(calibrationRate, calibrationMegabases, seed, calibrationCacheFileName);
+	finder->setCoverageStatistics(coverageWindowSize, coverageWindowFileName);
+	finder->setWeightTrack(weightTrackFileName);
+	if (!pairedNormalFileName.empty())
+		finder->setPairedNormal(pairedNormalFileName, pairedNormalMean < 0 ? probs->poissonMean(1) : pairedNormalMean);
+	finder->setBinnedScan(binSize, binThreshold, binPadding, verifyBins);
+	finder->setShardRange(shardChromosome, shardStart, shardEnd, leadInPositions);
+	finder->setJointSamples(jointSampleFileNames);
+	finder->setResultCache(resultCacheDirectory);
+	finder->setScoreIndex(scoreIndexFileName);
+	finder->setAnnotations(annotationFileNames);
+	finder->setSegmentStore(segmentStore, segmentSpillDirectory, (long long) (segmentMemoryMegabytes * 1048576));
 	cout << "D-Segments Finder Created.\n";
 
-	// Find the d-segments
+	// Merge shards instead of reading the counts
+	if (!mergeFileNames.empty()) {
+		finder->mergeShards(mergeFileNames);
+		cout << finder->results();
+		return 0;
+	}
+
+	// Segment from a score index instead of reading the counts
+	if (!scoreIndexInputFileName.empty()) {
+		finder->findDSegmentsFromScoreIndex(scoreIndexInputFileName, indexThreshold);
+		cout << finder->results();
+		return 0;
+	}
+
+	// Find the d-segments, reporting progress and stopping cleanly when
+	// cancelled or out of time
+	ScanProgress progress(progressSeconds, timeBudgetSeconds);
+	ScanProgress::installSignalHandlers();
+	finder->setProgress(&progress);
 	finder->findDSegments(cnvFileName);
+	if (!shardChromosome.empty()) {
+		// A merge would take a partial shard for the whole range
+		if (progress.status() != SCAN_COMPLETE)
+			throw runtime_error("the scan stopped before the end of the shard, no shard written");
+		if (shardFileName.empty())
+			shardFileName = cnvFileName + "." + shardChromosome + "." + to_string(shardStart) + ".shard";
+		finder->writeShard(shardFileName);
+		cout << "Wrote shard " << shardFileName << "\n";
+		return 0;
+	}
 	cout << finder->results();
+	return 0;
+}
+
+int main( int argc, char *argv[] ) {
 
-	cout << "Fred";
+	// Bad options, combinations and input files are reported as errors
+	try {
+		return run(argc, argv);
+	}
+	catch (const exception& e) {
+		cerr << "Error: " << e.what() << "\n";
+		return -1;
+	}
 }
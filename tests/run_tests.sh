@@ -0,0 +1,349 @@
+#!/bin/sh
+#
+# run_tests.sh
+#
+#	Builds cnv and checks its features on small generated counts files:
+#  each scan mode must call the same segments as the plain scan it stands
+#  in for, each feature must report what the generated data holds, and
+#  bad input must fail instead of giving partial results.
+#
+#	Usage:
+#		tests/run_tests.sh [build directory]
+#
+#	The compiler is $CXX (default g++).  Exits non-zero if a check fails.
+#
+#  Created on: 3-16-13
+#      Author: tomkolar
+#
+
+SOURCE=$(cd "$(dirname "$0")/.." && pwd)
+WORK=${1:-$(mktemp -d)}
+CXX=${CXX:-g++}
+mkdir -p "$WORK" || exit 1
+
+echo "Building in $WORK"
+$CXX -std=c++17 -O2 -pthread -o "$WORK/cnv" "$SOURCE"/*.cpp || exit 1
+CNV="$WORK/cnv"
+MODEL="1000000 10000 0.38 0.57"
+
+# Poisson read starts at the normal mean with elevated regions, the same
+# on every run
+awk 'BEGIN {
+	srand(7);
+	for (c = 1; c <= 2; c++) {
+		for (p = 1; p <= 200000; p++) {
+			mean = 0.38;
+			if ((c == 1 && p > 60000 && p <= 75000) || (c == 2 && p > 120000 && p <= 130000))
+				mean = 0.57;
+			limit = exp(-mean);
+			k = 0;
+			for (product = rand(); product > limit; product *= rand())
+				k++;
+			printf "chr%d\t%d\t%d\n", c, p, k;
+		}
+	}
+}' > "$WORK/test.counts"
+COUNTS="$WORK/test.counts"
+
+FAILURES=0
+
+# check(name, condition...)
+#	Reports the check and counts it as failed if the condition fails
+check() {
+	name=$1
+	shift
+	if "$@" > /dev/null 2>&1; then
+		echo "PASS $name"
+	else
+		echo "FAIL $name"
+		FAILURES=$((FAILURES + 1))
+	fi
+}
+
+# fails(command...)
+#	Succeeds if the command exits non-zero with an error message
+fails() {
+	output=$("$@" 2>&1)
+	status=$?
+	test $status -ne 0 && echo "$output" | grep -q "Error:"
+}
+
+# rejected(command...)
+#	Succeeds if the command exits non-zero
+rejected() {
+	! "$@"
+}
+
+# not_found(pattern, file)
+#	Succeeds if pattern is not in file
+not_found() {
+	! grep -q "$1" "$2"
+}
+
+# segments(output)
+#	The segments of a run's output
+segments() {
+	grep 'type="segment_list"\|type="segment_statistics"' "$1"
+}
+
+# coordinates(type, output)
+#	The start and end of each segment of a result type in a run's output
+coordinates() {
+	grep "type=\"$1\"" "$2" | grep -o '([0-9]*,[0-9]*'
+}
+
+# same_segments(first, second)
+same_segments() {
+	segments "$1" > "$1.segments"
+	segments "$2" > "$2.segments"
+	test -s "$1.segments" && cmp -s "$1.segments" "$2.segments"
+}
+
+$CNV $COUNTS $MODEL > "$WORK/full.out" || exit 1
+check "full scan finds segments" grep -q 'type="segment_list">(' "$WORK/full.out"
+
+# Reads through io_uring equal plain reads, and a file that can not be
+# read fails instead of ending early
+$CNV $COUNTS $MODEL --io-uring > "$WORK/ioUring.out"
+check "io_uring reads equal plain reads" same_segments "$WORK/full.out" "$WORK/ioUring.out"
+check "read error fails" fails $CNV "$WORK" $MODEL
+check "read error fails with io_uring" fails $CNV "$WORK" $MODEL --io-uring
+
+# A matched normal at the normal mean, then the same normal with a
+# chromosome the tumor lacks before the ones they share, without chr1,
+# and with its chromosomes in the other order
+awk 'BEGIN {
+	srand(11);
+	for (c = 1; c <= 2; c++) {
+		for (p = 1; p <= 200000; p++) {
+			limit = exp(-0.38);
+			k = 0;
+			for (product = rand(); product > limit; product *= rand())
+				k++;
+			printf "chr%d\t%d\t%d\n", c, p, k;
+		}
+	}
+}' > "$WORK/normal.counts"
+awk '$1 == "chr2" { $1 = "chr0"; print }' OFS='\t' "$WORK/normal.counts" > "$WORK/normalExtra.counts"
+cat "$WORK/normal.counts" >> "$WORK/normalExtra.counts"
+awk '$1 != "chr1"' "$WORK/normal.counts" > "$WORK/normalMissing.counts"
+awk '$1 == "chr2"' "$WORK/normal.counts" > "$WORK/normalReordered.counts"
+awk '$1 == "chr1"' "$WORK/normal.counts" >> "$WORK/normalReordered.counts"
+
+$CNV $COUNTS $MODEL --normal="$WORK/normal.counts" > "$WORK/paired.out"
+$CNV $COUNTS $MODEL --normal="$WORK/normalExtra.counts" > "$WORK/pairedExtra.out"
+$CNV $COUNTS $MODEL --normal="$WORK/normalMissing.counts" > "$WORK/pairedMissing.out"
+check "paired scan matches every record" grep -q 'matched="400000" tumor_only="0" normal_only="0"' "$WORK/paired.out"
+check "paired scan skips a normal chromosome the tumor lacks" grep -q 'matched="400000" tumor_only="0" normal_only="200000"' "$WORK/pairedExtra.out"
+check "paired scan with an extra normal chromosome, segments" same_segments "$WORK/paired.out" "$WORK/pairedExtra.out"
+check "paired scan with a normal missing a chromosome" grep -q 'matched="200000" tumor_only="200000" normal_only="0"' "$WORK/pairedMissing.out"
+check "paired scan with chromosomes out of order fails" fails $CNV $COUNTS $MODEL --normal="$WORK/normalReordered.counts"
+
+# A sample segmented jointly with itself doubles every score and the
+# threshold, so the joint segments are its own with twice the records
+$CNV $COUNTS $MODEL --joint=$COUNTS > "$WORK/joint.out"
+coordinates segment_list "$WORK/full.out" > "$WORK/full.coordinates"
+coordinates joint_segment_list "$WORK/joint.out" > "$WORK/joint.coordinates"
+check "joint threshold scales with the samples" grep -q 'samples="2" positions="400000" threshold="66.4383"' "$WORK/joint.out"
+check "joint segments of a sample with itself" cmp -s "$WORK/full.coordinates" "$WORK/joint.coordinates"
+grep 'type="segment_statistics"' "$WORK/full.out" | grep -o '([0-9]*,[0-9]*,[0-9]*' \
+	| awk -F, '{ print $1 "," $2 "," 2 * $3 }' > "$WORK/full.records"
+grep 'type="segment_statistics"' "$WORK/joint.out" | grep -o '([0-9]*,[0-9]*,[0-9]*' > "$WORK/joint.records"
+check "joint segments count every sample's records" cmp -s "$WORK/full.records" "$WORK/joint.records"
+
+# A weight track of all ones leaves the segments unchanged, and a class
+# byte past the track's classes scores as a position without a weight
+awk '{ print $1 "\t" $2 "\t1" }' $COUNTS > "$WORK/ones.weights"
+$CNV $COUNTS $MODEL --convert-weights="$WORK/ones.weights" --weights="$WORK/ones.track" \
+	--weight-classes=3 --max-weight=2 > /dev/null
+$CNV $COUNTS $MODEL --weights="$WORK/ones.track" > "$WORK/weighted.out"
+check "weights of one equal the unweighted scan" same_segments "$WORK/full.out" "$WORK/weighted.out"
+check "weighted positions" grep -q 'weighted="400000" unweighted="0"' "$WORK/weighted.out"
+printf '\310\310\310' | dd of="$WORK/ones.track" bs=1 seek=36 conv=notrunc 2> /dev/null
+$CNV $COUNTS $MODEL --weights="$WORK/ones.track" > "$WORK/corruptWeights.out"
+check "bad weight class scans without a weight" grep -q 'weighted="399997" unweighted="3"' "$WORK/corruptWeights.out"
+
+# Each segment scores above every null sequence, and the null sequences
+# are only scored for unweighted gains
+$CNV $COUNTS $MODEL --significance=20 --seed=3 > "$WORK/significance.out"
+check "significance of each segment" grep -q 'simulations="20".*>([0-9]*,[0-9]*,0.047619),([0-9]*,[0-9]*,0.047619)<' "$WORK/significance.out"
+check "significance with weights fails" fails $CNV $COUNTS $MODEL --significance=20 --weights="$WORK/ones.track"
+check "significance with losses fails" fails $CNV $COUNTS $MODEL --significance=20 --losses=10000,0.19
+
+# A loss at half the normal mean is called as a loss segment, and the
+# reduced state needs its mean
+awk 'BEGIN {
+	srand(5);
+	for (p = 1; p <= 200000; p++) {
+		mean = 0.38;
+		if (p > 100000 && p <= 115000)
+			mean = 0.19;
+		limit = exp(-mean);
+		k = 0;
+		for (product = rand(); product > limit; product *= rand())
+			k++;
+		printf "chr1\t%d\t%d\n", p, k;
+	}
+}' > "$WORK/loss.counts"
+$CNV "$WORK/loss.counts" $MODEL --losses=10000,0.19 > "$WORK/losses.out"
+check "losses found" grep -q 'type="loss_segment_list">(99989,115010,' "$WORK/losses.out"
+check "losses are not gains" grep -q 'type="segment_list"></result>' "$WORK/losses.out"
+check "losses without a mean fail" rejected $CNV "$WORK/loss.counts" $MODEL --losses=10000
+
+# Means estimated from a sample of the counts replace wrong ones, the
+# loss mean keeping its ratio to the normal mean
+$CNV $COUNTS 1000000 10000 0.5 0.75 --estimate-means --losses=10000,0.25 > "$WORK/estimated.out"
+coordinates segment_list "$WORK/estimated.out" > "$WORK/estimated.coordinates"
+check "estimated means" grep -q 'Estimated normal mean 0.38[0-9]* .* elevated mean 0.57[0-9]*, loss mean 0.19[0-9]*$' "$WORK/estimated.out"
+check "estimated means, segments" cmp -s "$WORK/full.coordinates" "$WORK/estimated.coordinates"
+check "estimated means without a counts scan fail" rejected $CNV $COUNTS $MODEL --estimate-means --merge="$WORK/1.shard"
+
+# Coverage windows cover every position once, and a window file that
+# can not be written fails the run
+$CNV $COUNTS $MODEL --window-size=50000 --window-stats="$WORK/windows.tsv" > "$WORK/coverage.out"
+check "coverage windows" test "$(wc -l < "$WORK/windows.tsv")" -eq 8
+check "coverage windows cover every position" test "$(awk '{ sum += $4 } END { print sum }' "$WORK/windows.tsv")" -eq 400000
+check "coverage window file that can not be opened fails" fails $CNV $COUNTS $MODEL --window-size=50000 --window-stats="$WORK/missing/windows.tsv"
+if [ -w /dev/full ]; then
+	check "coverage window file that can not be written fails" fails $CNV $COUNTS $MODEL --window-size=50000 --window-stats=/dev/full
+fi
+
+# A lower false segment rate calibrates a higher threshold, a cached
+# threshold equals the simulated one, and nothing is cached unless asked
+mkdir -p "$WORK/home"
+rm -f "$WORK/home/.cnv_thresholds" "$WORK/thresholds"
+HOME="$WORK/home" $CNV $COUNTS $MODEL --calibrate=1 --calibration-mb=10 > "$WORK/calibrated.out"
+$CNV $COUNTS $MODEL --calibrate=0.1 --calibration-mb=100 > "$WORK/calibratedLow.out"
+$CNV $COUNTS $MODEL --calibrate=1 --calibration-mb=10 --calibration-cache="$WORK/thresholds" > /dev/null
+$CNV $COUNTS $MODEL --calibrate=1 --calibration-mb=10 --calibration-cache="$WORK/thresholds" > "$WORK/calibratedCached.out"
+grep -o '<score_threshold>[0-9.]*' "$WORK/calibrated.out" > "$WORK/calibrated.threshold"
+grep -o '<score_threshold>[0-9.]*' "$WORK/calibratedLow.out" > "$WORK/calibratedLow.threshold"
+grep -o '<score_threshold>[0-9.]*' "$WORK/calibratedCached.out" > "$WORK/calibratedCached.threshold"
+check "lower false segment rate, higher threshold" awk -F'>' 'NR == FNR { low = $2; next } { exit !(low > $2) }' \
+	"$WORK/calibratedLow.threshold" "$WORK/calibrated.threshold"
+check "cached threshold" grep -q 'cached="true"' "$WORK/calibratedCached.out"
+check "cached threshold equals simulated" cmp -s "$WORK/calibrated.threshold" "$WORK/calibratedCached.threshold"
+check "no calibration cache by default" test ! -e "$WORK/home/.cnv_thresholds"
+
+# Each segment is annotated with the intervals it overlaps
+printf 'chr1\t60000\t61000\tgeneA\nchr2\t125000\t126000\tgeneB\nchr2\t1\t100\tfar\n' > "$WORK/genes.bed"
+$CNV $COUNTS $MODEL --annotate="$WORK/genes.bed" > "$WORK/annotated.out"
+check "annotation" grep -q 'intervals="3">(chr1,59986,74997,1,geneA),(chr2,120002,129981,1,geneB)<' "$WORK/annotated.out"
+
+# A saved model, with or without losses, loads to the same segments, and
+# a truncated snapshot fails
+$CNV $COUNTS $MODEL --save-model="$WORK/model.snapshot" > "$WORK/saved.out"
+$CNV $COUNTS --model="$WORK/model.snapshot" > "$WORK/loaded.out"
+$CNV $COUNTS $MODEL --losses=10000,0.19 --save-model="$WORK/lossModel.snapshot" > "$WORK/savedLosses.out"
+$CNV $COUNTS --model="$WORK/lossModel.snapshot" > "$WORK/loadedLosses.out"
+grep 'segment' "$WORK/savedLosses.out" > "$WORK/savedLosses.segments"
+grep 'segment' "$WORK/loadedLosses.out" > "$WORK/loadedLosses.segments"
+head -c 200 "$WORK/model.snapshot" > "$WORK/truncated.snapshot"
+check "model snapshot" same_segments "$WORK/full.out" "$WORK/loaded.out"
+check "model snapshot with losses" cmp -s "$WORK/savedLosses.segments" "$WORK/loadedLosses.segments"
+check "truncated model snapshot fails" fails $CNV $COUNTS --model="$WORK/truncated.snapshot"
+
+# Fixed-point sums are exact, so the segments do not depend on how the
+# scan is split or which engine runs it
+$CNV $COUNTS $MODEL --fixed-point=16 --threads=1 > "$WORK/fixed1.out"
+$CNV $COUNTS $MODEL --fixed-point=16 --threads=4 > "$WORK/fixed4.out"
+$CNV $COUNTS $MODEL --fixed-point=16 --engine=reset > "$WORK/fixedReset.out"
+$CNV $COUNTS $MODEL --fixed-point=16 --validate-precision > "$WORK/fixedValidated.out"
+check "fixed point, any thread count" cmp -s "$WORK/fixed1.out" "$WORK/fixed4.out"
+check "fixed point, either engine" same_segments "$WORK/fixed1.out" "$WORK/fixedReset.out"
+check "fixed point, same calls as long double" grep -q 'divergent_segments="0"' "$WORK/fixedValidated.out"
+
+# Shards merged in order equal the serial scan
+$CNV $COUNTS $MODEL --shard=chr1:1-70000 --shard-file="$WORK/1.shard" > /dev/null
+$CNV $COUNTS $MODEL --shard=chr1:70001-200000 --shard-file="$WORK/2.shard" > /dev/null
+$CNV $COUNTS $MODEL --shard=chr2 --shard-file="$WORK/3.shard" > /dev/null
+$CNV $COUNTS $MODEL --merge="$WORK/1.shard,$WORK/2.shard,$WORK/3.shard" > "$WORK/merged.out"
+check "shard merge equals full scan" same_segments "$WORK/full.out" "$WORK/merged.out"
+
+# A shard scan stopped by its time budget writes no shard
+rm -f "$WORK/stopped.shard"
+check "stopped shard scan fails" fails $CNV $COUNTS $MODEL --shard=chr1 --shard-file="$WORK/stopped.shard" --time-budget=0.000001
+check "stopped shard scan writes no shard" test ! -e "$WORK/stopped.shard"
+
+# A stopped scan reports its progress and skips the work after the scan
+$CNV $COUNTS $MODEL --time-budget=0.000001 --significance=10 > "$WORK/stopped.out"
+check "stopped scan reports the time budget" grep -q 'status="time_budget"' "$WORK/stopped.out"
+check "stopped scan skips significance" not_found 'segment_significance' "$WORK/stopped.out"
+
+# A run from the cache equals the run that filled it and a run without
+rm -rf "$WORK/cache"
+$CNV $COUNTS $MODEL --cache-dir="$WORK/cache" > "$WORK/cacheFill.out"
+$CNV $COUNTS $MODEL --cache-dir="$WORK/cache" > "$WORK/cacheHit.out"
+check "cache reused" grep -q 'hits="2" misses="0"' "$WORK/cacheHit.out"
+check "cache fill equals serial run" same_segments "$WORK/full.out" "$WORK/cacheFill.out"
+check "cache reuse equals serial run" same_segments "$WORK/full.out" "$WORK/cacheHit.out"
+
+# Segments from the score index equal a direct scan
+rm -f "$WORK/test.index"
+$CNV $COUNTS $MODEL --fixed-point=16 --score-index="$WORK/test.index" > /dev/null
+$CNV $COUNTS $MODEL --fixed-point=16 --from-score-index="$WORK/test.index" > "$WORK/index.out"
+check "score index equals direct scan" same_segments "$WORK/fixed1.out" "$WORK/index.out"
+
+# The segment store reads back the thousands of segments of a low
+# threshold as the scan called them
+$CNV $COUNTS $MODEL --fixed-point=16 --from-score-index="$WORK/test.index" --index-threshold=2 > "$WORK/lowIndex.out"
+$CNV $COUNTS $MODEL --fixed-point=16 --from-score-index="$WORK/test.index" --index-threshold=2 \
+	--segment-store > "$WORK/lowStore.out"
+awk '/type="segment_list"/, /<\/result>/' "$WORK/lowIndex.out" > "$WORK/lowIndex.list"
+awk '/type="segment_list"/, /<\/result>/' "$WORK/lowStore.out" > "$WORK/lowStore.list"
+check "segment store holds every segment" grep -q '<segment_store segments="[0-9][0-9][0-9][0-9]' "$WORK/lowStore.out"
+check "segment store equals segment list" cmp -s "$WORK/lowIndex.list" "$WORK/lowStore.list"
+
+# The coarse to fine scan finds the segments of the full scan
+$CNV $COUNTS $MODEL --bin-size=50 --verify-bins > "$WORK/binned.out"
+check "binned equals exact" grep -q 'verified="true"' "$WORK/binned.out"
+check "binned segments" same_segments "$WORK/full.out" "$WORK/binned.out"
+
+# A lower bin threshold opens more and longer windows, the fine scan
+# must carry across them without splitting segments
+$CNV $COUNTS $MODEL --bin-size=50 --bin-threshold=3 --verify-bins > "$WORK/binnedLow.out"
+check "binned with a low bin threshold equals exact" grep -q 'verified="true"' "$WORK/binnedLow.out"
+check "binned with a low bin threshold, segments" same_segments "$WORK/full.out" "$WORK/binnedLow.out"
+
+# A server job equals the command line run, from a file or inline
+# counts, and keeps serving once its model cache is full
+send_job() {
+	perl -MIO::Socket::UNIX -e '
+		my $socket = IO::Socket::UNIX->new(Peer => $ARGV[0]) or die "could not connect: $!";
+		print $socket "$ARGV[1]\n";
+		if (@ARGV > 2) {
+			open(my $counts, "<", $ARGV[2]) or die "could not open $ARGV[2]";
+			local $/;
+			print $socket scalar <$counts>;
+		}
+		shutdown($socket, 1);
+		local $/;
+		print scalar <$socket>;' "$@"
+}
+SOCKET="$WORK/server.socket"
+rm -f "$SOCKET"
+$CNV $COUNTS $MODEL --server="$SOCKET" --server-threads=2 --server-allow-shutdown > /dev/null &
+SERVER=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	test -S "$SOCKET" && break
+	sleep 0.5
+done
+JOB="normal_length=1000000 elevated_length=10000 normal_mean=0.38 elevated_mean=0.57"
+send_job "$SOCKET" "file=$COUNTS $JOB" > "$WORK/serverFile.out"
+send_job "$SOCKET" "counts_bytes=$(wc -c < $COUNTS) $JOB" $COUNTS > "$WORK/serverInline.out"
+check "server job from a file" same_segments "$WORK/full.out" "$WORK/serverFile.out"
+check "server job from inline counts" same_segments "$WORK/full.out" "$WORK/serverInline.out"
+head -1000 $COUNTS > "$WORK/small.counts"
+for i in $(seq 1 70); do
+	send_job "$SOCKET" "counts_bytes=$(wc -c < "$WORK/small.counts") normal_mean=0.38$i" "$WORK/small.counts" > "$WORK/serverModel.out"
+done
+check "server job past the model cache" grep -q 'type="segment_list"' "$WORK/serverModel.out"
+send_job "$SOCKET" shutdown > /dev/null
+wait $SERVER
+check "server shut down" test $? -eq 0
+
+if [ $FAILURES -ne 0 ]; then
+	echo "$FAILURES checks failed"
+	exit 1
+fi
+echo "All checks passed"